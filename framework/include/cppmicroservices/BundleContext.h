@@ -26,10 +26,13 @@
 #include "cppmicroservices/GlobalConfig.h"
 #include "cppmicroservices/ListenerFunctors.h"
 #include "cppmicroservices/ListenerToken.h"
+#include "cppmicroservices/ServiceChanges.h"
 #include "cppmicroservices/ServiceInterface.h"
 #include "cppmicroservices/ServiceRegistration.h"
 
 #include <memory>
+#include <utility>
+#include <vector>
 
 namespace cppmicroservices {
 
@@ -297,6 +300,34 @@ public:
   ServiceRegistrationU RegisterService(const InterfaceMapConstPtr& service,
                                        const ServiceProperties& properties = ServiceProperties());
 
+  /**
+   * Registers several services at once.
+   *
+   * This has the same effect as calling
+   * RegisterService(const InterfaceMapConstPtr&, const ServiceProperties&)
+   * for each element of <code>services</code>, but the services are added to
+   * the framework service registry in one step, which is considerably faster
+   * for bundles registering many services. After all services have been
+   * added, a ServiceEvent#SERVICE_REGISTERED event is fired for each service,
+   * in the order of <code>services</code>.
+   *
+   * @param services The services to register, each given as a map of
+   *        interface identifiers to service objects together with the
+   *        properties for the service.
+   * @return The <code>ServiceRegistration</code> objects, in the order of
+   *         <code>services</code>.
+   *
+   * @throws std::runtime_error If this BundleContext is no longer valid, or if there are
+             case variants of the same key in one of the supplied properties maps.
+   * @throws std::invalid_argument If one of the InterfaceMaps is empty, or
+   *         if a service is registered as a null class. No service is
+   *         registered in this case.
+   *
+   * @see RegisterService(const InterfaceMapConstPtr&, const ServiceProperties&)
+   */
+  std::vector<ServiceRegistrationU> RegisterServices(
+      const std::vector<std::pair<InterfaceMapConstPtr, ServiceProperties> >& services);
+
   /**
    * Registers the specified service object with the specified properties
    * using the specified interfaces types with the framework.
@@ -439,7 +470,7 @@ public:
   template<class S>
   std::vector<ServiceReference<S>> GetServiceReferences(const std::string& filter = std::string())
   {
-    std::string clazz = us_service_interface_iid<S>();
+    const std::string& clazz = detail::GetServiceInterfaceId<S>();
     if (clazz.empty()) throw ServiceException("The service interface class has no CPPMICROSERVICES_DECLARE_SERVICE_INTERFACE macro");
     typedef std::vector<ServiceReferenceU> BaseVectorT;
     BaseVectorT serviceRefs = GetServiceReferences(clazz, filter);
@@ -503,11 +534,46 @@ public:
   template<class S>
   ServiceReference<S> GetServiceReference()
   {
-    std::string clazz = us_service_interface_iid<S>();
+    const std::string& clazz = detail::GetServiceInterfaceId<S>();
     if (clazz.empty()) throw ServiceException("The service interface class has no CPPMICROSERVICES_DECLARE_SERVICE_INTERFACE macro");
     return ServiceReference<S>(GetServiceReference(clazz));
   }
 
+  /**
+   * Returns the changes of the service registry after the given sequence
+   * number.
+   *
+   * <p>
+   * Every registration, property modification and unregistration of a service
+   * increments the sequence number of the service registry. The framework
+   * keeps a bounded log of the most recent changes, see
+   * Constants::FRAMEWORK_SERVICE_CHANGE_LOG_SIZE. Clients mirroring the
+   * registry can use this method to synchronize incrementally instead of
+   * listening to all service events or repeatedly reading the complete
+   * registry:
+   *
+   * <ol>
+   * <li>Call this method with the sequence number of the last change
+   *     already applied, or 0 initially.</li>
+   * <li>If ServiceChanges::resyncRequired is \c false, apply the returned
+   *     changes.</li>
+   * <li>Otherwise read the complete registry state, e.g. with
+   *     GetServiceReferences(const std::string&, const std::string&). Changes
+   *     happening concurrently are reported again by the next call.</li>
+   * <li>Remember ServiceChanges::sequenceNumber for the next call.</li>
+   * </ol>
+   *
+   * <p>
+   * Unlike service events, the changes are not subject to service event
+   * listener hooks.
+   *
+   * @param sequenceNumber The sequence number of the last change known to the caller.
+   * @return The changes after <code>sequenceNumber</code>, or an indication
+   *         that they are no longer available.
+   * @throws std::runtime_error If this BundleContext is no longer valid.
+   */
+  ServiceChanges GetServiceChanges(std::uint64_t sequenceNumber);
+
   /**
    * Returns the service object referenced by the specified
    * <code>ServiceReferenceBase</code> object.
@@ -654,6 +720,36 @@ public:
   ListenerToken AddServiceListener(const ServiceListener& listener,
                                    const std::string& filter = std::string());
 
+  /**
+   * Adds the specified <code>listener</code> with the specified
+   * <code>filter</code> to the context bundles's list of listeners,
+   * specifying on which thread the listener is called.
+   *
+   * <p>
+   * An asynchronous listener is called on a framework thread, so that a
+   * slow listener does not delay the thread which registers, modifies or
+   * unregisters a service. Its events are queued and delivered in order.
+   * If the queue is full, events are dropped and a FRAMEWORK_WARNING event
+   * is sent. The size of the queue and the number of framework threads
+   * are configured by the Constants#FRAMEWORK_SERVICE_LISTENER_QUEUE_SIZE
+   * and Constants#FRAMEWORK_SERVICE_LISTENER_THREADS framework properties.
+   *
+   * @param listener Any callable object.
+   * @param filter The filter criteria.
+   * @param delivery Whether the listener is called synchronously or asynchronously.
+   * @returns a ListenerToken object which can be used to remove the
+   *          <code>listener</code> from the list of registered listeners.
+   * @throws std::invalid_argument If <code>filter</code> contains an
+   *         invalid filter string that cannot be parsed.
+   * @throws std::runtime_error If this BundleContext is no
+   *         longer valid.
+   * @see AddServiceListener(const ServiceListener&, const std::string&)
+   * @see ServiceListenerDelivery
+   */
+  ListenerToken AddServiceListener(const ServiceListener& listener,
+                                   const std::string& filter,
+                                   ServiceListenerDelivery delivery);
+
   /**
    * Removes the specified <code>listener</code> from the context bundle's
    * list of listeners.
@@ -297,6 +297,143 @@ US_Framework_EXPORT extern const std::string FRAMEWORK_LOG; // = "org.cppmicrose
  */
 US_Framework_EXPORT extern const std::string FRAMEWORK_UUID; // = "org.cppmicroservices.framework.uuid";
 
+/**
+ * Framework launching property specifying additional service property keys
+ * for which the service registry maintains a secondary index. The value
+ * must be of type \c std::string (a single key) or \c std::vector<std::string>.
+ *
+ * Service lookups with filters requiring equality on an indexed key, e.g.
+ * <code>(service.pid=my.pid)</code>, only evaluate the filter for the services
+ * having a matching property value. The #SERVICE_PID key is always indexed.
+ */
+US_Framework_EXPORT extern const std::string FRAMEWORK_SERVICE_INDEXED_KEYS; // = "org.cppmicroservices.framework.service.indexed_keys";
+
+/**
+ * Framework launching property specifying the maximum number of service
+ * lookup results cached by the service registry. The value must be of type
+ * \c int or \c std::size_t. The cache is disabled if this property is not
+ * set or is zero.
+ *
+ * Cached results of <code>BundleContext::GetServiceReferences(clazz, filter)</code>
+ * are reused until a service registered under \c clazz is registered,
+ * unregistered or modified. Lookups are not cached while a ServiceFindHook
+ * is registered.
+ */
+US_Framework_EXPORT extern const std::string FRAMEWORK_SERVICE_LOOKUP_CACHE_SIZE; // = "org.cppmicroservices.framework.service.lookup_cache_size";
+
+/**
+ * Framework launching property specifying the number of recent service
+ * registry changes kept for <code>BundleContext::GetServiceChanges</code>.
+ * The value must be of type \c int or \c std::size_t. The default is 1024.
+ * If it is zero, no changes are kept and every call reports that a full
+ * resynchronization is required.
+ */
+US_Framework_EXPORT extern const std::string FRAMEWORK_SERVICE_CHANGE_LOG_SIZE; // = "org.cppmicroservices.framework.service.change_log_size";
+
+/**
+ * Framework launching property specifying the number of partitions of the
+ * service registry's class index. The value must be of type \c int or
+ * \c std::size_t. The default is 1.
+ *
+ * Each partition has its own lock and its own published snapshot, so
+ * registering or unregistering a service only invalidates the lookups of
+ * classes in the same partition. Frameworks with many services and
+ * frequent registry changes may benefit from a value such as 16.
+ */
+US_Framework_EXPORT extern const std::string FRAMEWORK_SERVICE_REGISTRY_SHARDS; // = "org.cppmicroservices.framework.service.registry_shards";
+
+/**
+ * Framework launching property specifying whether service listeners are
+ * called asynchronously unless requested otherwise when they are added.
+ * The value must be of type \c bool. The default is \c false.
+ *
+ * Asynchronous listeners are called on a framework thread pool and do not
+ * delay the thread which registers, modifies or unregisters a service.
+ * Note that the service of a SERVICE_UNREGISTERING event is usually no
+ * longer available when such a listener is called.
+ *
+ * Service trackers and listeners added with the deprecated member function
+ * overloads of BundleContext::AddServiceListener are always called
+ * synchronously.
+ *
+ * @see ServiceListenerDelivery
+ */
+US_Framework_EXPORT extern const std::string FRAMEWORK_SERVICE_LISTENER_ASYNC; // = "org.cppmicroservices.framework.service.listener.async";
+
+/**
+ * Framework launching property specifying the number of threads calling
+ * asynchronous service listeners. The value must be of type \c int or
+ * \c std::size_t. The default is 2. The threads are started when the
+ * first event is queued.
+ */
+US_Framework_EXPORT extern const std::string FRAMEWORK_SERVICE_LISTENER_THREADS; // = "org.cppmicroservices.framework.service.listener.threads";
+
+/**
+ * Framework launching property specifying the maximum number of events
+ * queued for an asynchronous service listener. The value must be of type
+ * \c int or \c std::size_t. The default is 1024 and zero means unbounded.
+ *
+ * Events for a listener whose queue is full are dropped. The first dropped
+ * event of a full queue is reported by a FRAMEWORK_WARNING event, which
+ * includes the number of events the listener has missed.
+ */
+US_Framework_EXPORT extern const std::string FRAMEWORK_SERVICE_LISTENER_QUEUE_SIZE; // = "org.cppmicroservices.framework.service.listener.queue_size";
+
+/**
+ * Framework launching property specifying the number of threads calling
+ * the synchronous service listeners of different bundles in parallel. The
+ * value must be of type \c int or \c std::size_t. The default is 0, which
+ * calls all synchronous listeners on the thread causing the event.
+ *
+ * The listeners receiving an event are partitioned by bundle. The thread
+ * causing the event calls partitions as well and waits for all of them, so
+ * the listeners of a bundle are still called one after another and before
+ * the service registration, modification or unregistration returns. Listeners which
+ * belong to different bundles must not depend on each other's calls.
+ */
+US_Framework_EXPORT extern const std::string FRAMEWORK_SERVICE_LISTENER_PARALLEL_THREADS; // = "org.cppmicroservices.framework.service.listener.parallel_threads";
+
+/**
+ * Framework launching property specifying additional service property keys
+ * by which service listeners are indexed. The value must be of type
+ * \c std::string (a single key) or \c std::vector<std::string>.
+ *
+ * A service event is only matched against the listeners whose filters
+ * require equality, e.g. <code>(component.name=my.component)</code>, with
+ * a value of the service. The #OBJECTCLASS, #SERVICE_ID and #SERVICE_PID
+ * keys are always indexed.
+ */
+US_Framework_EXPORT extern const std::string FRAMEWORK_SERVICE_LISTENER_INDEXED_KEYS; // = "org.cppmicroservices.framework.service.listener.indexed_keys";
+
+/**
+ * Framework launching property specifying whether the call durations of
+ * service, bundle and framework listeners are recorded. The value must be
+ * of type \c bool. The default is \c false.
+ *
+ * @see Framework::GetListenerStatistics
+ */
+US_Framework_EXPORT extern const std::string FRAMEWORK_LISTENER_STATISTICS; // = "org.cppmicroservices.framework.listener.statistics";
+
+/**
+ * Framework launching property specifying a duration in milliseconds. A
+ * FRAMEWORK_WARNING event naming the bundle of a service or bundle listener
+ * is sent whenever a call of the listener takes longer. Slow framework
+ * listeners are reported to the diagnostic log instead. The value must be
+ * of type \c int or \c std::size_t. The default is 0, which disables the
+ * warnings.
+ */
+US_Framework_EXPORT extern const std::string FRAMEWORK_LISTENER_WARNING_THRESHOLD; // = "org.cppmicroservices.framework.listener.warning_threshold";
+
+/**
+ * Framework launching property specifying the maximum number of parsed LDAP
+ * filters cached for the service lookups and service listeners of the
+ * framework. The value must be of type \c int or \c std::size_t. The
+ * default is 1024. If it is zero, filters are parsed on every use.
+ *
+ * @see Framework::GetLDAPFilterCacheStatistics
+ */
+US_Framework_EXPORT extern const std::string FRAMEWORK_LDAP_FILTER_CACHE_SIZE; // = "org.cppmicroservices.framework.ldap_filter_cache_size";
+
 
 /*
  * Service properties.
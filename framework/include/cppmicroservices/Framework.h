@@ -25,11 +25,14 @@
 
 #include "cppmicroservices/Bundle.h"
 #include "cppmicroservices/FrameworkConfig.h"
+#include "cppmicroservices/LDAPFilterCacheStatistics.h"
+#include "cppmicroservices/ListenerStatistics.h"
 
 #include <chrono>
 #include <map>
 #include <ostream>
 #include <string>
+#include <vector>
 
 namespace cppmicroservices {
 
@@ -134,6 +137,29 @@ public:
      */
     FrameworkEvent WaitForStop(const std::chrono::milliseconds& timeout);
 
+    /**
+     * Get the call statistics of the current service, bundle and framework
+     * listeners. Only listeners added while the framework property
+     * Constants::FRAMEWORK_LISTENER_STATISTICS is \c true are included.
+     *
+     * <p>
+     * Use this method to find the listeners which delay service
+     * registrations, bundle state changes or framework events.
+     *
+     * @return The statistics of each listener, in no particular order.
+     */
+    std::vector<ListenerStatistics> GetListenerStatistics() const;
+
+    /**
+     * Get the statistics of the cache of parsed LDAP filters used by the
+     * service lookups and service listeners of this Framework. Its
+     * capacity is set by the framework property
+     * Constants::FRAMEWORK_LDAP_FILTER_CACHE_SIZE.
+     *
+     * @return The statistics since this Framework object was created.
+     */
+    LDAPFilterCacheStatistics GetLDAPFilterCacheStatistics() const;
+
     /**
      * Start this Framework.
      *
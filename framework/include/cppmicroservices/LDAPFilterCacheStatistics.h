@@ -0,0 +1,69 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#ifndef CPPMICROSERVICES_LDAPFILTERCACHESTATISTICS_H
+#define CPPMICROSERVICES_LDAPFILTERCACHESTATISTICS_H
+
+#include <cstddef>
+
+namespace cppmicroservices {
+
+/**
+ * \ingroup MicroServices
+ *
+ * The statistics of the cache of parsed LDAP filters used by the service
+ * lookups and service listeners of a framework, as returned by
+ * Framework::GetLDAPFilterCacheStatistics.
+ *
+ * @see Constants::FRAMEWORK_LDAP_FILTER_CACHE_SIZE
+ */
+struct LDAPFilterCacheStatistics
+{
+  /**
+   * The number of filters found in the cache.
+   */
+  std::size_t hits;
+
+  /**
+   * The number of filters which had to be parsed.
+   */
+  std::size_t misses;
+
+  /**
+   * The number of filters removed from the full cache.
+   */
+  std::size_t evictions;
+
+  /**
+   * The number of filters in the cache.
+   */
+  std::size_t size;
+
+  /**
+   * The maximum number of filters in the cache.
+   */
+  std::size_t capacity;
+};
+
+}
+
+#endif // CPPMICROSERVICES_LDAPFILTERCACHESTATISTICS_H
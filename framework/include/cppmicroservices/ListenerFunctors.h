@@ -58,6 +58,37 @@ namespace cppmicroservices {
    */
   typedef std::function<void(const ServiceEvent&)> ServiceListener;
 
+  /**
+   * \ingroup MicroServices
+   * \ingroup gr_listeners
+   *
+   * Specifies on which thread a \c ServiceListener is called.
+   *
+   * @see BundleContext#AddServiceListener(const ServiceListener&, const std::string&, ServiceListenerDelivery)
+   */
+  enum class ServiceListenerDelivery
+  {
+    /**
+     * Use the delivery mode configured by the
+     * Constants#FRAMEWORK_SERVICE_LISTENER_ASYNC framework property.
+     */
+    DEFAULT,
+
+    /**
+     * Call the listener on the thread which registered, modified or
+     * unregistered the service.
+     */
+    SYNCHRONOUS,
+
+    /**
+     * Queue the events and call the listener on a framework thread.
+     * The events are delivered in order and the listener is not called
+     * concurrently. Without threading support, the listener is called
+     * synchronously.
+     */
+    ASYNCHRONOUS
+  };
+
   /**
    * \ingroup MicroServices
    * \ingroup gr_listeners
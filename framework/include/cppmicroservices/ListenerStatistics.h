@@ -0,0 +1,99 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#ifndef CPPMICROSERVICES_LISTENERSTATISTICS_H
+#define CPPMICROSERVICES_LISTENERSTATISTICS_H
+
+#include "cppmicroservices/Bundle.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace cppmicroservices {
+
+/**
+ * \ingroup MicroServices
+ *
+ * The call statistics of a listener, as returned by
+ * Framework::GetListenerStatistics.
+ *
+ * Call durations are recorded in buckets growing exponentially with
+ * four buckets per power of two, so the percentiles are upper bounds
+ * which exceed the exact values by at most 25 percent.
+ */
+struct ListenerStatistics
+{
+  /**
+   * The kinds of listeners.
+   */
+  enum class Type
+  {
+    SERVICE_LISTENER,
+    BUNDLE_LISTENER,
+    FRAMEWORK_LISTENER
+  };
+
+  /**
+   * The kind of listener.
+   */
+  Type type;
+
+  /**
+   * The bundle which added the listener.
+   */
+  Bundle bundle;
+
+  /**
+   * The filter of a service listener, empty for other listeners.
+   */
+  std::string filter;
+
+  /**
+   * The number of calls of the listener.
+   */
+  std::uint64_t calls;
+
+  /**
+   * The total duration of the calls.
+   */
+  std::chrono::nanoseconds total;
+
+  /**
+   * The median call duration.
+   */
+  std::chrono::nanoseconds median;
+
+  /**
+   * The 99th percentile of the call durations.
+   */
+  std::chrono::nanoseconds p99;
+
+  /**
+   * The longest call duration.
+   */
+  std::chrono::nanoseconds max;
+};
+
+}
+
+#endif // CPPMICROSERVICES_LISTENERSTATISTICS_H
@@ -0,0 +1,96 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#ifndef CPPMICROSERVICES_SERVICECHANGES_H
+#define CPPMICROSERVICES_SERVICECHANGES_H
+
+#include "cppmicroservices/ServiceEvent.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cppmicroservices {
+
+/**
+ * \ingroup MicroServices
+ *
+ * A single change of the service registry, as returned by
+ * BundleContext::GetServiceChanges.
+ */
+struct ServiceChange
+{
+  /**
+   * The sequence number of the change. Sequence numbers increase by one
+   * for each change of the service registry.
+   */
+  std::uint64_t sequenceNumber;
+
+  /**
+   * The kind of change: ServiceEvent::SERVICE_REGISTERED,
+   * ServiceEvent::SERVICE_MODIFIED or ServiceEvent::SERVICE_UNREGISTERING.
+   */
+  ServiceEvent::Type type;
+
+  /**
+   * The Constants::SERVICE_ID of the changed service.
+   */
+  long serviceId;
+
+  /**
+   * The class names under which the changed service is registered.
+   */
+  std::vector<std::string> objectClass;
+};
+
+/**
+ * \ingroup MicroServices
+ *
+ * The changes of the service registry since a given sequence number.
+ *
+ * @see BundleContext::GetServiceChanges
+ */
+struct ServiceChanges
+{
+  /**
+   * The sequence number of the latest change of the service registry.
+   * Pass it to the next BundleContext::GetServiceChanges call.
+   */
+  std::uint64_t sequenceNumber;
+
+  /**
+   * \c true if the changes since the requested sequence number are no
+   * longer available. The caller must then read the complete registry
+   * state, e.g. with BundleContext::GetServiceReferences.
+   */
+  bool resyncRequired;
+
+  /**
+   * The changes in the order they happened, or an empty list if
+   * #resyncRequired is \c true.
+   */
+  std::vector<ServiceChange> changes;
+};
+
+}
+
+#endif // CPPMICROSERVICES_SERVICECHANGES_H
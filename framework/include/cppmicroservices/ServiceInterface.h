@@ -85,12 +85,25 @@ namespace detail
 {
   US_Framework_EXPORT std::string GetDemangledName(const std::type_info& typeInfo);
 
+  /**
+   * Returns the id of the service interface type \c T, as given by
+   * us_service_interface_iid<T>(). The id is computed once per type and
+   * then returned by reference, so repeated typed lookups do neither
+   * demangle nor allocate.
+   */
+  template<class T>
+  const std::string& GetServiceInterfaceId()
+  {
+    static const std::string id(us_service_interface_iid<T>());
+    return id;
+  }
+
   template <class Interfaces, size_t size>
   struct InsertInterfaceHelper
   {
       static void insert(InterfaceMapPtr& im, const Interfaces& interfaces)
       {
-          std::pair<std::string, std::shared_ptr<void>> aPair= std::make_pair(std::string(us_service_interface_iid<typename std::tuple_element<size-1, Interfaces>::type::element_type>()),
+          std::pair<std::string, std::shared_ptr<void>> aPair= std::make_pair(GetServiceInterfaceId<typename std::tuple_element<size-1, Interfaces>::type::element_type>(),
                                            std::static_pointer_cast<void>(std::get<size-1>(interfaces)));
           im->insert(aPair);
           InsertInterfaceHelper<Interfaces,size-1>::insert(im, interfaces);
@@ -293,7 +306,7 @@ private:
 template<class Interface>
 std::shared_ptr<Interface> ExtractInterface(const InterfaceMapConstPtr& map)
 {
-  InterfaceMap::const_iterator iter = map->find(us_service_interface_iid<Interface>());
+  InterfaceMap::const_iterator iter = map->find(detail::GetServiceInterfaceId<Interface>());
   if (iter != map->end())
   {
     return std::static_pointer_cast<Interface>(iter->second);
@@ -85,7 +85,7 @@ public:
   ServiceReference(const ServiceReferenceBase& base)
     : ServiceReferenceBase(base)
   {
-    const std::string interfaceId(us_service_interface_iid<S>());
+    const std::string& interfaceId = detail::GetServiceInterfaceId<S>();
     if (GetInterfaceId() != interfaceId)
     {
       if (this->IsConvertibleTo(interfaceId))
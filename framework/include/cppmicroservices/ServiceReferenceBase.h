@@ -88,6 +88,22 @@ public:
    */
   Any GetProperty(const std::string& key) const;
 
+  /**
+   * Returns the property value to which the specified property key is mapped,
+   * like GetProperty(const std::string&), but without copying the value.
+   *
+   * <p>
+   * The returned value is never modified. It stays valid after the service
+   * properties have been changed or the service has been unregistered, and
+   * then still holds the value from the time of the call.
+   *
+   * @param key The property key.
+   * @return A pointer to the property value to which the key is mapped; a
+   *         pointer to an invalid Any if there is no property named after
+   *         the key. Never \c nullptr.
+   */
+  std::shared_ptr<const Any> GetSharedProperty(const std::string& key) const;
+
   /**
    * Returns a list of the keys in the <code>ServiceProperties</code>
    * object of the service referenced by this <code>ServiceReferenceBase</code>
@@ -83,7 +83,7 @@ public:
   ServiceReference<Interface> GetReference() const
   {
     static_assert(detail::Contains<Interface, I1, Interfaces...>::value, "Requested interface type not available");
-    return this->ServiceRegistrationBase::GetReference(us_service_interface_iid<Interface>());
+    return this->ServiceRegistrationBase::GetReference(detail::GetServiceInterfaceId<Interface>());
   }
 
   /**
@@ -100,7 +100,7 @@ public:
    */
   ServiceReference<I1> GetReference() const
   {
-    return this->ServiceRegistrationBase::GetReference(us_service_interface_iid<I1>());
+    return this->ServiceRegistrationBase::GetReference(detail::GetServiceInterfaceId<I1>());
   }
 
 
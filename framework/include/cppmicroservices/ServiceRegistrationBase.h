@@ -26,6 +26,8 @@
 #include "cppmicroservices/ServiceProperties.h"
 #include "cppmicroservices/ServiceReference.h"
 
+#include <chrono>
+
 namespace cppmicroservices {
 
 class BundlePrivate;
@@ -129,6 +131,40 @@ public:
    */
   void SetProperties(const ServiceProperties& properties);
 
+  /**
+   * Updates the properties associated with a service, coalescing the
+   * resulting service events.
+   *
+   * <p>
+   * The service's properties are replaced immediately, as by
+   * SetProperties(const ServiceProperties&). Firing the service events
+   * is deferred instead: all modifications made until \c maxDelay after
+   * the first deferred one result in a single ServiceEvent#SERVICE_MODIFIED
+   * event, which listeners matching the final properties receive.
+   * Listeners which matched the service before the first deferred
+   * modification and do not match the final properties receive a single
+   * ServiceEvent#SERVICE_MODIFIED_ENDMATCH event.
+   *
+   * <p>
+   * Deferred events are fired before the events of a subsequent call to
+   * SetProperties(const ServiceProperties&) or Unregister(). If the
+   * framework is built without threading support, the events are
+   * fired immediately.
+   *
+   * @param properties The properties for this service.
+   * @param maxDelay The maximum time firing the service events is deferred.
+   *
+   * @throws std::logic_error If this <code>ServiceRegistrationBase</code>
+   *         object has already been unregistered or if it is invalid.
+   * @throws std::invalid_argument If <code>properties</code> contains
+   *         case variants of the same key name or if the number of the keys
+   *         of <code>properties</code> exceeds the value returned by
+   *         std::numeric_limits<int>::max().
+   *
+   * @see SetProperties(const ServiceProperties&)
+   */
+  void SetProperties(const ServiceProperties& properties, const std::chrono::milliseconds& maxDelay);
+
   /**
    * Unregisters a service. Remove a <code>ServiceRegistrationBase</code> object
    * from the framework service registry. All <code>ServiceRegistrationBase</code>
@@ -183,6 +219,7 @@ private:
 
   friend class ServiceRegistry;
   friend class ServiceReferenceBasePrivate;
+  friend class ServiceEventCoalescer;
 
   template<class I1, class ...Interfaces> friend class ServiceRegistration;
 
@@ -200,6 +237,13 @@ private:
   ServiceRegistrationBase(BundlePrivate* bundle, const InterfaceMapConstPtr& service,
                           Properties&& props);
 
+  /**
+   * Fire the service events deferred by
+   * SetProperties(const ServiceProperties&, const std::chrono::milliseconds&),
+   * if any.
+   */
+  void DeliverModifiedEvents();
+
   ServiceRegistrationBasePrivate* d;
 
 };
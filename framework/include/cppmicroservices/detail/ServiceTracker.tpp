@@ -71,9 +71,9 @@ ServiceTracker<S,T>::ServiceTracker(const BundleContext& context,
 template<class S, class T>
 ServiceTracker<S,T>::ServiceTracker(const BundleContext& context,
                                     _ServiceTrackerCustomizer* customizer)
-  : d(new _ServiceTrackerPrivate(this, context, us_service_interface_iid<S>(), customizer))
+  : d(new _ServiceTrackerPrivate(this, context, detail::GetServiceInterfaceId<S>(), customizer))
 {
-  std::string clazz = us_service_interface_iid<S>();
+  const std::string& clazz = detail::GetServiceInterfaceId<S>();
   if (clazz.empty()) throw ServiceException("The service interface class has no CPPMICROSERVICES_DECLARE_SERVICE_INTERFACE macro");
 }
 
@@ -99,9 +99,12 @@ void ServiceTracker<S,T>::Open()
     {
       /* Remove if already exists. No-op if it's an invalid (default) token */
       d->context.RemoveListener(std::move(d->listenerToken));
+      /* The tracked services must be removed before they go away, which
+       * requires the SERVICE_UNREGISTERING events synchronously. */
       d->listenerToken = d->context.AddServiceListener(std::bind(&_TrackedService::ServiceChanged,
                                                                  t.get(), std::placeholders::_1),
-                                                       d->listenerFilter);
+                                                       d->listenerFilter,
+                                                       ServiceListenerDelivery::SYNCHRONOUS);
       std::vector<ServiceReference<S>> references;
       if (!d->trackClass.empty())
       {
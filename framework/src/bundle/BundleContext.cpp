@@ -184,6 +184,21 @@ ServiceRegistrationU BundleContext::RegisterService(const InterfaceMapConstPtr&
   return b->coreCtx->services.RegisterService(b, service, properties);
 }
 
+std::vector<ServiceRegistrationU> BundleContext::RegisterServices(
+    const std::vector<std::pair<InterfaceMapConstPtr, ServiceProperties> >& services)
+{
+  d->CheckValid();
+  auto b = (d->Lock(), d->bundle);
+
+  // CONCURRENCY NOTE: This is a check-then-act situation,
+  // but we ignore it since the time window is small and
+  // the result is the same as if the calling thread had
+  // won the race condition.
+
+  auto regs = b->coreCtx->services.RegisterServices(b, services);
+  return std::vector<ServiceRegistrationU>(regs.begin(), regs.end());
+}
+
 std::vector<ServiceReferenceU > BundleContext::GetServiceReferences(const std::string& clazz,
                                                                     const std::string& filter)
 {
@@ -219,6 +234,13 @@ ServiceReferenceU BundleContext::GetServiceReference(const std::string& clazz)
   return b->coreCtx->services.Get(d->bundle, clazz);
 }
 
+ServiceChanges BundleContext::GetServiceChanges(std::uint64_t sequenceNumber)
+{
+  d->CheckValid();
+  auto b = (d->Lock(), d->bundle);
+  return b->coreCtx->services.GetChanges(sequenceNumber);
+}
+
 /* @brief Private helper struct used to facilitate the shared_ptr aliasing constructor
  *        in BundleContext::GetService method. The aliasing constructor helps automate
  *        the call to UngetService method.
@@ -320,6 +342,15 @@ ListenerToken BundleContext::AddServiceListener(const ServiceListener& delegate,
   return b->coreCtx->listeners.AddServiceListener(d, delegate, nullptr, filter);
 }
 
+ListenerToken BundleContext::AddServiceListener(const ServiceListener& delegate,
+                                                const std::string& filter,
+                                                ServiceListenerDelivery delivery)
+{
+  d->CheckValid();
+  auto b = (d->Lock(), d->bundle);
+  return b->coreCtx->listeners.AddServiceListener(d, delegate, nullptr, filter, delivery);
+}
+
 void BundleContext::RemoveServiceListener(const ServiceListener& delegate)
 {
   d->CheckValid();
@@ -396,7 +427,9 @@ ListenerToken BundleContext::AddServiceListener(const ServiceListener& delegate,
   // the result is the same as if the calling thread had
   // won the race condition.
 
-  return b->coreCtx->listeners.AddServiceListener(d, delegate, data, filter);
+  // Listeners added through the deprecated API predate asynchronous
+  // delivery and keep being called synchronously.
+  return b->coreCtx->listeners.AddServiceListener(d, delegate, data, filter, ServiceListenerDelivery::SYNCHRONOUS);
 }
 
 void BundleContext::RemoveServiceListener(const ServiceListener& delegate, void* data)
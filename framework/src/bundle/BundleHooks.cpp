@@ -50,9 +50,7 @@ Bundle BundleHooks::FilterBundle(
     return bundle;
   }
 
-  std::vector<ServiceRegistrationBase> srl;
-  coreCtx->services.Get(us_service_interface_iid<BundleFindHook>(), srl);
-  if (srl.empty())
+  if (!coreCtx->services.HasHooks(ServiceRegistry::BUNDLE_FIND_HOOK))
   {
     return bundle;
   }
@@ -70,15 +68,26 @@ void BundleHooks::FilterBundles(
     std::vector<Bundle>& bundles
     ) const
 {
-  std::vector<ServiceRegistrationBase> srl;
-  coreCtx->services.Get(us_service_interface_iid<BundleFindHook>(), srl);
+  auto srl = coreCtx->services.GetHooks(ServiceRegistry::BUNDLE_FIND_HOOK);
+  if (!srl)
+  {
+    return;
+  }
   ShrinkableVector<Bundle> filtered(bundles);
 
   auto selfBundle = GetBundleContext().GetBundle();
-  std::sort(srl.begin(), srl.end());
-  for (auto srBaseIter = srl.rbegin(), srBaseEnd = srl.rend(); srBaseIter != srBaseEnd; ++srBaseIter)
+  for (auto srBaseIter = srl->rbegin(), srBaseEnd = srl->rend(); srBaseIter != srBaseEnd; ++srBaseIter)
   {
-    ServiceReference<BundleFindHook> sr = srBaseIter->GetReference();
+    ServiceReference<BundleFindHook> sr;
+    try
+    {
+      sr = srBaseIter->GetReference();
+    }
+    catch (const std::logic_error&)
+    {
+      // The hook was unregistered after the snapshot was taken.
+      continue;
+    }
     std::shared_ptr<BundleFindHook> fh = std::static_pointer_cast<BundleFindHook>(sr.d.load()->GetService(GetPrivate(selfBundle).get()));
     if (fh)
     {
@@ -98,15 +107,14 @@ void BundleHooks::FilterBundles(
 void BundleHooks::FilterBundleEventReceivers(const BundleEvent& evt,
                                              ServiceListeners::BundleListenerMap& bundleListeners)
 {
-  std::vector<ServiceRegistrationBase> eventHooks;
-  coreCtx->services.Get(us_service_interface_iid<BundleEventHook>(), eventHooks);
+  auto eventHooks = coreCtx->services.GetHooks(ServiceRegistry::BUNDLE_EVENT_HOOK);
 
   {
     auto l = coreCtx->listeners.bundleListenerMap.Lock(); US_UNUSED(l);
     bundleListeners = coreCtx->listeners.bundleListenerMap.value;
   }
 
-  if(!eventHooks.empty())
+  if(eventHooks)
   {
     std::vector<BundleContext> bundleContexts;
     for (auto& le : bundleListeners)
@@ -119,8 +127,7 @@ void BundleHooks::FilterBundleEventReceivers(const BundleEvent& evt,
     const std::size_t unfilteredSize = bundleContexts.size();
     ShrinkableVector<BundleContext> filtered(bundleContexts);
 
-    std::sort(eventHooks.begin(), eventHooks.end());
-    for (auto iter = eventHooks.rbegin(), iterEnd = eventHooks.rend(); iter != iterEnd; ++iter)
+    for (auto iter = eventHooks->rbegin(), iterEnd = eventHooks->rend(); iter != iterEnd; ++iter)
     {
       ServiceReference<BundleEventHook> sr;
       try
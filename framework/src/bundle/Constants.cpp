@@ -53,6 +53,18 @@ const std::string FRAMEWORK_THREADING_SINGLE          = "single";
 const std::string FRAMEWORK_THREADING_MULTI           = "multi";
 const std::string FRAMEWORK_LOG                       = "org.cppmicroservices.framework.log";
 const std::string FRAMEWORK_UUID                      = "org.cppmicroservices.framework.uuid";
+const std::string FRAMEWORK_SERVICE_INDEXED_KEYS      = "org.cppmicroservices.framework.service.indexed_keys";
+const std::string FRAMEWORK_SERVICE_LOOKUP_CACHE_SIZE = "org.cppmicroservices.framework.service.lookup_cache_size";
+const std::string FRAMEWORK_SERVICE_CHANGE_LOG_SIZE   = "org.cppmicroservices.framework.service.change_log_size";
+const std::string FRAMEWORK_SERVICE_REGISTRY_SHARDS   = "org.cppmicroservices.framework.service.registry_shards";
+const std::string FRAMEWORK_SERVICE_LISTENER_ASYNC    = "org.cppmicroservices.framework.service.listener.async";
+const std::string FRAMEWORK_SERVICE_LISTENER_THREADS  = "org.cppmicroservices.framework.service.listener.threads";
+const std::string FRAMEWORK_SERVICE_LISTENER_QUEUE_SIZE = "org.cppmicroservices.framework.service.listener.queue_size";
+const std::string FRAMEWORK_SERVICE_LISTENER_PARALLEL_THREADS = "org.cppmicroservices.framework.service.listener.parallel_threads";
+const std::string FRAMEWORK_SERVICE_LISTENER_INDEXED_KEYS = "org.cppmicroservices.framework.service.listener.indexed_keys";
+const std::string FRAMEWORK_LISTENER_STATISTICS = "org.cppmicroservices.framework.listener.statistics";
+const std::string FRAMEWORK_LISTENER_WARNING_THRESHOLD = "org.cppmicroservices.framework.listener.warning_threshold";
+const std::string FRAMEWORK_LDAP_FILTER_CACHE_SIZE = "org.cppmicroservices.framework.ldap_filter_cache_size";
 
 const std::string OBJECTCLASS                         = "objectclass";
 const std::string SERVICE_ID                          = "service.id";
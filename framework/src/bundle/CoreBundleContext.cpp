@@ -68,6 +68,8 @@ std::map<std::string, Any> InitProperties(std::map<std::string, Any> configurati
 CoreBundleContext::CoreBundleContext(const std::map<std::string, Any>& props, std::ostream* logger)
   : id(globalId++)
   , frameworkProperties(InitProperties(props))
+  , ldapExprCache(GetSizeProperty(frameworkProperties, Constants::FRAMEWORK_LDAP_FILTER_CACHE_SIZE,
+                                  LDAPExprCache::DEFAULT_CAPACITY))
   , listeners(this)
   , services(this)
   , serviceHooks(this)
@@ -158,6 +160,10 @@ void CoreBundleContext::Init()
 void CoreBundleContext::Uninit0()
 {
   DIAG_LOG(*sink) << "uninit";
+  auto ldapStats = ldapExprCache.GetStatistics();
+  DIAG_LOG(*sink) << "LDAP filter cache: " << ldapStats.hits << " hits, " << ldapStats.misses
+                  << " misses, " << ldapStats.evictions << " evictions, " << ldapStats.size
+                  << "/" << ldapStats.capacity << " entries";
   serviceHooks.Close();
   systemBundle->UninitSystemBundle();
 }
@@ -167,6 +173,7 @@ void CoreBundleContext::Uninit1()
   bundleRegistry.Clear();
   services.Clear();
   listeners.Clear();
+  ldapExprCache.Clear();
   resolver.Clear();
 
   {
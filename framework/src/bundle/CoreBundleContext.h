@@ -50,6 +50,7 @@ as specified in the OSGi R4.2 specifications.
 #include "BundleHooks.h"
 #include "BundleRegistry.h"
 #include "Debug.h"
+#include "LDAPExprCache.h"
 #include "Resolver.h"
 #include "ServiceHooks.h"
 #include "ServiceListeners.h"
@@ -132,6 +133,11 @@ public:
    */
   std::string dataStorage;
 
+  /**
+   * Parsed LDAP filters of service lookups and service listeners.
+   */
+  LDAPExprCache ldapExprCache;
+
   /**
    * All listeners in this framework.
    */
@@ -0,0 +1,116 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#include "InterfaceIdTable.h"
+
+#include <stdexcept>
+
+namespace cppmicroservices {
+
+const InterfaceIdTable::Id InterfaceIdTable::EMPTY_ID;
+
+InterfaceIdTable& InterfaceIdTable::Instance()
+{
+  static InterfaceIdTable interfaceIds;
+  return interfaceIds;
+}
+
+InterfaceIdTable::InterfaceIdTable()
+  : size(0)
+{
+  for (auto& chunk : chunks)
+  {
+    chunk.store(nullptr);
+  }
+  Intern(std::string());
+}
+
+InterfaceIdTable::~InterfaceIdTable()
+{
+  for (auto& chunk : chunks)
+  {
+    delete[] chunk.load();
+  }
+}
+
+InterfaceIdTable::Id InterfaceIdTable::Intern(const std::string& name)
+{
+  Id id = EMPTY_ID;
+  if (Find(name, id))
+  {
+    return id;
+  }
+
+  auto l = this->Lock(); US_UNUSED(l);
+  auto current = table.Load();
+  if (current)
+  {
+    auto iter = current->find(name);
+    if (iter != current->end())
+    {
+      return iter->second;
+    }
+  }
+
+  if (size == CHUNK_SIZE * MAX_CHUNKS)
+  {
+    throw std::length_error("Too many service interface names");
+  }
+  std::string* chunk = chunks[size / CHUNK_SIZE].load(std::memory_order_relaxed);
+  if (chunk == nullptr)
+  {
+    chunk = new std::string[CHUNK_SIZE];
+    chunks[size / CHUNK_SIZE].store(chunk, std::memory_order_release);
+  }
+  chunk[size % CHUNK_SIZE] = name;
+  id = static_cast<Id>(size++);
+
+  auto next = current ? std::make_shared<Table>(*current) : std::make_shared<Table>();
+  next->insert(std::make_pair(name, id));
+  table.Store(next);
+  return id;
+}
+
+bool InterfaceIdTable::Find(const std::string& name, Id& id) const
+{
+  auto current = table.Load();
+  if (!current)
+  {
+    return false;
+  }
+  auto iter = current->find(name);
+  if (iter == current->end())
+  {
+    return false;
+  }
+  id = iter->second;
+  return true;
+}
+
+const std::string& InterfaceIdTable::GetName(Id id) const
+{
+  // The caller got the id from Intern or Find, which synchronizes
+  // with the initialization of the name.
+  return chunks[id / CHUNK_SIZE].load(std::memory_order_acquire)[id % CHUNK_SIZE];
+}
+
+}
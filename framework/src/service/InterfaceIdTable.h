@@ -0,0 +1,200 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+#ifndef CPPMICROSERVICES_INTERFACEIDTABLE_H
+#define CPPMICROSERVICES_INTERFACEIDTABLE_H
+
+#include "cppmicroservices/detail/Threads.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cppmicroservices {
+
+/**
+ * A process-wide table which interns service interface names and hands
+ * out dense integer ids for them.
+ *
+ * The framework uses the ids instead of the (often long, demangled)
+ * interface names as keys in its internal maps. Ids are never released,
+ * so an id and the name it refers to stay valid for the lifetime of the
+ * process.
+ *
+ * Lookups of known names and of the names for ids do not take a lock.
+ *
+ * This class is not part of the public API.
+ */
+class InterfaceIdTable : private detail::MultiThreaded<>
+{
+
+public:
+
+  typedef std::uint32_t Id;
+
+  /**
+   * The id of the empty interface name.
+   */
+  static const Id EMPTY_ID = 0;
+
+  /**
+   * The table used by the framework.
+   */
+  static InterfaceIdTable& Instance();
+
+  InterfaceIdTable();
+  ~InterfaceIdTable();
+
+  InterfaceIdTable(const InterfaceIdTable&) = delete;
+  InterfaceIdTable& operator=(const InterfaceIdTable&) = delete;
+
+  /**
+   * Get the id of <code>name</code>, adding it to the table if necessary.
+   *
+   * @throws std::length_error if the table is full.
+   */
+  Id Intern(const std::string& name);
+
+  /**
+   * Get the id of <code>name</code> without adding it to the table.
+   *
+   * @return <code>false</code> if <code>name</code> has not been interned.
+   */
+  bool Find(const std::string& name, Id& id) const;
+
+  /**
+   * Get the interned name for <code>id</code>.
+   *
+   * @param id An id returned by Intern.
+   */
+  const std::string& GetName(Id id) const;
+
+  /**
+   * Names are stored in chunks of CHUNK_SIZE, so there can be at most
+   * CHUNK_SIZE * MAX_CHUNKS of them.
+   */
+  static const std::size_t CHUNK_SIZE = 1024;
+  static const std::size_t MAX_CHUNKS = 1024;
+
+private:
+
+  typedef std::unordered_map<std::string, Id> Table;
+
+  /**
+   * Mapping of name to id. It is replaced by a copy whenever a name
+   * is added, which is rare compared to lookups.
+   */
+  detail::Atomic<std::shared_ptr<const Table>> table;
+
+  /**
+   * Storage for the interned names, indexed by id. Chunks are allocated
+   * under the table lock and never freed or moved.
+   */
+  std::atomic<std::string*> chunks[MAX_CHUNKS];
+
+  /**
+   * The number of interned names, guarded by the table lock.
+   */
+  std::size_t size;
+};
+
+/**
+ * An array of values indexed by interface id, for data per interface
+ * which is accessed without locking. Chunks of values are allocated on
+ * first access and zero-initialized. They are never moved, so references
+ * to the values stay valid for the lifetime of the array.
+ */
+template<class T>
+class InterfaceIdArray
+{
+
+public:
+
+  InterfaceIdArray()
+  {
+    for (auto& chunk : chunks)
+    {
+      chunk.store(nullptr);
+    }
+  }
+
+  ~InterfaceIdArray()
+  {
+    for (auto& chunk : chunks)
+    {
+      delete[] chunk.load();
+    }
+  }
+
+  InterfaceIdArray(const InterfaceIdArray&) = delete;
+  InterfaceIdArray& operator=(const InterfaceIdArray&) = delete;
+
+  T& operator[](InterfaceIdTable::Id id)
+  {
+    std::atomic<T*>& slot = chunks[id / InterfaceIdTable::CHUNK_SIZE];
+    T* chunk = slot.load(std::memory_order_acquire);
+    if (chunk == nullptr)
+    {
+      // Threads racing for the same chunk keep the first one stored.
+      T* newChunk = new T[InterfaceIdTable::CHUNK_SIZE]();
+      if (slot.compare_exchange_strong(chunk, newChunk, std::memory_order_acq_rel))
+      {
+        chunk = newChunk;
+      }
+      else
+      {
+        delete[] newChunk;
+      }
+    }
+    return chunk[id % InterfaceIdTable::CHUNK_SIZE];
+  }
+
+  /**
+   * Call <code>f</code> with every value allocated so far.
+   */
+  template<class F>
+  void ForEach(F f)
+  {
+    for (auto& slot : chunks)
+    {
+      if (T* chunk = slot.load(std::memory_order_acquire))
+      {
+        for (std::size_t i = 0; i < InterfaceIdTable::CHUNK_SIZE; ++i)
+        {
+          f(chunk[i]);
+        }
+      }
+    }
+  }
+
+private:
+
+  std::atomic<T*> chunks[InterfaceIdTable::MAX_CHUNKS];
+};
+
+}
+
+#endif // CPPMICROSERVICES_INTERFACEIDTABLE_H
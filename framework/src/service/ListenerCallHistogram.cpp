@@ -0,0 +1,117 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#include "ListenerCallHistogram.h"
+
+#include <algorithm>
+
+namespace cppmicroservices {
+
+ListenerCallHistogram::ListenerCallHistogram()
+  : total(0)
+  , max(0)
+{
+  for (auto& bucket : buckets)
+  {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+int ListenerCallHistogram::BucketIndex(std::uint64_t ns)
+{
+  if (ns < 4)
+  {
+    return static_cast<int>(ns);
+  }
+  int exponent = 2;
+  while ((ns >> (exponent + 1)) != 0)
+  {
+    ++exponent;
+  }
+  // The two bits below the leading bit select one of four buckets.
+  return 4 * (exponent - 1) + static_cast<int>((ns >> (exponent - 2)) & 3);
+}
+
+std::uint64_t ListenerCallHistogram::BucketUpperBound(int index)
+{
+  if (index < 4)
+  {
+    return static_cast<std::uint64_t>(index);
+  }
+  const int exponent = index / 4 + 1;
+  const std::uint64_t sub = static_cast<std::uint64_t>(index % 4);
+  return ((4 + sub + 1) << (exponent - 2)) - 1;
+}
+
+void ListenerCallHistogram::Record(std::chrono::nanoseconds duration)
+{
+  const std::uint64_t ns = duration.count() > 0 ? static_cast<std::uint64_t>(duration.count()) : 0;
+  buckets[BucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+  total.fetch_add(ns, std::memory_order_relaxed);
+  std::uint64_t prev = max.load(std::memory_order_relaxed);
+  while (prev < ns && !max.compare_exchange_weak(prev, ns, std::memory_order_relaxed))
+  {
+  }
+}
+
+std::uint64_t ListenerCallHistogram::Percentile(const std::uint64_t* counts, std::uint64_t callCount, double fraction,
+                                                std::uint64_t maxNs) const
+{
+  // The smallest bucket containing the requested rank.
+  std::uint64_t rank = static_cast<std::uint64_t>(fraction * static_cast<double>(callCount));
+  if (rank == 0 || static_cast<double>(rank) < fraction * static_cast<double>(callCount))
+  {
+    ++rank;
+  }
+  std::uint64_t seen = 0;
+  for (int i = 0; i < BUCKET_COUNT; ++i)
+  {
+    seen += counts[i];
+    if (seen >= rank)
+    {
+      return std::min(BucketUpperBound(i), maxNs);
+    }
+  }
+  return maxNs;
+}
+
+void ListenerCallHistogram::Get(ListenerStatistics& stats) const
+{
+  // Concurrent calls may be recorded partially, so the call count is
+  // taken from the buckets which the percentiles are computed from.
+  std::uint64_t counts[BUCKET_COUNT];
+  std::uint64_t callCount = 0;
+  for (int i = 0; i < BUCKET_COUNT; ++i)
+  {
+    counts[i] = buckets[i].load(std::memory_order_relaxed);
+    callCount += counts[i];
+  }
+  const std::uint64_t maxNs = max.load(std::memory_order_relaxed);
+
+  stats.calls = callCount;
+  stats.total = std::chrono::nanoseconds(total.load(std::memory_order_relaxed));
+  stats.max = std::chrono::nanoseconds(maxNs);
+  stats.median = std::chrono::nanoseconds(callCount ? Percentile(counts, callCount, 0.5, maxNs) : 0);
+  stats.p99 = std::chrono::nanoseconds(callCount ? Percentile(counts, callCount, 0.99, maxNs) : 0);
+}
+
+}
@@ -0,0 +1,72 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#ifndef CPPMICROSERVICES_LISTENERCALLHISTOGRAM_H
+#define CPPMICROSERVICES_LISTENERCALLHISTOGRAM_H
+
+#include "cppmicroservices/ListenerStatistics.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace cppmicroservices {
+
+/**
+ * Records the call durations of a listener. Durations below four
+ * nanoseconds have their own buckets, longer durations are recorded
+ * in four buckets per power of two. Recording is lock-free.
+ */
+class ListenerCallHistogram
+{
+
+public:
+
+  ListenerCallHistogram();
+
+  void Record(std::chrono::nanoseconds duration);
+
+  /**
+   * Set the call count, total and the percentiles of the given
+   * statistics.
+   */
+  void Get(ListenerStatistics& stats) const;
+
+private:
+
+  static const int BUCKET_COUNT = 256;
+
+  static int BucketIndex(std::uint64_t ns);
+
+  /* The largest duration recorded in the given bucket */
+  static std::uint64_t BucketUpperBound(int index);
+
+  std::uint64_t Percentile(const std::uint64_t* counts, std::uint64_t calls, double fraction, std::uint64_t max) const;
+
+  std::atomic<std::uint64_t> buckets[BUCKET_COUNT];
+  std::atomic<std::uint64_t> total;
+  std::atomic<std::uint64_t> max;
+};
+
+}
+
+#endif // CPPMICROSERVICES_LISTENERCALLHISTOGRAM_H
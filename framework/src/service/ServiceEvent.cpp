@@ -106,8 +106,7 @@ std::ostream& operator<<(std::ostream& os, const ServiceEvent& event)
     long int sid = any_cast<long int>(sr.GetProperty(Constants::SERVICE_ID));
     os << " " << sid;
 
-    Any classes = sr.GetProperty(Constants::OBJECTCLASS);
-    os << " objectClass=" << classes.ToString() << ")";
+    os << " objectClass=" << sr.GetSharedProperty(Constants::OBJECTCLASS)->ToString() << ")";
   }
 
   return os;
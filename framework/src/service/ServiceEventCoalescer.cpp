@@ -0,0 +1,126 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#include "ServiceEventCoalescer.h"
+
+namespace cppmicroservices {
+
+ServiceEventCoalescer::ServiceEventCoalescer()
+  : stopping(false)
+{
+}
+
+ServiceEventCoalescer::~ServiceEventCoalescer()
+{
+  Stop();
+}
+
+bool ServiceEventCoalescer::Schedule(const ServiceRegistrationBase& registration, Clock::time_point deadline)
+{
+  auto l = this->Lock(); US_UNUSED(l);
+  if (stopping)
+  {
+    return false;
+  }
+  auto iter = scheduled.insert(std::make_pair(deadline, registration));
+  if (!thread.joinable())
+  {
+    threadDetached = std::make_shared<bool>(false);
+    thread = std::thread(&ServiceEventCoalescer::Run, this, threadDetached);
+  }
+  else if (iter == scheduled.begin())
+  {
+    Notify();
+  }
+  return true;
+}
+
+void ServiceEventCoalescer::Stop()
+{
+  std::thread stopped;
+  std::shared_ptr<bool> detached;
+  std::multimap<Clock::time_point, ServiceRegistrationBase> discarded;
+  {
+    auto l = this->Lock(); US_UNUSED(l);
+    stopping = true;
+    stopped.swap(thread);
+    detached.swap(threadDetached);
+    discarded.swap(scheduled);
+    NotifyAll();
+  }
+
+  if (stopped.joinable())
+  {
+    // Delivering events may cause the framework to be destroyed.
+    if (stopped.get_id() == std::this_thread::get_id())
+    {
+      *detached = true;
+      stopped.detach();
+    }
+    else
+    {
+      stopped.join();
+    }
+  }
+
+  this->Lock(), stopping = false;
+}
+
+void ServiceEventCoalescer::Run(std::shared_ptr<bool> detached)
+{
+  for (;;)
+  {
+    ServiceRegistrationBase registration;
+    {
+      auto l = this->Lock(); US_UNUSED(l);
+      while (!stopping)
+      {
+        if (scheduled.empty())
+        {
+          Wait(l);
+          continue;
+        }
+        const auto now = Clock::now();
+        auto first = scheduled.begin();
+        if (first->first <= now)
+        {
+          registration = first->second;
+          scheduled.erase(first);
+          break;
+        }
+        WaitFor(l, first->first - now);
+      }
+      if (stopping)
+      {
+        return;
+      }
+    }
+
+    registration.DeliverModifiedEvents();
+    if (*detached)
+    {
+      return;
+    }
+  }
+}
+
+}
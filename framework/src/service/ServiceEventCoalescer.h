@@ -0,0 +1,86 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#ifndef CPPMICROSERVICES_SERVICEEVENTCOALESCER_H
+#define CPPMICROSERVICES_SERVICEEVENTCOALESCER_H
+
+#include "cppmicroservices/ServiceRegistrationBase.h"
+#include "cppmicroservices/detail/Threads.h"
+#include "cppmicroservices/detail/WaitCondition.h"
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <thread>
+
+namespace cppmicroservices {
+
+/**
+ * Delivers the service events deferred by
+ * ServiceRegistrationBase::SetProperties(const ServiceProperties&, const std::chrono::milliseconds&)
+ * when their delay has elapsed. A single framework thread delivering
+ * the events is started on first use.
+ */
+class ServiceEventCoalescer : private detail::MultiThreaded<detail::MutexLockingStrategy<>, detail::WaitCondition>
+{
+
+public:
+
+  typedef std::chrono::steady_clock Clock;
+
+  ServiceEventCoalescer();
+
+  ~ServiceEventCoalescer();
+
+  /**
+   * Deliver the deferred events of a service registration at
+   * \c deadline at the latest.
+   *
+   * @return \c false if the coalescer is stopping and the events
+   *         must be delivered by the caller.
+   */
+  bool Schedule(const ServiceRegistrationBase& registration, Clock::time_point deadline);
+
+  /**
+   * Discard the scheduled deliveries and wait for the thread to finish.
+   * The thread is started again when the next delivery is scheduled.
+   */
+  void Stop();
+
+private:
+
+  /**
+   * Deliver the scheduled events until stopped. \c detached is set when
+   * Stop is called from the thread itself, which must then return
+   * without touching the possibly destroyed coalescer.
+   */
+  void Run(std::shared_ptr<bool> detached);
+
+  std::multimap<Clock::time_point, ServiceRegistrationBase> scheduled;
+  std::thread thread;
+  std::shared_ptr<bool> threadDetached;
+  bool stopping;
+};
+
+}
+
+#endif // CPPMICROSERVICES_SERVICEEVENTCOALESCER_H
@@ -0,0 +1,244 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#include "ServiceEventDispatcher.h"
+
+#include "cppmicroservices/Bundle.h"
+#include "cppmicroservices/BundleContext.h"
+#include "cppmicroservices/FrameworkEvent.h"
+
+#include "CoreBundleContext.h"
+#include "Utils.h"
+
+#include <chrono>
+#include <exception>
+
+namespace cppmicroservices {
+
+ServiceEventDispatcher::ServiceEventDispatcher(CoreBundleContext* coreCtx, std::size_t threadCount, std::size_t queueSize)
+  : coreCtx(coreCtx)
+  , threadCount(threadCount)
+  , queueSize(queueSize)
+  , stopping(false)
+  , dropped(0)
+{
+}
+
+ServiceEventDispatcher::~ServiceEventDispatcher()
+{
+  Stop();
+}
+
+bool ServiceEventDispatcher::Post(const ServiceListenerEntry& listener, const ServiceEvent& evt)
+{
+  ServiceEventQueue& queue = *listener.GetEventQueue();
+  bool firstDropped = false;
+  std::size_t listenerDropped = 0;
+  {
+    auto l = queue.Lock(); US_UNUSED(l);
+    if (queueSize == 0 || queue.events.size() < queueSize)
+    {
+      queue.overflowing = false;
+      queue.events.push_back(evt);
+      if (queue.scheduled)
+      {
+        return true;
+      }
+      queue.scheduled = true;
+    }
+    else
+    {
+      firstDropped = !queue.overflowing;
+      queue.overflowing = true;
+      listenerDropped = ++queue.dropped;
+    }
+  }
+
+  if (listenerDropped != 0)
+  {
+    ++dropped;
+    if (firstDropped)
+    {
+      // Report only the first event of each overflow, so that a stalled
+      // listener does not flood the framework listeners.
+      coreCtx->listeners.SendFrameworkEvent(FrameworkEvent(
+          FrameworkEvent::Type::FRAMEWORK_WARNING,
+          listener.GetBundleContext().GetBundle(),
+          "The event queue of a service listener in " + listener.GetBundleContext().GetBundle().GetSymbolicName() +
+          " is full, " + cppmicroservices::ToString(listenerDropped) + " event(s) dropped so far"));
+    }
+    return false;
+  }
+
+  auto l = this->Lock(); US_UNUSED(l);
+  if (stopping)
+  {
+    l.UnLock();
+    auto l2 = queue.Lock(); US_UNUSED(l2);
+    queue.events.clear();
+    queue.scheduled = false;
+    return false;
+  }
+  Schedule_unlocked(listener);
+  return true;
+}
+
+void ServiceEventDispatcher::Schedule_unlocked(const ServiceListenerEntry& listener)
+{
+  ready.push_back(listener);
+  if (threads.size() < threadCount)
+  {
+    auto detached = std::make_shared<bool>(false);
+    threads.emplace_back(std::thread(&ServiceEventDispatcher::Run, this, detached), detached);
+  }
+  else
+  {
+    Notify();
+  }
+}
+
+void ServiceEventDispatcher::Stop()
+{
+  std::vector<std::pair<std::thread, std::shared_ptr<bool>>> stopped;
+  std::deque<ServiceListenerEntry> discarded;
+  {
+    auto l = this->Lock(); US_UNUSED(l);
+    stopping = true;
+    stopped.swap(threads);
+    discarded.swap(ready);
+    NotifyAll();
+  }
+
+  for (auto& th : stopped)
+  {
+    // A listener may cause the framework to be destroyed.
+    if (th.first.get_id() == std::this_thread::get_id())
+    {
+      *th.second = true;
+      th.first.detach();
+    }
+    else
+    {
+      th.first.join();
+    }
+  }
+
+  for (auto& listener : discarded)
+  {
+    ServiceEventQueue& queue = *listener.GetEventQueue();
+    auto l = queue.Lock(); US_UNUSED(l);
+    queue.events.clear();
+    queue.scheduled = false;
+  }
+
+  this->Lock(), stopping = false;
+}
+
+std::size_t ServiceEventDispatcher::GetDroppedCount() const
+{
+  return dropped;
+}
+
+void ServiceEventDispatcher::Run(std::shared_ptr<bool> detached)
+{
+  for (;;)
+  {
+    ServiceListenerEntry listener;
+    {
+      auto l = this->Lock(); US_UNUSED(l);
+      Wait(l, [this] { return stopping || !ready.empty(); });
+      if (stopping)
+      {
+        return;
+      }
+      listener = ready.front();
+      ready.pop_front();
+    }
+
+    // Deliver one event and put the listener back at the end of the
+    // ready list if it has more, so that busy listeners take turns.
+    ServiceEventQueue& queue = *listener.GetEventQueue();
+    ServiceEvent evt;
+    {
+      auto l = queue.Lock(); US_UNUSED(l);
+      if (queue.events.empty())
+      {
+        queue.scheduled = false;
+        continue;
+      }
+      evt = queue.events.front();
+      queue.events.pop_front();
+    }
+
+    if (!listener.IsRemoved())
+    {
+      // The listener may destroy the framework, so it is called here and
+      // only reported to the listeners if this thread was not detached.
+      const auto start = coreCtx->listeners.IsTimed() ? std::chrono::steady_clock::now()
+                                                      : std::chrono::steady_clock::time_point();
+      std::exception_ptr error;
+      try
+      {
+        listener.CallDelegate(evt);
+      }
+      catch (...)
+      {
+        error = std::current_exception();
+      }
+      if (!*detached)
+      {
+        coreCtx->listeners.ServiceListenerCalled(listener, start, error);
+      }
+    }
+
+    bool more = false;
+    {
+      auto l = queue.Lock(); US_UNUSED(l);
+      if (*detached)
+      {
+        // The queue is kept alive by the listener entry, the dispatcher
+        // may already be destroyed.
+        queue.events.clear();
+        queue.scheduled = false;
+        return;
+      }
+      more = !queue.events.empty();
+      queue.scheduled = more;
+    }
+    if (more)
+    {
+      auto l = this->Lock(); US_UNUSED(l);
+      if (stopping)
+      {
+        l.UnLock();
+        auto l2 = queue.Lock(); US_UNUSED(l2);
+        queue.events.clear();
+        queue.scheduled = false;
+        return;
+      }
+      ready.push_back(listener);
+      Notify();
+    }
+  }
+}
+
+}
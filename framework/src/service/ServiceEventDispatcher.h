@@ -0,0 +1,135 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#ifndef CPPMICROSERVICES_SERVICEEVENTDISPATCHER_H
+#define CPPMICROSERVICES_SERVICEEVENTDISPATCHER_H
+
+#include "cppmicroservices/ServiceEvent.h"
+#include "cppmicroservices/detail/Threads.h"
+#include "cppmicroservices/detail/WaitCondition.h"
+
+#include "ServiceListenerEntry.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cppmicroservices {
+
+class CoreBundleContext;
+
+/**
+ * The events queued for a service listener which is called
+ * asynchronously. A listener is scheduled on at most one dispatcher
+ * thread at a time, which keeps its events in order.
+ */
+struct ServiceEventQueue : detail::MultiThreaded<>
+{
+  ServiceEventQueue()
+    : scheduled(false)
+    , overflowing(false)
+    , dropped(0)
+  {}
+
+  std::deque<ServiceEvent> events;
+
+  /* Whether the listener is in the dispatcher's ready list or being called */
+  bool scheduled;
+
+  /* Whether the last event was dropped because the queue was full */
+  bool overflowing;
+
+  /* The number of events dropped because the queue was full */
+  std::size_t dropped;
+};
+
+/**
+ * Delivers service events to asynchronous service listeners. The
+ * events are queued per listener and the listeners are called by a
+ * pool of framework threads, which is started on first use.
+ */
+class ServiceEventDispatcher : private detail::MultiThreaded<detail::MutexLockingStrategy<>, detail::WaitCondition>
+{
+
+public:
+
+  /**
+   * @param coreCtx The framework.
+   * @param threadCount The number of threads calling listeners.
+   * @param queueSize The maximum number of events queued per listener,
+   *        or zero for unbounded queues.
+   */
+  ServiceEventDispatcher(CoreBundleContext* coreCtx, std::size_t threadCount, std::size_t queueSize);
+
+  ~ServiceEventDispatcher();
+
+  /**
+   * Queue an event for an asynchronous service listener. If the
+   * listener's queue is full, the event is dropped and a
+   * FRAMEWORK_WARNING event is sent for the first dropped event.
+   *
+   * @param listener The listener, which must have an event queue.
+   * @param evt The service event.
+   * @return \c false if the event was dropped.
+   */
+  bool Post(const ServiceListenerEntry& listener, const ServiceEvent& evt);
+
+  /**
+   * Discard all queued events and wait for the threads to finish.
+   * The threads are started again when the next event is posted.
+   */
+  void Stop();
+
+  /**
+   * Get the number of events dropped because a listener queue was full.
+   */
+  std::size_t GetDroppedCount() const;
+
+private:
+
+  /**
+   * Call listeners until stopped. \c detached is set when Stop is called
+   * from the thread itself, which must then return without touching the
+   * possibly destroyed dispatcher.
+   */
+  void Run(std::shared_ptr<bool> detached);
+
+  void Schedule_unlocked(const ServiceListenerEntry& listener);
+
+  CoreBundleContext* const coreCtx;
+  const std::size_t threadCount;
+  const std::size_t queueSize;
+
+  /* Listeners with queued events, in the order they are called */
+  std::deque<ServiceListenerEntry> ready;
+  std::vector<std::pair<std::thread, std::shared_ptr<bool>>> threads;
+  bool stopping;
+
+  std::atomic<std::size_t> dropped;
+};
+
+}
+
+#endif // CPPMICROSERVICES_SERVICEEVENTDISPATCHER_H
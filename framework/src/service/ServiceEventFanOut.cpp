@@ -0,0 +1,143 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#include "ServiceEventFanOut.h"
+
+#include <algorithm>
+
+namespace cppmicroservices {
+
+ServiceEventFanOut::ServiceEventFanOut(std::size_t threadCount)
+  : threadCount(threadCount)
+  , stopping(false)
+{
+}
+
+ServiceEventFanOut::~ServiceEventFanOut()
+{
+  Stop();
+}
+
+void ServiceEventFanOut::Run(const std::vector<std::function<void()>>& tasks)
+{
+  if (tasks.empty())
+  {
+    return;
+  }
+
+  Batch batch = { &tasks, 0, tasks.size() };
+  auto l = this->Lock(); US_UNUSED(l);
+  if (!stopping && tasks.size() > 1)
+  {
+    batches.push_back(&batch);
+    const std::size_t wanted = std::min(threadCount, tasks.size() - 1);
+    while (threads.size() < wanted)
+    {
+      auto detached = std::make_shared<bool>(false);
+      threads.emplace_back(std::thread(&ServiceEventFanOut::RunThread, this, detached), detached);
+    }
+    NotifyAll();
+  }
+
+  // Run the tasks no thread has taken yet, then wait for the others.
+  while (batch.next < tasks.size())
+  {
+    const std::size_t i = Take_unlocked(&batch);
+    l.UnLock();
+    tasks[i]();
+    l.Lock();
+    --batch.pending;
+  }
+  Wait(l, [&batch] { return batch.pending == 0; });
+}
+
+std::size_t ServiceEventFanOut::Take_unlocked(Batch* batch)
+{
+  const std::size_t i = batch->next++;
+  if (batch->next == batch->tasks->size())
+  {
+    auto iter = std::find(batches.begin(), batches.end(), batch);
+    if (iter != batches.end())
+    {
+      batches.erase(iter);
+    }
+  }
+  return i;
+}
+
+void ServiceEventFanOut::Stop()
+{
+  std::vector<std::pair<std::thread, std::shared_ptr<bool>>> stopped;
+  {
+    auto l = this->Lock(); US_UNUSED(l);
+    stopping = true;
+    stopped.swap(threads);
+    NotifyAll();
+  }
+
+  for (auto& th : stopped)
+  {
+    // A listener may cause the framework to be destroyed.
+    if (th.first.get_id() == std::this_thread::get_id())
+    {
+      *th.second = true;
+      th.first.detach();
+    }
+    else
+    {
+      th.first.join();
+    }
+  }
+
+  this->Lock(), stopping = false;
+}
+
+void ServiceEventFanOut::RunThread(std::shared_ptr<bool> detached)
+{
+  auto l = this->Lock(); US_UNUSED(l);
+  for (;;)
+  {
+    Wait(l, [this] { return stopping || !batches.empty(); });
+    if (stopping)
+    {
+      return;
+    }
+
+    Batch* batch = batches.front();
+    const std::size_t i = Take_unlocked(batch);
+    l.UnLock();
+    (*batch->tasks)[i]();
+    l.Lock();
+    if (--batch->pending == 0)
+    {
+      NotifyAll();
+    }
+    // The caller of Run waits for the batch while the task stops the
+    // fan-out, so the fan-out lives at least until here.
+    if (*detached)
+    {
+      return;
+    }
+  }
+}
+
+}
@@ -0,0 +1,101 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#ifndef CPPMICROSERVICES_SERVICEEVENTFANOUT_H
+#define CPPMICROSERVICES_SERVICEEVENTFANOUT_H
+
+#include "cppmicroservices/detail/Threads.h"
+#include "cppmicroservices/detail/WaitCondition.h"
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cppmicroservices {
+
+/**
+ * Runs the partitions of a service event's synchronous receivers in
+ * parallel on a pool of framework threads, which is started on first use.
+ * The calling thread runs partitions as well and returns when all of
+ * them have been run, so a listener may register services itself
+ * without exhausting the pool.
+ */
+class ServiceEventFanOut : private detail::MultiThreaded<detail::MutexLockingStrategy<>, detail::WaitCondition>
+{
+
+public:
+
+  /**
+   * @param threadCount The number of pool threads, in addition to the
+   *        calling threads.
+   */
+  ServiceEventFanOut(std::size_t threadCount);
+
+  ~ServiceEventFanOut();
+
+  /**
+   * Run the given tasks, possibly in parallel, and wait for all of
+   * them to finish. The tasks must not throw.
+   */
+  void Run(const std::vector<std::function<void()>>& tasks);
+
+  /**
+   * Wait for the threads to finish. Tasks not yet taken by a thread are
+   * run by their calling thread, and the threads are started again by
+   * the next call to Run.
+   */
+  void Stop();
+
+private:
+
+  /* The tasks of one call to Run, which lives on the caller's stack */
+  struct Batch
+  {
+    const std::vector<std::function<void()>>* tasks;
+    std::size_t next;
+    std::size_t pending;
+  };
+
+  /**
+   * Run the tasks of the batches until stopped. \c detached is set when
+   * Stop is called from the thread itself, which must then return as
+   * soon as it has finished its task.
+   */
+  void RunThread(std::shared_ptr<bool> detached);
+
+  /* Takes the next task of a batch, the lock must be held */
+  std::size_t Take_unlocked(Batch* batch);
+
+  const std::size_t threadCount;
+
+  /* Batches with tasks not yet taken, in the order they were added */
+  std::deque<Batch*> batches;
+  std::vector<std::pair<std::thread, std::shared_ptr<bool>>> threads;
+  bool stopping;
+};
+
+}
+
+#endif // CPPMICROSERVICES_SERVICEEVENTFANOUT_H
@@ -104,17 +104,24 @@ bool ServiceHooks::IsOpen() const
 void ServiceHooks::FilterServiceReferences(BundleContextPrivate* context, const std::string& service,
                                            const std::string& filter, std::vector<ServiceReferenceBase>& refs)
 {
-  std::vector<ServiceRegistrationBase> srl;
-  coreCtx->services.Get_unlocked(us_service_interface_iid<ServiceFindHook>(), srl);
-  if (!srl.empty())
+  auto srl = coreCtx->services.GetHooks(ServiceRegistry::SERVICE_FIND_HOOK);
+  if (srl)
   {
     ShrinkableVector<ServiceReferenceBase> filtered(refs);
 
     auto selfBundle = GetBundleContext().GetBundle();
-    std::sort(srl.begin(), srl.end());
-    for (auto fhrIter = srl.rbegin(), fhrEnd = srl.rend(); fhrIter != fhrEnd; ++fhrIter)
+    for (auto fhrIter = srl->rbegin(), fhrEnd = srl->rend(); fhrIter != fhrEnd; ++fhrIter)
     {
-      ServiceReference<ServiceFindHook> sr = fhrIter->GetReference();
+      ServiceReference<ServiceFindHook> sr;
+      try
+      {
+        sr = fhrIter->GetReference();
+      }
+      catch (const std::logic_error&)
+      {
+        // The hook was unregistered after the snapshot was taken.
+        continue;
+      }
       auto fh = std::static_pointer_cast<ServiceFindHook>(sr.d.load()->GetService(GetPrivate(selfBundle).get()));
       if (fh)
       {
@@ -133,17 +140,23 @@ void ServiceHooks::FilterServiceReferences(BundleContextPrivate* context, const
 }
 
 void ServiceHooks::FilterServiceEventReceivers(const ServiceEvent& evt,
-                                               ServiceListeners::ServiceListenerEntries& receivers)
+                                               const ServiceListeners::ListenerSnapshot& snap,
+                                               std::vector<bool>& receivers)
 {
-  std::vector<ServiceRegistrationBase> eventListenerHooks;
-  coreCtx->services.Get(us_service_interface_iid<ServiceEventListenerHook>(), eventListenerHooks);
-  if (!eventListenerHooks.empty())
+  receivers.assign(snap.slotCount, true);
+  auto eventListenerHooks = coreCtx->services.GetHooks(ServiceRegistry::SERVICE_EVENT_LISTENER_HOOK);
+  if (eventListenerHooks)
   {
-    std::sort(eventListenerHooks.begin(), eventListenerHooks.end());
     std::map<BundleContext, std::vector<ServiceListenerHook::ListenerInfo> > listeners;
-    for (auto& sle : receivers)
+    for (auto& level : snap.levels)
     {
-      listeners[sle.GetBundleContext()].push_back(sle);
+      for (auto& sle : level->listeners)
+      {
+        if (!sle.IsRemoved())
+        {
+          listeners[sle.GetBundleContext()].push_back(sle);
+        }
+      }
     }
 
     std::map<BundleContext, ShrinkableVector<ServiceListenerHook::ListenerInfo> > shrinkableListeners;
@@ -157,9 +170,18 @@ void ServiceHooks::FilterServiceEventReceivers(const ServiceEvent& evt,
     ShrinkableMap<BundleContext, ShrinkableVector<ServiceListenerHook::ListenerInfo> > filtered(shrinkableListeners);
 
     auto selfBundle = GetBundleContext().GetBundle();
-    for(auto sriIter = eventListenerHooks.rbegin(), sriEnd = eventListenerHooks.rend(); sriIter != sriEnd; ++sriIter)
+    for(auto sriIter = eventListenerHooks->rbegin(), sriEnd = eventListenerHooks->rend(); sriIter != sriEnd; ++sriIter)
     {
-      ServiceReference<ServiceEventListenerHook> sr = sriIter->GetReference();
+      ServiceReference<ServiceEventListenerHook> sr;
+      try
+      {
+        sr = sriIter->GetReference();
+      }
+      catch (const std::logic_error&)
+      {
+        // The hook was unregistered after the snapshot was taken.
+        continue;
+      }
       auto elh = std::static_pointer_cast<ServiceEventListenerHook>(sr.d.load()->GetService(GetPrivate(selfBundle).get()));
       if(elh)
       {
@@ -174,10 +196,13 @@ void ServiceHooks::FilterServiceEventReceivers(const ServiceEvent& evt,
         }
       }
     }
-    receivers.clear();
-    for(auto l : listeners)
+    receivers.assign(snap.slotCount, false);
+    for (auto& l : listeners)
     {
-      receivers.insert(l.second.begin(), l.second.end());
+      for (auto& info : l.second)
+      {
+        receivers[ServiceListenerEntry(info).GetSlot()] = true;
+      }
     }
   }
 }
@@ -60,8 +60,17 @@ public:
   void FilterServiceReferences(BundleContextPrivate* context, const std::string& service,
                                const std::string& filter, std::vector<ServiceReferenceBase>& refs);
 
+  /**
+   * Let the event listener hooks filter the receivers of an event.
+   *
+   * @param evt The service event.
+   * @param snap The service listeners.
+   * @param receivers Receives one flag per listener slot in \c snap, telling
+   *        if the listener may receive the event.
+   */
   void FilterServiceEventReceivers(const ServiceEvent& evt,
-                                   ServiceListeners::ServiceListenerEntries& receivers);
+                                   const ServiceListeners::ListenerSnapshot& snap,
+                                   std::vector<bool>& receivers);
 
   void HandleServiceListenerReg(const ServiceListenerEntry& sle);
 
@@ -26,6 +26,11 @@ US_MSVC_PUSH_DISABLE_WARNING(4180) // qualifier applied to function type has no
 
 #include "ServiceListenerEntry.h"
 
+#include "BundleContextPrivate.h"
+#include "BundlePrivate.h"
+#include "CoreBundleContext.h"
+#include "ListenerCallHistogram.h"
+#include "ServiceEventDispatcher.h"
 #include "ServiceListenerHookPrivate.h"
 
 #include <cassert>
@@ -49,14 +54,18 @@ public:
   ServiceListenerEntryData& operator=(const ServiceListenerEntryData&) = delete;
 
   ServiceListenerEntryData(const std::shared_ptr<BundleContextPrivate>& context, const ServiceListener& l,
-                           void* data, ListenerTokenId tokenId, const std::string& filter)
+                           void* data, ListenerTokenId tokenId, const std::string& filter, bool async,
+                           bool statistics)
     : ServiceListenerHook::ListenerInfoData(context, l, data, tokenId, filter)
     , ldap()
     , hashValue(0)
+    , slot(0)
+    , queue(async ? new ServiceEventQueue() : nullptr)
+    , histogram(statistics ? new ListenerCallHistogram() : nullptr)
   {
     if (!filter.empty())
     {
-      ldap = LDAPExpr(filter);
+      ldap = context->bundle->coreCtx->ldapExprCache.Get(filter);
     }
   }
 
@@ -77,19 +86,33 @@ public:
    *        | '(' '|' Simple+ ')'
    * </pre>
    * where <code>attr</code> is one of Constants#OBJECTCLASS,
-   * Constants#SERVICE_ID or Constants#SERVICE_PID, and
+   * Constants#SERVICE_ID, Constants#SERVICE_PID or a key listed in
+   * Constants#FRAMEWORK_SERVICE_LISTENER_INDEXED_KEYS, and
    * <code>value</code> must not contain a wildcard character.
    * <p>
    * The index of the vector determines which key the cache is for
-   * (see ServiceListenerState#hashedKeys). For each key, there is
+   * (see ServiceListeners#hashedServiceKeys). For each key, there is
    * a vector pointing out the values which are accepted by this
-   * ServiceListenerEntry's filter. This cache is maintained to make
-   * it easy to remove this service listener.
+   * ServiceListenerEntry's filter. The cache is empty if the filter
+   * is not simple.
    */
   LDAPExpr::LocalCache local_cache;
 
   std::size_t hashValue;
 
+  std::size_t slot;
+
+  /**
+   * The events waiting to be delivered, if this listener is called
+   * asynchronously.
+   */
+  std::unique_ptr<ServiceEventQueue> queue;
+
+  /**
+   * The durations of the calls, if listener statistics are enabled.
+   */
+  std::unique_ptr<ListenerCallHistogram> histogram;
+
 };
 
 ServiceListenerEntry::ServiceListenerEntry()
@@ -127,8 +150,10 @@ ServiceListenerEntry::ServiceListenerEntry(
     const ServiceListener& l,
     void* data,
     ListenerTokenId tokenId,
-    const std::string& filter)
-  : ServiceListenerHook::ListenerInfo(new ServiceListenerEntryData(context, l, data, tokenId, filter))
+    const std::string& filter,
+    bool async,
+    bool statistics)
+  : ServiceListenerHook::ListenerInfo(new ServiceListenerEntryData(context, l, data, tokenId, filter, async, statistics))
 {
 }
 
@@ -147,6 +172,26 @@ void ServiceListenerEntry::CallDelegate(const ServiceEvent& event) const
   d->listener(event);
 }
 
+ServiceEventQueue* ServiceListenerEntry::GetEventQueue() const
+{
+  return static_cast<ServiceListenerEntryData*>(d.Data())->queue.get();
+}
+
+ListenerCallHistogram* ServiceListenerEntry::GetHistogram() const
+{
+  return static_cast<ServiceListenerEntryData*>(d.Data())->histogram.get();
+}
+
+std::size_t ServiceListenerEntry::GetSlot() const
+{
+  return static_cast<ServiceListenerEntryData*>(d.Data())->slot;
+}
+
+void ServiceListenerEntry::SetSlot(std::size_t slot) const
+{
+  static_cast<ServiceListenerEntryData*>(d.Data())->slot = slot;
+}
+
 bool ServiceListenerEntry::operator==(const ServiceListenerEntry& other) const
 {
   return ((d->context == nullptr || other.d->context == nullptr) || d->context == other.d->context) &&
@@ -34,7 +34,9 @@
 namespace cppmicroservices {
 
 class BundleContextPrivate;
+class ListenerCallHistogram;
 class ServiceListenerEntryData;
+struct ServiceEventQueue;
 
 /**
  * Data structure for saving service listener info. Contains
@@ -56,7 +58,8 @@ public:
   void SetRemoved(bool removed) const;
 
   ServiceListenerEntry(const std::shared_ptr<BundleContextPrivate>& context, const ServiceListener& l, void* data,
-                       ListenerTokenId tokenId, const std::string& filter = "");
+                       ListenerTokenId tokenId, const std::string& filter = "", bool async = false,
+                       bool statistics = false);
 
   const LDAPExpr& GetLDAPExpr() const;
 
@@ -64,6 +67,27 @@ public:
 
   void CallDelegate(const ServiceEvent& event) const;
 
+  /**
+   * Get the queue of events for asynchronous delivery, or \c nullptr
+   * if the listener is called synchronously.
+   */
+  ServiceEventQueue* GetEventQueue() const;
+
+  /**
+   * Get the call durations of the listener, or \c nullptr if listener
+   * statistics are disabled.
+   */
+  ListenerCallHistogram* GetHistogram() const;
+
+  /**
+   * Get the slot of the listener in the listener table of
+   * ServiceListeners. The slot is assigned when the listener is added
+   * and not reused as long as a listener snapshot contains it.
+   */
+  std::size_t GetSlot() const;
+
+  void SetSlot(std::size_t slot) const;
+
   bool operator==(const ServiceListenerEntry& other) const;
 
   bool Contains(const std::shared_ptr<BundleContextPrivate>& context, ListenerTokenId tokenId) const;
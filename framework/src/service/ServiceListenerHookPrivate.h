@@ -28,6 +28,8 @@
 
 #include "ServiceListenerEntry.h"
 
+#include <atomic>
+
 namespace cppmicroservices {
 
 class ServiceListenerHook::ListenerInfoData : public SharedData
@@ -43,7 +45,7 @@ public:
   void* data;
   ListenerTokenId tokenId;
   std::string filter;
-  bool bRemoved;
+  std::atomic<bool> bRemoved;
 };
 
 }
@@ -28,35 +28,311 @@ US_MSVC_PUSH_DISABLE_WARNING(4180) // qualifier applied to function type has no
 
 #include "cppmicroservices/FrameworkEvent.h"
 #include "cppmicroservices/ListenerFunctors.h"
+#include "cppmicroservices/ServiceEventListenerHook.h"
 
 #include "BundleContextPrivate.h"
 #include "BundlePrivate.h"
 #include "CoreBundleContext.h"
 #include "Properties.h"
 #include "ServiceReferenceBasePrivate.h"
+#include "ServiceRegistrationBasePrivate.h"
 #include "Utils.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <limits>
+#include <list>
+#include <type_traits>
 
 namespace cppmicroservices {
 
+namespace {
+
+/**
+ * Whether a listener of a snapshot may receive an event.
+ *
+ * @param receivers One flag per listener slot, or \c nullptr.
+ */
+bool IsReceiver(const ServiceListenerEntry& sle, const std::vector<bool>* receivers)
+{
+  return !sle.IsRemoved() && (receivers == nullptr || (*receivers)[sle.GetSlot()]);
+}
+
+template<class Cache, class Key>
+void AddToSet(const Cache& cache, const Key& key,
+              const ServiceListeners::ListenerSnapshot::Level& level,
+              const std::vector<bool>* receivers,
+              ServiceListeners::ServiceListenerEntries& set)
+{
+  auto iter = cache.find(key);
+  if (iter != cache.end())
+  {
+    for (auto index : iter->second)
+    {
+      if (IsReceiver(level.listeners[index], receivers))
+      {
+        set.insert(level.listeners[index]);
+      }
+    }
+  }
+}
+
+void AddToKeyIndex(ServiceListeners::ListenerSnapshot::KeyIndex& index, const std::string& value, std::size_t listener)
+{
+  index.strings[value].push_back(listener);
+
+  // LDAPExpr compares integral values with every value strtol can parse.
+  errno = 0;
+  char* endptr = nullptr;
+  long longInt = strtol(value.c_str(), &endptr, 10);
+  if (!((errno == ERANGE && (longInt == std::numeric_limits<long>::max() || longInt == std::numeric_limits<long>::min())) ||
+        (errno != 0 && longInt == 0) || endptr == value.c_str()))
+  {
+    index.integers[longInt].push_back(listener);
+    index.minInteger = std::min(index.minInteger, longInt);
+    index.maxInteger = std::max(index.maxInteger, longInt);
+  }
+
+  if (index.listeners.empty() || index.listeners.back() != listener)
+  {
+    index.listeners.push_back(listener);
+  }
+}
+
+template<class T>
+bool InRange(long long value)
+{
+  return value < 0 ? (std::numeric_limits<T>::is_signed && value >= static_cast<long long>(std::numeric_limits<T>::min()))
+                   : static_cast<unsigned long long>(value) <= static_cast<unsigned long long>(std::numeric_limits<T>::max());
+}
+
+template<class T>
+bool InRange(unsigned long long value)
+{
+  return value <= static_cast<unsigned long long>(std::numeric_limits<T>::max());
+}
+
+/**
+ * LDAPExpr compares an integer property of type T with
+ * static_cast<T>(filterValue), so the listeners can only be looked up
+ * by value if all their filter values fit into T.
+ */
+template<class T>
+bool AddIntegerToSet(const Any& value, const ServiceListeners::ListenerSnapshot::KeyIndex& index,
+                     const ServiceListeners::ListenerSnapshot::Level& level,
+                     const std::vector<bool>* receivers,
+                     ServiceListeners::ServiceListenerEntries& set)
+{
+  typedef typename std::conditional<std::numeric_limits<T>::is_signed, long long, unsigned long long>::type Wide;
+
+  if (index.integers.empty())
+  {
+    return true;
+  }
+  if (!InRange<T>(static_cast<long long>(index.minInteger)) || !InRange<T>(static_cast<long long>(index.maxInteger)))
+  {
+    return false;
+  }
+  const Wide v = static_cast<Wide>(ref_any_cast<T>(value));
+  if (InRange<long>(v))
+  {
+    AddToSet(index.integers, static_cast<long>(v), level, receivers, set);
+  }
+  return true;
+}
+
+/**
+ * Add the listeners of an index accepting a property value to the set.
+ * Returns false if the value has a type which cannot be looked up.
+ */
+bool AddValueToSet(const Any& value, const ServiceListeners::ListenerSnapshot::KeyIndex& index,
+                   const ServiceListeners::ListenerSnapshot::Level& level,
+                   const std::vector<bool>* receivers,
+                   ServiceListeners::ServiceListenerEntries& set)
+{
+  const std::type_info& type = value.Type();
+  if (type == typeid(std::string))
+  {
+    AddToSet(index.strings, ref_any_cast<std::string>(value), level, receivers, set);
+  }
+  else if (type == typeid(std::vector<std::string>))
+  {
+    for (auto& s : ref_any_cast<std::vector<std::string> >(value))
+    {
+      AddToSet(index.strings, s, level, receivers, set);
+    }
+  }
+  else if (type == typeid(std::list<std::string>))
+  {
+    for (auto& s : ref_any_cast<std::list<std::string> >(value))
+    {
+      AddToSet(index.strings, s, level, receivers, set);
+    }
+  }
+  else if (type == typeid(char))
+  {
+    AddToSet(index.strings, std::string(1, ref_any_cast<char>(value)), level, receivers, set);
+  }
+  else if (type == typeid(short))
+  {
+    return AddIntegerToSet<short>(value, index, level, receivers, set);
+  }
+  else if (type == typeid(int))
+  {
+    return AddIntegerToSet<int>(value, index, level, receivers, set);
+  }
+  else if (type == typeid(long int))
+  {
+    return AddIntegerToSet<long int>(value, index, level, receivers, set);
+  }
+  else if (type == typeid(long long int))
+  {
+    return AddIntegerToSet<long long int>(value, index, level, receivers, set);
+  }
+  else if (type == typeid(unsigned char))
+  {
+    return AddIntegerToSet<unsigned char>(value, index, level, receivers, set);
+  }
+  else if (type == typeid(unsigned short))
+  {
+    return AddIntegerToSet<unsigned short>(value, index, level, receivers, set);
+  }
+  else if (type == typeid(unsigned int))
+  {
+    return AddIntegerToSet<unsigned int>(value, index, level, receivers, set);
+  }
+  else if (type == typeid(unsigned long int))
+  {
+    return AddIntegerToSet<unsigned long int>(value, index, level, receivers, set);
+  }
+  else if (type == typeid(unsigned long long int))
+  {
+    return AddIntegerToSet<unsigned long long int>(value, index, level, receivers, set);
+  }
+  else
+  {
+    // bool, floating point and Any lists are compared by LDAPExpr with
+    // conversions which are not worth mirroring here.
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Add the distinct lower-case attribute names an expression depends on.
+ */
+void GetAttrNames(const LDAPExpr& expr, std::vector<std::string>& names)
+{
+  if (expr.IsNull())
+  {
+    return;
+  }
+  if ((expr.GetOperator() & LDAPExpr::SIMPLE) != 0)
+  {
+    std::string name = expr.GetAttrName();
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    if (std::find(names.begin(), names.end(), name) == names.end())
+    {
+      names.push_back(name);
+    }
+  }
+  else
+  {
+    for (auto& arg : expr.GetArgs())
+    {
+      GetAttrNames(arg, names);
+    }
+  }
+}
+
+}
+
+ServiceListeners::ListenerSnapshot::KeyIndex::KeyIndex()
+  : minInteger(std::numeric_limits<long>::max())
+  , maxInteger(std::numeric_limits<long>::min())
+{
+}
+
+ServiceListeners::ListenerSnapshot::ListenerSnapshot()
+  : slotCount(0)
+{
+}
+
 ServiceListeners::ServiceListeners(CoreBundleContext* coreCtx)
-  : listenerId(0), coreCtx(coreCtx)
+  : listenerId(0), removedCount(0), asyncDelivery(false), listenerStatistics(false), slowListenerThreshold(0), coreCtx(coreCtx)
 {
+  snapshot.Store(std::make_shared<ListenerSnapshot>());
+
   hashedServiceKeys.push_back(Constants::OBJECTCLASS);
   hashedServiceKeys.push_back(Constants::SERVICE_ID);
+  hashedServiceKeys.push_back(Constants::SERVICE_PID);
+
+  const auto& props = coreCtx->frameworkProperties;
+  for (auto key : GetStringListProperty(props, Constants::FRAMEWORK_SERVICE_LISTENER_INDEXED_KEYS))
+  {
+    std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+    if (!key.empty() && std::find(hashedServiceKeys.begin(), hashedServiceKeys.end(), key) == hashedServiceKeys.end())
+    {
+      hashedServiceKeys.push_back(key);
+    }
+  }
+
+  auto iter = props.find(Constants::FRAMEWORK_SERVICE_LISTENER_ASYNC);
+  if (iter != props.end())
+  {
+    asyncDelivery = any_cast<bool>(iter->second);
+  }
+  iter = props.find(Constants::FRAMEWORK_LISTENER_STATISTICS);
+  if (iter != props.end())
+  {
+    listenerStatistics = any_cast<bool>(iter->second);
+  }
+  slowListenerThreshold = std::chrono::milliseconds(
+      GetSizeProperty(props, Constants::FRAMEWORK_LISTENER_WARNING_THRESHOLD, 0));
+  const std::size_t threadCount =
+      std::max<std::size_t>(1, GetSizeProperty(props, Constants::FRAMEWORK_SERVICE_LISTENER_THREADS, 2));
+  const std::size_t queueSize = GetSizeProperty(props, Constants::FRAMEWORK_SERVICE_LISTENER_QUEUE_SIZE, 1024);
+  const std::size_t parallelThreadCount = GetSizeProperty(props, Constants::FRAMEWORK_SERVICE_LISTENER_PARALLEL_THREADS, 0);
+#ifdef US_ENABLE_THREADING_SUPPORT
+  dispatcher.reset(new ServiceEventDispatcher(coreCtx, threadCount, queueSize));
+  coalescer.reset(new ServiceEventCoalescer());
+  if (parallelThreadCount > 0)
+  {
+    fanOut.reset(new ServiceEventFanOut(parallelThreadCount));
+  }
+#else
+  US_UNUSED(threadCount);
+  US_UNUSED(queueSize);
+  US_UNUSED(parallelThreadCount);
+#endif
 }
 
 void ServiceListeners::Clear()
 {
+  if (coalescer)
+  {
+    coalescer->Stop();
+  }
+  if (dispatcher)
+  {
+    dispatcher->Stop();
+  }
+  if (fanOut)
+  {
+    fanOut->Stop();
+  }
+
   bundleListenerMap.Lock(), bundleListenerMap.value.clear();
   {
     auto l = this->Lock(); US_UNUSED(l);
-    serviceSet.clear();
-    hashedServiceKeys.clear();
-    complicatedListeners.clear();
-    cache[0].clear();
-    cache[1].clear();
+    snapshot.Store(std::make_shared<ListenerSnapshot>());
+    slots.clear();
+    freeSlots.clear();
+    tokenSlots.clear();
+    contextSlots.clear();
+    removedCount = 0;
   }
 
   frameworkListenerMap.Lock(), frameworkListenerMap.value.clear();
@@ -68,7 +344,8 @@ ListenerToken ServiceListeners::MakeListenerToken()
 }
 
 ListenerToken ServiceListeners::AddServiceListener(const std::shared_ptr<BundleContextPrivate>& context, const ServiceListener& listener,
-                                                   void* data, const std::string& filter)
+                                                   void* data, const std::string& filter,
+                                                   ServiceListenerDelivery delivery)
 {
   // The following condition is true only if the listener is a non-static member function.
   // If so, the existing listener is replaced with the new listener.
@@ -77,12 +354,50 @@ ListenerToken ServiceListeners::AddServiceListener(const std::shared_ptr<BundleC
     RemoveServiceListener(context, ListenerTokenId(0), listener, data);
   }
 
+  // Without threading support, all listeners are called synchronously.
+  const bool async = dispatcher && (delivery == ServiceListenerDelivery::ASYNCHRONOUS ||
+                                    (delivery == ServiceListenerDelivery::DEFAULT && asyncDelivery));
+
   auto token = MakeListenerToken();
-  ServiceListenerEntry sle(context, listener, data, token.Id(), filter);
+  ServiceListenerEntry sle(context, listener, data, token.Id(), filter, async, listenerStatistics);
   {
     auto l = this->Lock(); US_UNUSED(l);
-    serviceSet.insert(sle);
+    std::size_t slot = slots.size();
+    if (freeSlots.empty())
+    {
+      slots.push_back(ListenerSlot());
+    }
+    else
+    {
+      slot = freeSlots.back();
+      freeSlots.pop_back();
+    }
+    auto head = contextSlots.insert(std::make_pair(context, slot));
+    slots[slot].entry = sle;
+    slots[slot].prev = NO_SLOT;
+    slots[slot].next = NO_SLOT;
+    if (!head.second)
+    {
+      slots[slot].next = head.first->second;
+      slots[head.first->second].prev = slot;
+      head.first->second = slot;
+    }
+    tokenSlots.insert(std::make_pair(sle.Id(), slot));
+    sle.SetSlot(slot);
     CheckSimple_unlocked(sle);
+
+    // Merge the newest levels into the level of the new listener as long
+    // as they are not much larger, keeping the number of levels and the
+    // number of times a listener is indexed again logarithmic.
+    auto levels = snapshot.Load()->levels;
+    std::vector<ServiceListenerEntry> listeners(1, sle);
+    while (!levels.empty() && levels.back()->listeners.size() <= 2 * listeners.size())
+    {
+      listeners.insert(listeners.end(), levels.back()->listeners.begin(), levels.back()->listeners.end());
+      levels.pop_back();
+    }
+    levels.push_back(MakeLevel_unlocked(listeners));
+    StoreSnapshot_unlocked(std::move(levels));
   }
   coreCtx->serviceHooks.HandleServiceListenerReg(sle);
   return token;
@@ -94,31 +409,36 @@ void ServiceListeners::RemoveServiceListener(const std::shared_ptr<BundleContext
   ServiceListenerEntry sle;
   {
     auto l = this->Lock(); US_UNUSED(l);
-    std::function<bool(const ServiceListenerEntry&)> entryExists;
     if (tokenId)
     {
       assert(!listener);
       assert(data == nullptr);
-      entryExists = [&context, &tokenId](const ServiceListenerEntry& entry) -> bool
+      auto it = tokenSlots.find(tokenId);
+      if (it != tokenSlots.end() && slots[it->second].entry.Contains(context, tokenId))
       {
-        return entry.Contains(context, tokenId);
-      };
+        sle = slots[it->second].entry;
+      }
     }
     else
     {
-      entryExists = [&context, &listener, &data](const ServiceListenerEntry& entry) -> bool
+      // Only the listeners of the given context can match.
+      auto contextIt = contextSlots.find(context);
+      if (contextIt != contextSlots.end())
       {
-        return entry.Contains(context, listener, data);
-      };
+        for (auto slot = contextIt->second; slot != NO_SLOT; slot = slots[slot].next)
+        {
+          if (slots[slot].entry.Contains(context, listener, data))
+          {
+            sle = slots[slot].entry;
+            break;
+          }
+        }
+      }
     }
 
-    auto it = std::find_if(serviceSet.begin(), serviceSet.end(), entryExists);
-    if (it != serviceSet.end())
+    if (!sle.IsNull())
     {
-      sle = *it;
-      it->SetRemoved(true);
-      RemoveFromCache_unlocked(*it);
-      serviceSet.erase(it);
+      RemoveServiceListener_unlocked(sle);
     }
   }
   if (!sle.IsNull())
@@ -133,7 +453,8 @@ ListenerToken ServiceListeners::AddBundleListener(const std::shared_ptr<BundleCo
 
   auto l = bundleListenerMap.Lock(); US_UNUSED(l);
   auto& listeners = bundleListenerMap.value[context];
-  listeners[token.Id()] = std::make_tuple(listener, data);
+  listeners[token.Id()] = std::make_tuple(
+      listener, data, listenerStatistics ? std::make_shared<ListenerCallHistogram>() : nullptr);
   return token;
 }
 
@@ -167,7 +488,8 @@ ListenerToken ServiceListeners::AddFrameworkListener(const std::shared_ptr<Bundl
 
   auto l = frameworkListenerMap.Lock(); US_UNUSED(l);
   auto& listeners = frameworkListenerMap.value[context];
-  listeners[token.Id()] = std::make_tuple(listener, data);
+  listeners[token.Id()] = std::make_tuple(
+      listener, data, listenerStatistics ? std::make_shared<ListenerCallHistogram>() : nullptr);
   return token;
 }
 
@@ -233,6 +555,7 @@ void ServiceListeners::SendFrameworkEvent(const FrameworkEvent& evt)
   {
     for (auto& listener : listeners.second)
     {
+      const auto start = IsTimed() ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
       try
       {
         std::get<0>(listener.second)(evt);
@@ -244,6 +567,16 @@ void ServiceListeners::SendFrameworkEvent(const FrameworkEvent& evt)
         // @todo send this to the LogService instead when its supported.
         DIAG_LOG(*coreCtx->sink) << "A Framework Listener threw an exception: " << GetLastExceptionStr() << "\n";
       }
+      if (IsTimed())
+      {
+        auto slow = RecordCall(std::get<2>(listener.second).get(), start);
+        if (slow.count())
+        {
+          // Same as for exceptions, a warning event could cause an infinite loop.
+          DIAG_LOG(*coreCtx->sink) << "A Framework Listener took "
+                                   << std::chrono::duration_cast<std::chrono::milliseconds>(slow).count() << " ms\n";
+        }
+      }
     }
   }
 }
@@ -257,6 +590,7 @@ void ServiceListeners::BundleChanged(const BundleEvent& evt)
   {
     for (auto& bundleListener : bundleListeners.second)
     {
+      const auto start = IsTimed() ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
       try
       {
         std::get<0>(bundleListener.second)(evt);
@@ -269,6 +603,14 @@ void ServiceListeners::BundleChanged(const BundleEvent& evt)
             std::string("Bundle listener threw an exception"),
             std::current_exception()));
       }
+      if (IsTimed())
+      {
+        auto slow = RecordCall(std::get<2>(bundleListener.second).get(), start);
+        if (slow.count())
+        {
+          WarnSlowListener(MakeBundle(bundleListeners.first->bundle->shared_from_this()), "Bundle listener", slow);
+        }
+      }
     }
   }
 }
@@ -277,18 +619,14 @@ void ServiceListeners::RemoveAllListeners(const std::shared_ptr<BundleContextPri
 {
   {
     auto l = this->Lock(); US_UNUSED(l);
-    for (ServiceListenerEntries::iterator it = serviceSet.begin();
-         it != serviceSet.end(); )
+    auto contextIt = contextSlots.find(context);
+    if (contextIt != contextSlots.end())
     {
-
-      if (GetPrivate(it->GetBundleContext()) == context)
-      {
-        RemoveFromCache_unlocked(*it);
-        serviceSet.erase(it++);
-      }
-      else
+      for (auto slot = contextIt->second; slot != NO_SLOT; )
       {
-        ++it;
+        ServiceListenerEntry sle = slots[slot].entry;
+        slot = slots[slot].next;
+        RemoveServiceListener_unlocked(sle);
       }
     }
   }
@@ -309,11 +647,12 @@ void ServiceListeners::HooksBundleStopped(const std::shared_ptr<BundleContextPri
   std::vector<ServiceListenerEntry> entries;
   {
     auto l = this->Lock(); US_UNUSED(l);
-    for (auto& sle : serviceSet)
+    auto contextIt = contextSlots.find(context);
+    if (contextIt != contextSlots.end())
     {
-      if (sle.GetBundleContext() == MakeBundleContext(context))
+      for (auto slot = contextIt->second; slot != NO_SLOT; slot = slots[slot].next)
       {
-        entries.push_back(sle);
+        entries.push_back(slots[slot].entry);
       }
     }
   }
@@ -341,150 +680,529 @@ void ServiceListeners::ServiceChanged(ServiceListenerEntries& receivers,
     }
   }
 
+  if (fanOut && receivers.size() > 1)
+  {
+    // Partition the synchronous receivers by bundle, keeping the order
+    // of each bundle's listeners, and call the partitions in parallel.
+    std::unordered_map<std::shared_ptr<BundleContextPrivate>, std::size_t> partitionIndexes;
+    std::vector<std::vector<const ServiceListenerEntry*>> partitions;
+    for (auto& l : receivers)
+    {
+      if (!l.IsRemoved())
+      {
+        ++n;
+        if (l.GetEventQueue() != nullptr)
+        {
+          dispatcher->Post(l, evt);
+        }
+        else
+        {
+          auto ins = partitionIndexes.insert(std::make_pair(GetPrivate(l.GetBundleContext()), partitions.size()));
+          if (ins.second)
+          {
+            partitions.emplace_back();
+          }
+          partitions[ins.first->second].push_back(&l);
+        }
+      }
+    }
+
+    std::vector<std::function<void()>> tasks;
+    tasks.reserve(partitions.size());
+    for (auto& partition : partitions)
+    {
+      tasks.push_back([this, &partition, &evt] {
+        for (auto l : partition)
+        {
+          if (!l->IsRemoved())
+          {
+            CallServiceListener(*l, evt);
+          }
+        }
+      });
+    }
+    fanOut->Run(tasks);
+    return;
+  }
+
   for (auto& l : receivers)
   {
     if (!l.IsRemoved())
     {
-      try
+      ++n;
+      if (l.GetEventQueue() != nullptr)
       {
-        ++n;
-        l.CallDelegate(evt);
+        dispatcher->Post(l, evt);
       }
-      catch (...)
+      else
       {
-        std::string message("Service listener in " + l.GetBundleContext().GetBundle().GetSymbolicName() + " threw an exception!");
-        SendFrameworkEvent(FrameworkEvent(
-            FrameworkEvent::Type::FRAMEWORK_ERROR,
-            l.GetBundleContext().GetBundle(),
-            message,
-            std::current_exception()));
+        CallServiceListener(l, evt);
       }
     }
   }
 
 }
 
+void ServiceListeners::CallServiceListener(const ServiceListenerEntry& l, const ServiceEvent& evt)
+{
+  const auto start = IsTimed() ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+  std::exception_ptr error;
+  try
+  {
+    l.CallDelegate(evt);
+  }
+  catch (...)
+  {
+    error = std::current_exception();
+  }
+  ServiceListenerCalled(l, start, error);
+}
+
+void ServiceListeners::ServiceListenerCalled(const ServiceListenerEntry& l,
+                                             std::chrono::steady_clock::time_point start,
+                                             std::exception_ptr error)
+{
+  if (error)
+  {
+    std::string message("Service listener in " + l.GetBundleContext().GetBundle().GetSymbolicName() + " threw an exception!");
+    SendFrameworkEvent(FrameworkEvent(
+        FrameworkEvent::Type::FRAMEWORK_ERROR,
+        l.GetBundleContext().GetBundle(),
+        message,
+        error));
+  }
+  if (start != std::chrono::steady_clock::time_point())
+  {
+    auto slow = RecordCall(l.GetHistogram(), start);
+    if (slow.count())
+    {
+      std::string filter = l.GetFilter();
+      WarnSlowListener(l.GetBundleContext().GetBundle(),
+                       filter.empty() ? std::string("Service listener") : "Service listener with filter " + filter,
+                       slow);
+    }
+  }
+}
+
+bool ServiceListeners::IsTimed() const
+{
+  return listenerStatistics || slowListenerThreshold.count() != 0;
+}
+
+std::chrono::nanoseconds ServiceListeners::RecordCall(ListenerCallHistogram* histogram,
+                                                      std::chrono::steady_clock::time_point start) const
+{
+  const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+  if (histogram)
+  {
+    histogram->Record(duration);
+  }
+  if (slowListenerThreshold.count() != 0 && duration > slowListenerThreshold)
+  {
+    return duration;
+  }
+  return std::chrono::nanoseconds::zero();
+}
+
+void ServiceListeners::WarnSlowListener(const Bundle& bundle, const std::string& listener,
+                                        std::chrono::nanoseconds duration)
+{
+  SendFrameworkEvent(FrameworkEvent(
+      FrameworkEvent::Type::FRAMEWORK_WARNING,
+      bundle,
+      listener + " in " + bundle.GetSymbolicName() + " took " +
+      cppmicroservices::ToString(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count()) + " ms"));
+}
+
+std::vector<ListenerStatistics> ServiceListeners::GetListenerStatistics() const
+{
+  std::vector<ListenerStatistics> result;
+  auto add = [&result](ListenerStatistics::Type type, const std::shared_ptr<BundleContextPrivate>& context,
+                       const std::string& filter, const ListenerCallHistogram& histogram)
+  {
+    ListenerStatistics stats;
+    stats.type = type;
+    if (context->bundle)
+    {
+      stats.bundle = MakeBundle(context->bundle->shared_from_this());
+    }
+    stats.filter = filter;
+    histogram.Get(stats);
+    result.push_back(stats);
+  };
+
+  {
+    auto l = this->Lock(); US_UNUSED(l);
+    for (auto& tokenSlot : tokenSlots)
+    {
+      const ServiceListenerEntry& entry = slots[tokenSlot.second].entry;
+      if (auto histogram = entry.GetHistogram())
+      {
+        add(ListenerStatistics::Type::SERVICE_LISTENER, GetPrivate(entry.GetBundleContext()),
+            entry.GetFilter(), *histogram);
+      }
+    }
+  }
+
+  {
+    auto l = bundleListenerMap.Lock(); US_UNUSED(l);
+    for (auto& listeners : bundleListenerMap.value)
+    {
+      for (auto& listener : listeners.second)
+      {
+        if (auto& histogram = std::get<2>(listener.second))
+        {
+          add(ListenerStatistics::Type::BUNDLE_LISTENER, listeners.first, std::string(), *histogram);
+        }
+      }
+    }
+  }
+
+  {
+    auto l = frameworkListenerMap.Lock(); US_UNUSED(l);
+    for (auto& listeners : frameworkListenerMap.value)
+    {
+      for (auto& listener : listeners.second)
+      {
+        if (auto& histogram = std::get<2>(listener.second))
+        {
+          add(ListenerStatistics::Type::FRAMEWORK_LISTENER, listeners.first, std::string(), *histogram);
+        }
+      }
+    }
+  }
+
+  return result;
+}
+
+ServiceListeners::ListenerSnapshotConstPtr ServiceListeners::GetSnapshot() const
+{
+  return snapshot.Load();
+}
+
+std::shared_ptr<const ServiceListeners::ListenerSnapshot::Level>
+ServiceListeners::MakeLevel_unlocked(const std::vector<ServiceListenerEntry>& listeners)
+{
+  auto level = std::make_shared<ListenerSnapshot::Level>();
+  level->listeners.reserve(listeners.size());
+  for (auto& sle : listeners)
+  {
+    if (sle.IsRemoved())
+    {
+      slots[sle.GetSlot()].entry = ServiceListenerEntry();
+      freeSlots.push_back(sle.GetSlot());
+      --removedCount;
+    }
+    else
+    {
+      level->listeners.push_back(sle);
+    }
+  }
+
+  level->keyIndexes.resize(hashedServiceKeys.size());
+  std::vector<std::string> attrNames;
+  for (std::size_t i = 0; i < level->listeners.size(); ++i)
+  {
+    attrNames.clear();
+    GetAttrNames(level->listeners[i].GetLDAPExpr(), attrNames);
+    for (auto& attrName : attrNames)
+    {
+      level->dependents[attrName].push_back(i);
+    }
+
+    const LDAPExpr::LocalCache& localCache = level->listeners[i].GetLocalCache();
+    if (localCache.empty())
+    {
+      const LDAPExpr& ldapExpr = level->listeners[i].GetLDAPExpr();
+      if (ldapExpr.IsNull())
+      {
+        level->unfilteredListeners.push_back(i);
+      }
+      else
+      {
+        level->complicatedListeners.push_back(i);
+        level->complicatedFilters.push_back(level->filters.Add(ldapExpr));
+      }
+      continue;
+    }
+    for (std::size_t k = 0; k < localCache.size(); ++k)
+    {
+      for (auto& value : localCache[k])
+      {
+        if (k == static_cast<std::size_t>(OBJECTCLASS_IX))
+        {
+          level->classCache[InterfaceIdTable::Instance().Intern(value)].push_back(i);
+        }
+        else
+        {
+          AddToKeyIndex(level->keyIndexes[k], value, i);
+        }
+      }
+    }
+  }
+  return level;
+}
+
+void ServiceListeners::StoreSnapshot_unlocked(std::vector<std::shared_ptr<const ListenerSnapshot::Level> >&& levels)
+{
+  auto newSnap = std::make_shared<ListenerSnapshot>();
+  newSnap->levels = std::move(levels);
+  newSnap->slotCount = slots.size();
+  snapshot.Store(newSnap);
+}
+
 void ServiceListeners::GetMatchingServiceListeners(const ServiceEvent& evt, ServiceListenerEntries& set)
 {
-  // Filter the original set of listeners
-  ServiceListenerEntries receivers = (this->Lock(), serviceSet);
-  // This must not be called with any locks held
-  coreCtx->serviceHooks.FilterServiceEventReceivers(evt, receivers);
+  GetMatchingServiceListeners(evt, *GetSnapshot(), set);
+}
+
+void ServiceListeners::GetMatchingServiceListeners(const ServiceEvent& evt, ModifiedMatch& before)
+{
+  before.snapshot = GetSnapshot();
+  before.hooked = GetMatchingServiceListeners(evt, *before.snapshot, before.listeners);
+}
+
+void ServiceListeners::GetMatchingServiceListeners(const ServiceEvent& evt,
+                                                   const ModifiedMatch& before,
+                                                   const std::vector<std::string>& changedKeys,
+                                                   ServiceListenerEntries& set)
+{
+  auto snap = GetSnapshot();
+
+  // Hooks may filter the listeners of each event differently, and new
+  // listeners have not been matched yet.
+  if (before.hooked || snap != before.snapshot ||
+      coreCtx->services.HasHooks(ServiceRegistry::SERVICE_EVENT_LISTENER_HOOK))
+  {
+    GetMatchingServiceListeners(evt, *snap, set);
+    return;
+  }
+
+  std::vector<bool> affected(snap->slotCount, false);
+  std::vector<const ServiceListenerEntry*> affectedListeners;
+  for (auto& key : changedKeys)
+  {
+    for (auto& level : snap->levels)
+    {
+      auto iter = level->dependents.find(key);
+      if (iter == level->dependents.end()) continue;
+      for (auto index : iter->second)
+      {
+        const ServiceListenerEntry& sle = level->listeners[index];
+        if (!affected[sle.GetSlot()])
+        {
+          affected[sle.GetSlot()] = true;
+          affectedListeners.push_back(&sle);
+        }
+      }
+    }
+  }
+
+  for (auto& sle : before.listeners)
+  {
+    if (!affected[sle.GetSlot()])
+    {
+      set.insert(sle);
+    }
+  }
+
+  if (!affectedListeners.empty())
+  {
+    auto ref = evt.GetServiceReference();
+    auto props = ref.d.load()->GetProperties();
+    for (auto sle : affectedListeners)
+    {
+      if (!sle->IsRemoved() && sle->GetLDAPExpr().Evaluate(props, false))
+      {
+        set.insert(*sle);
+      }
+    }
+  }
+}
+
+bool ServiceListeners::GetMatchingServiceListeners(const ServiceEvent& evt,
+                                                   const ListenerSnapshot& snap,
+                                                   ServiceListenerEntries& set)
+{
+  // Filter the listeners only if there are event listener hooks.
+  std::vector<bool> receivers;
+  const bool hooked = coreCtx->services.HasHooks(ServiceRegistry::SERVICE_EVENT_LISTENER_HOOK);
+  if (hooked)
+  {
+    // This must not be called with any locks held
+    coreCtx->serviceHooks.FilterServiceEventReceivers(evt, snap, receivers);
+  }
 
   // Get a copy of the service reference and keep it until we are
   // done with its properties.
   auto ref = evt.GetServiceReference();
   auto props = ref.d.load()->GetProperties();
 
+  GetMatchingServiceListeners(snap, ref.d.load()->registration->classIds, props,
+                              hooked ? &receivers : nullptr, set);
+  return hooked;
+}
+
+void ServiceListeners::GetMatchingServiceListeners(const std::vector<ServiceEvent>& evts,
+                                                   std::vector<ServiceListenerEntries>& listeners)
+{
+  listeners.resize(evts.size());
+
+  auto snap = GetSnapshot();
+
+  // Filter the listeners for each event only if there are event
+  // listener hooks.
+  std::vector<std::vector<bool> > receivers;
+  if (coreCtx->services.HasHooks(ServiceRegistry::SERVICE_EVENT_LISTENER_HOOK))
   {
-    auto l = this->Lock(); US_UNUSED(l);
-    // Check complicated or empty listener filters
-    for (auto& sse : complicatedListeners)
+    receivers.resize(evts.size());
+    for (std::size_t i = 0; i < evts.size(); ++i)
     {
-      if (receivers.count(sse) == 0) continue;
-      const LDAPExpr& ldapExpr = sse.GetLDAPExpr();
-      if (ldapExpr.IsNull() ||
-          ldapExpr.Evaluate(props, false))
+      // This must not be called with any locks held
+      coreCtx->serviceHooks.FilterServiceEventReceivers(evts[i], *snap, receivers[i]);
+    }
+  }
+
+  for (std::size_t i = 0; i < evts.size(); ++i)
+  {
+    auto ref = evts[i].GetServiceReference();
+    auto registration = ref.d.load()->registration;
+    PropertiesHandle props(registration->properties, false);
+    GetMatchingServiceListeners(*snap, registration->classIds, props, receivers.empty() ? nullptr : &receivers[i],
+                                listeners[i]);
+  }
+}
+
+void ServiceListeners::GetMatchingServiceListeners(const ListenerSnapshot& snap,
+                                                   const std::vector<InterfaceIdTable::Id>& classIds,
+                                                   const PropertiesHandle& props,
+                                                   const std::vector<bool>* receivers,
+                                                   ServiceListenerEntries& set) const
+{
+  for (auto& level : snap.levels)
+  {
+    // Check empty listener filters
+    for (auto index : level->unfilteredListeners)
+    {
+      if (IsReceiver(level->listeners[index], receivers))
       {
-        set.insert(sse);
+        set.insert(level->listeners[index]);
       }
     }
 
-  // Check the cache
-    const auto c = any_cast<std::vector<std::string>>(props->Value_unlocked(Constants::OBJECTCLASS));
-    for (auto& objClass : c)
+    // Check complicated listener filters, evaluating each distinct
+    // sub-expression at most once
+    if (!level->complicatedListeners.empty())
     {
-      AddToSet_unlocked(set, receivers, OBJECTCLASS_IX, objClass);
+      LDAPExprNetwork::Evaluation evaluation(level->filters, props);
+      for (std::size_t i = 0; i < level->complicatedListeners.size(); ++i)
+      {
+        const ServiceListenerEntry& sle = level->listeners[level->complicatedListeners[i]];
+        if (IsReceiver(sle, receivers) && evaluation.Evaluate(level->complicatedFilters[i]))
+        {
+          set.insert(sle);
+        }
+      }
     }
 
-    long service_id = any_cast<long>(props->Value_unlocked(Constants::SERVICE_ID));
-    AddToSet_unlocked(set, receivers, SERVICE_ID_IX, cppmicroservices::ToString((service_id)));
+    // Check the cache
+    for (auto classId : classIds)
+    {
+      AddToSet(level->classCache, classId, *level, receivers, set);
+    }
+
+    for (std::size_t k = 0; k < hashedServiceKeys.size(); ++k)
+    {
+      const ListenerSnapshot::KeyIndex& index = level->keyIndexes[k];
+      if (index.listeners.empty())
+      {
+        continue;
+      }
+      const Any& value = props->Value_unlocked(hashedServiceKeys[k]);
+      if (!value.Empty() && !AddValueToSet(value, index, *level, receivers, set))
+      {
+        for (auto i : index.listeners)
+        {
+          const ServiceListenerEntry& sle = level->listeners[i];
+          if (IsReceiver(sle, receivers) && sle.GetLDAPExpr().Evaluate(props, false))
+          {
+            set.insert(sle);
+          }
+        }
+      }
+    }
   }
 }
 
+bool ServiceListeners::ScheduleModifiedEvents(const ServiceRegistrationBase& registration,
+                                              ServiceEventCoalescer::Clock::time_point deadline)
+{
+  return coalescer && coalescer->Schedule(registration, deadline);
+}
+
 std::vector<ServiceListenerHook::ListenerInfo> ServiceListeners::GetListenerInfoCollection() const
 {
   auto l = this->Lock(); US_UNUSED(l);
   std::vector<ServiceListenerHook::ListenerInfo> result;
-  result.reserve(serviceSet.size());
-  for (auto info : serviceSet)
+  result.reserve(tokenSlots.size());
+  for (auto& tokenSlot : tokenSlots)
   {
-    result.push_back(info);
+    result.push_back(slots[tokenSlot.second].entry);
   }
   return result;
 }
 
-void ServiceListeners::RemoveFromCache_unlocked(const ServiceListenerEntry& sle)
+void ServiceListeners::RemoveServiceListener_unlocked(const ServiceListenerEntry& sle)
 {
-  if (!sle.GetLocalCache().empty())
+  sle.SetRemoved(true);
+  tokenSlots.erase(sle.Id());
+
+  const ListenerSlot& slot = slots[sle.GetSlot()];
+  if (slot.prev != NO_SLOT)
   {
-    for (std::size_t i = 0; i < hashedServiceKeys.size(); ++i)
-    {
-      CacheType& keymap = cache[i];
-      std::vector<std::string>& l = sle.GetLocalCache()[i];
-      for (std::vector<std::string>::const_iterator it = l.begin();
-           it != l.end(); ++it)
-      {
-        std::list<ServiceListenerEntry>& sles = keymap[*it];
-        sles.remove(sle);
-        if (sles.empty())
-        {
-          keymap.erase(*it);
-        }
-      }
-    }
+    slots[slot.prev].next = slot.next;
+  }
+  else if (slot.next != NO_SLOT)
+  {
+    contextSlots[GetPrivate(sle.GetBundleContext())] = slot.next;
   }
   else
   {
-    complicatedListeners.remove(sle);
+    contextSlots.erase(GetPrivate(sle.GetBundleContext()));
+  }
+  if (slot.next != NO_SLOT)
+  {
+    slots[slot.next].prev = slot.prev;
+  }
+
+  // The snapshot keeps the listener until its level is merged. Compact
+  // the levels once they hold more removed than current listeners.
+  if (++removedCount > tokenSlots.size())
+  {
+    std::vector<ServiceListenerEntry> listeners;
+    listeners.reserve(tokenSlots.size() + removedCount);
+    for (auto& level : snapshot.Load()->levels)
+    {
+      listeners.insert(listeners.end(), level->listeners.begin(), level->listeners.end());
+    }
+    std::vector<std::shared_ptr<const ListenerSnapshot::Level> > levels;
+    auto level = MakeLevel_unlocked(listeners);
+    if (!level->listeners.empty())
+    {
+      levels.push_back(level);
+    }
+    StoreSnapshot_unlocked(std::move(levels));
   }
 }
 
 void ServiceListeners::CheckSimple_unlocked(const ServiceListenerEntry& sle)
 {
-   if (sle.GetLDAPExpr().IsNull())
-   {
-     complicatedListeners.push_back(sle);
-   }
-   else
-   {
-     LDAPExpr::LocalCache local_cache;
-     if (sle.GetLDAPExpr().IsSimple(hashedServiceKeys, local_cache, false))
-     {
-       sle.GetLocalCache() = local_cache;
-       for (std::size_t i = 0; i < hashedServiceKeys.size(); ++i)
-       {
-         for (std::vector<std::string>::const_iterator it = local_cache[i].begin();
-              it != local_cache[i].end(); ++it)
-         {
-           std::list<ServiceListenerEntry>& sles = cache[i][*it];
-           sles.push_back(sle);
-         }
-       }
-     }
-     else
-     {
-       complicatedListeners.push_back(sle);
-     }
-   }
- }
-
-void ServiceListeners::AddToSet_unlocked(ServiceListenerEntries& set,
-                                const ServiceListenerEntries& receivers,
-                                int cache_ix, const std::string& val)
-{
-  std::list<ServiceListenerEntry>& l = cache[cache_ix][val];
-  if (!l.empty())
-  {
-
-    for (std::list<ServiceListenerEntry>::const_iterator entry = l.begin();
-         entry != l.end(); ++entry)
-    {
-      if (receivers.count(*entry))
-      {
-        set.insert(*entry);
-      }
-    }
+  // Listeners without a simple filter keep an empty local cache and are
+  // evaluated for every event.
+  LDAPExpr::LocalCache local_cache;
+  if (!sle.GetLDAPExpr().IsNull() && sle.GetLDAPExpr().IsSimple(hashedServiceKeys, local_cache, false))
+  {
+    sle.GetLocalCache() = local_cache;
   }
 }
 
@@ -25,11 +25,21 @@
 #define CPPMICROSERVICES_SERVICELISTENERS_H
 
 #include "cppmicroservices/GlobalConfig.h"
+#include "cppmicroservices/ListenerStatistics.h"
 #include "cppmicroservices/detail/Threads.h"
 
+#include "InterfaceIdTable.h"
+#include "LDAPExprNetwork.h"
+#include "ListenerCallHistogram.h"
+#include "ServiceEventCoalescer.h"
+#include "ServiceEventDispatcher.h"
+#include "ServiceEventFanOut.h"
 #include "ServiceListenerEntry.h"
 
+#include <chrono>
+#include <exception>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <set>
 #include <string>
@@ -41,6 +51,7 @@ namespace cppmicroservices {
 
 class CoreBundleContext;
 class BundleContextPrivate;
+class PropertiesHandle;
 
 /**
  * Here we handle all listeners that bundles have registered.
@@ -51,20 +62,95 @@ class ServiceListeners : private detail::MultiThreaded<>
 
 public:
 
-  typedef std::tuple<BundleListener, void*> BundleListenerEntry;
+  typedef std::tuple<BundleListener, void*, std::shared_ptr<ListenerCallHistogram>> BundleListenerEntry;
   typedef std::unordered_map<std::shared_ptr<BundleContextPrivate>,
                              std::unordered_map<ListenerTokenId, BundleListenerEntry>> BundleListenerMap;
   struct : public MultiThreaded<> {
     BundleListenerMap value;
   } bundleListenerMap;
 
-  typedef std::unordered_map<std::string, std::list<ServiceListenerEntry> > CacheType;
   typedef std::unordered_set<ServiceListenerEntry> ServiceListenerEntries;
 
-  typedef std::tuple<FrameworkListener, void*> FrameworkListenerEntry;
+  typedef std::tuple<FrameworkListener, void*, std::shared_ptr<ListenerCallHistogram>> FrameworkListenerEntry;
   typedef std::unordered_map<std::shared_ptr<BundleContextPrivate>,
                              std::unordered_map<ListenerTokenId, FrameworkListenerEntry>> FrameworkListenerMap;
 
+  /**
+   * An immutable view of the service listeners, which is replaced when
+   * a listener is added. Events are matched against a snapshot without
+   * holding the listener lock.
+   *
+   * The listeners are kept in levels of decreasing size. Adding a
+   * listener creates a level for it and merges the newest levels of
+   * similar size, so only O(log n) listeners are indexed again per
+   * addition on average. Removed listeners stay in their level until it
+   * is merged or the levels are compacted, and are skipped by checking
+   * ListenerInfo::IsRemoved().
+   */
+  struct ListenerSnapshot
+  {
+    /**
+     * The listeners with "simple" filters on an indexed key other than
+     * objectclass, by the values they accept. Integer properties are
+     * looked up by value instead of being converted to strings.
+     */
+    struct KeyIndex
+    {
+      KeyIndex();
+
+      std::unordered_map<std::string, std::vector<std::size_t> > strings;
+      std::unordered_map<long, std::vector<std::size_t> > integers;
+      long minInteger;
+      long maxInteger;
+
+      /* All listeners in this index, for property types without lookup */
+      std::vector<std::size_t> listeners;
+    };
+
+    /**
+     * The caches of a group of listeners, which refer to the listeners
+     * by their index in \c listeners.
+     */
+    struct Level
+    {
+      std::vector<ServiceListenerEntry> listeners;
+      std::vector<std::size_t> unfilteredListeners;
+      std::unordered_map<InterfaceIdTable::Id, std::vector<std::size_t> > classCache;
+
+      /* The listeners with filters which are not "simple", and the nodes
+       * of their filters in a network sharing common sub-expressions. */
+      std::vector<std::size_t> complicatedListeners;
+      std::vector<std::size_t> complicatedFilters;
+      LDAPExprNetwork filters;
+
+      /* One index per hashed service key, unused for objectclass */
+      std::vector<KeyIndex> keyIndexes;
+
+      /* The listeners whose filters depend on a lower-case property key */
+      std::unordered_map<std::string, std::vector<std::size_t> > dependents;
+    };
+
+    ListenerSnapshot();
+
+    /* The oldest and largest level first */
+    std::vector<std::shared_ptr<const Level> > levels;
+
+    /* Greater than the slots of all listeners in the snapshot */
+    std::size_t slotCount;
+  };
+  typedef std::shared_ptr<const ListenerSnapshot> ListenerSnapshotConstPtr;
+
+  /**
+   * The listeners matching a service before its properties are modified,
+   * and the state they were matched in.
+   */
+  struct ModifiedMatch
+  {
+    ServiceListenerEntries listeners;
+    ListenerSnapshotConstPtr snapshot;
+    bool hooked;
+  };
+
 private:
 
   std::atomic<uint64_t> listenerId;
@@ -73,17 +159,60 @@ private:
       FrameworkListenerMap value;
   } frameworkListenerMap;
 
+  /* The property keys for which listeners with "simple" filters are
+   * cached: objectclass, service.id, service.pid and the keys given by
+   * FRAMEWORK_SERVICE_LISTENER_INDEXED_KEYS. */
   std::vector<std::string> hashedServiceKeys;
   static const int OBJECTCLASS_IX = 0;
-  static const int SERVICE_ID_IX = 1;
 
-  /* Service listeners with complicated or empty filters */
-  std::list<ServiceListenerEntry> complicatedListeners;
+  /**
+   * An entry of the service listener table. The slots of the service
+   * listeners added by a bundle context form a doubly linked list.
+   */
+  struct ListenerSlot
+  {
+    ServiceListenerEntry entry;
+    std::size_t prev;
+    std::size_t next;
+  };
+  static const std::size_t NO_SLOT = static_cast<std::size_t>(-1);
+
+  /* The service listener table. The slot of a removed listener is
+   * reused once no snapshot level refers to the listener anymore. */
+  std::vector<ListenerSlot> slots;
+  std::vector<std::size_t> freeSlots;
+
+  /* The slots of the service listeners by token id, and the first slot
+   * of the service listeners added by each bundle context */
+  std::unordered_map<ListenerTokenId, std::size_t> tokenSlots;
+  std::unordered_map<std::shared_ptr<BundleContextPrivate>, std::size_t> contextSlots;
+
+  /* The number of removed listeners in the levels of the snapshot */
+  std::size_t removedCount;
+
+  /* Replaced on every addition and compaction. Listeners with "simple"
+   * filters are cached, by interned objectclass for OBJECTCLASS_IX and
+   * by value for the other keys. */
+  mutable detail::Atomic<ListenerSnapshotConstPtr> snapshot;
+
+  /* Whether listeners are called asynchronously by default */
+  bool asyncDelivery;
 
-  /* Service listeners with "simple" filters are cached. */
-  CacheType cache[2];
+  /* Whether the call durations of new listeners are recorded */
+  bool listenerStatistics;
 
-  ServiceListenerEntries serviceSet;
+  /* Listener calls taking longer are reported, zero if disabled */
+  std::chrono::nanoseconds slowListenerThreshold;
+
+  /* Calls the asynchronous listeners, null without threading support */
+  std::unique_ptr<ServiceEventDispatcher> dispatcher;
+
+  /* Delivers deferred SERVICE_MODIFIED events, null without threading support */
+  std::unique_ptr<ServiceEventCoalescer> coalescer;
+
+  /* Calls the synchronous listeners of different bundles in parallel,
+   * null unless FRAMEWORK_SERVICE_LISTENER_PARALLEL_THREADS is set */
+  std::unique_ptr<ServiceEventFanOut> fanOut;
 
   CoreBundleContext* coreCtx;
 
@@ -101,12 +230,14 @@ public:
    * @param listener The service listener to add.
    * @param data Additional data to distinguish ServiceListener objects.
    * @param filter An LDAP filter string to check when a service is modified.
+   * @param delivery Whether the listener is called synchronously or asynchronously.
    * @returns a ListenerToken object that corresponds to the listener.
    * @exception org.osgi.framework.InvalidSyntaxException
    * If the filter is not a correct LDAP expression.
    */
   ListenerToken AddServiceListener(const std::shared_ptr<BundleContextPrivate>& context, const ServiceListener& listener,
-                                   void* data, const std::string& filter);
+                                   void* data, const std::string& filter,
+                                   ServiceListenerDelivery delivery = ServiceListenerDelivery::DEFAULT);
 
   /**
    * Remove service listener from current framework. Silently ignore
@@ -199,17 +330,106 @@ public:
   void ServiceChanged(ServiceListenerEntries& receivers,
                       const ServiceEvent& evt);
 
+  /**
+   * Call a service listener, reporting exceptions it throws as
+   * FRAMEWORK_ERROR events.
+   */
+  void CallServiceListener(const ServiceListenerEntry& listener, const ServiceEvent& evt);
+
+  /**
+   * Report a service listener call made by the caller: a FRAMEWORK_ERROR
+   * event if it threw \c error, and its duration if \c start was taken
+   * because calls are timed.
+   */
+  void ServiceListenerCalled(const ServiceListenerEntry& listener,
+                             std::chrono::steady_clock::time_point start,
+                             std::exception_ptr error);
+
+  /**
+   * Whether listener calls are timed.
+   */
+  bool IsTimed() const;
+
+  /**
+   * Get the call statistics of the current listeners which were added
+   * while FRAMEWORK_LISTENER_STATISTICS was enabled.
+   */
+  std::vector<ListenerStatistics> GetListenerStatistics() const;
+
   /**
    *
    *
    */
   void GetMatchingServiceListeners(const ServiceEvent& evt, ServiceListenerEntries& listeners);
 
+  /**
+   * Get the matching service listeners for a batch of events, taking the
+   * listener lock only once.
+   *
+   * The properties of the services referenced by the events are read
+   * without locking them, so the caller must make sure they cannot be
+   * modified concurrently. This is the case for services which were just
+   * registered and whose ServiceRegistration objects have not been handed
+   * out yet.
+   *
+   * @param evts The service events.
+   * @param listeners Receives one set of matching listeners per event.
+   */
+  void GetMatchingServiceListeners(const std::vector<ServiceEvent>& evts,
+                                   std::vector<ServiceListenerEntries>& listeners);
+
+
+  /**
+   * Get the matching service listeners for a service whose properties
+   * are about to be modified.
+   */
+  void GetMatchingServiceListeners(const ServiceEvent& evt, ModifiedMatch& before);
+
+  /**
+   * Get the matching service listeners for a service whose properties
+   * were modified. Only the filters depending on a changed key are
+   * evaluated again, the other listeners match as before. All filters
+   * are evaluated if listeners or event listener hooks are involved
+   * which were not when \c before was computed.
+   *
+   * @param before The listeners which matched the unmodified service.
+   * @param changedKeys The lower-case keys of the modified properties.
+   */
+  void GetMatchingServiceListeners(const ServiceEvent& evt,
+                                   const ModifiedMatch& before,
+                                   const std::vector<std::string>& changedKeys,
+                                   ServiceListenerEntries& listeners);
+
+  /**
+   * Deliver the deferred SERVICE_MODIFIED events of a service
+   * registration at \c deadline at the latest.
+   *
+   * @return \c false if the events cannot be deferred and must be
+   *         delivered by the caller.
+   */
+  bool ScheduleModifiedEvents(const ServiceRegistrationBase& registration,
+                              ServiceEventCoalescer::Clock::time_point deadline);
 
   std::vector<ServiceListenerHook::ListenerInfo> GetListenerInfoCollection() const;
 
 private:
 
+  /**
+   * Get the current listener snapshot.
+   */
+  ListenerSnapshotConstPtr GetSnapshot() const;
+
+  /**
+   * Index a group of listeners, dropping the removed ones and freeing
+   * their slots.
+   */
+  std::shared_ptr<const ListenerSnapshot::Level> MakeLevel_unlocked(const std::vector<ServiceListenerEntry>& listeners);
+
+  /**
+   * Publish a snapshot with the given levels.
+   */
+  void StoreSnapshot_unlocked(std::vector<std::shared_ptr<const ListenerSnapshot::Level> >&& levels);
+
   /**
    * Factory method that returns an unique ListenerToken object.
    * Called by methods which add listeners.
@@ -217,18 +437,53 @@ private:
   ListenerToken MakeListenerToken();
 
   /**
-   * Remove all references to a service listener from the service listener
-   * cache.
+   * Checks if the specified service listener's filter is simple enough
+   * to cache, and if so remembers the accepted values in the listener's
+   * local cache.
    */
-  void RemoveFromCache_unlocked(const ServiceListenerEntry& sle);
+  void CheckSimple_unlocked(const ServiceListenerEntry& sle);
 
   /**
-   * Checks if the specified service listener's filter is simple enough
-   * to cache.
+   * Remove a service listener from the listener table. The levels of
+   * the snapshot are compacted when they contain more removed than
+   * current listeners.
    */
-  void CheckSimple_unlocked(const ServiceListenerEntry& sle);
+  void RemoveServiceListener_unlocked(const ServiceListenerEntry& sle);
+
+  /**
+   * Record a listener call which started at \c start.
+   *
+   * @return The duration of the call if it exceeded the warning
+   *         threshold, zero otherwise.
+   */
+  std::chrono::nanoseconds RecordCall(ListenerCallHistogram* histogram,
+                                      std::chrono::steady_clock::time_point start) const;
+
+  /**
+   * Send a FRAMEWORK_WARNING event for a slow listener call.
+   */
+  void WarnSlowListener(const Bundle& bundle, const std::string& listener, std::chrono::nanoseconds duration);
 
-  void AddToSet_unlocked(ServiceListenerEntries& set, const ServiceListenerEntries& receivers, int cache_ix, const std::string& val);
+  /**
+   * Add the listeners in \c snap matching a service event to \c set.
+   *
+   * @return \c true if event listener hooks filtered the listeners.
+   */
+  bool GetMatchingServiceListeners(const ServiceEvent& evt,
+                                   const ListenerSnapshot& snap,
+                                   ServiceListenerEntries& set);
+
+  /**
+   * Add the listeners in \c snap matching a service to \c set.
+   *
+   * @param receivers One flag per listener slot telling if it may receive
+   *        the event, or \c nullptr if all listeners may.
+   */
+  void GetMatchingServiceListeners(const ListenerSnapshot& snap,
+                                   const std::vector<InterfaceIdTable::Id>& classIds,
+                                   const PropertiesHandle& props,
+                                   const std::vector<bool>* receivers,
+                                   ServiceListenerEntries& set) const;
 };
 
 }
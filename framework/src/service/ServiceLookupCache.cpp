@@ -0,0 +1,76 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#include "ServiceLookupCache.h"
+
+namespace cppmicroservices {
+
+ServiceLookupCache::ServiceLookupCache(std::size_t capacity)
+  : cache(capacity)
+{
+}
+
+std::string ServiceLookupCache::MakeKey(const std::string& clazz, const std::string& filter)
+{
+  std::string key;
+  key.reserve(clazz.size() + filter.size() + 1);
+  key.append(clazz).push_back('\0');
+  key.append(filter);
+  return key;
+}
+
+bool ServiceLookupCache::Get(const std::string& clazz, const std::string& filter,
+                             std::vector<ServiceReferenceBase>& refs)
+{
+  // Outdated results are dropped, they may keep unregistered services alive.
+  return cache.Find(MakeKey(clazz, filter), [&refs](const Entry& entry) {
+    if (entry.generation->load() != entry.value)
+    {
+      return false;
+    }
+    refs.insert(refs.end(), entry.refs.begin(), entry.refs.end());
+    return true;
+  });
+}
+
+void ServiceLookupCache::Put(const std::string& clazz, const std::string& filter,
+                             const Generation* generation, std::uint64_t value,
+                             const std::vector<ServiceReferenceBase>& refs)
+{
+  Entry entry = { generation, value, refs };
+  cache.Insert(MakeKey(clazz, filter), std::move(entry), [&](Entry& cached) {
+    // Another thread cached the same lookup concurrently; keep the newer result.
+    if (value > cached.value || cached.generation != generation)
+    {
+      cached.generation = generation;
+      cached.value = value;
+      cached.refs = refs;
+    }
+  });
+}
+
+void ServiceLookupCache::Clear()
+{
+  cache.Clear();
+}
+
+}
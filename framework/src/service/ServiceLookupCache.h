@@ -0,0 +1,101 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#ifndef CPPMICROSERVICES_SERVICELOOKUPCACHE_H
+#define CPPMICROSERVICES_SERVICELOOKUPCACHE_H
+
+#include "cppmicroservices/ServiceReferenceBase.h"
+
+#include "ShardedLruCache.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cppmicroservices {
+
+/**
+ * A bounded, thread-safe cache of service lookup results keyed by
+ * class name and filter string.
+ *
+ * Each result is stored together with a generation counter of the service
+ * registry and the counter value observed before the lookup was run. A
+ * result is only returned while the counter still has that value, so
+ * any change to the services of the class invalidates it without the
+ * registry having to know which entries exist. The least recently used
+ * results are evicted, see ShardedLruCache.
+ *
+ * This class is not part of the public API.
+ */
+class ServiceLookupCache
+{
+
+public:
+
+  typedef std::atomic<std::uint64_t> Generation;
+
+  explicit ServiceLookupCache(std::size_t capacity);
+
+  ServiceLookupCache(const ServiceLookupCache&) = delete;
+  ServiceLookupCache& operator=(const ServiceLookupCache&) = delete;
+
+  /**
+   * Append the cached result for <code>clazz</code> and <code>filter</code>
+   * to <code>refs</code>, if there is a valid one.
+   *
+   * @return <code>true</code> if a valid result was found.
+   */
+  bool Get(const std::string& clazz, const std::string& filter,
+           std::vector<ServiceReferenceBase>& refs);
+
+  /**
+   * Cache the result of a lookup.
+   *
+   * @param generation The registry counter invalidating the result. It
+   *        must outlive this cache.
+   * @param value The value of <code>generation</code> read before the
+   *        lookup was run.
+   */
+  void Put(const std::string& clazz, const std::string& filter,
+           const Generation* generation, std::uint64_t value,
+           const std::vector<ServiceReferenceBase>& refs);
+
+  void Clear();
+
+private:
+
+  struct Entry
+  {
+    const Generation* generation;
+    std::uint64_t value;
+    std::vector<ServiceReferenceBase> refs;
+  };
+
+  static std::string MakeKey(const std::string& clazz, const std::string& filter);
+
+  ShardedLruCache<Entry> cache;
+};
+
+}
+
+#endif // CPPMICROSERVICES_SERVICELOOKUPCACHE_H
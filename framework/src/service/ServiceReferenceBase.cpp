@@ -52,13 +52,16 @@ ServiceReferenceBase::ServiceReferenceBase(ServiceRegistrationBasePrivate* reg)
 
 void ServiceReferenceBase::SetInterfaceId(const std::string& interfaceId)
 {
+  const InterfaceIdTable::Id id = InterfaceIdTable::Instance().Intern(interfaceId);
+  if (d.load()->interfaceId == id) return;
+
   if (d.load()->ref > 1)
   {
     // detach
     --d.load()->ref;
     d = new ServiceReferenceBasePrivate(d.load()->registration);
   }
-  d.load()->interfaceId = interfaceId;
+  d.load()->interfaceId = id;
 }
 
 ServiceReferenceBase::operator bool() const
@@ -86,6 +89,12 @@ Any ServiceReferenceBase::GetProperty(const std::string& key) const
   return d.load()->registration->properties.Value_unlocked(key);
 }
 
+std::shared_ptr<const Any> ServiceReferenceBase::GetSharedProperty(const std::string& key) const
+{
+  auto l = d.load()->registration->properties.Lock(); US_UNUSED(l);
+  return d.load()->registration->properties.SharedValue_unlocked(key);
+}
+
 void ServiceReferenceBase::GetPropertyKeys(std::vector<std::string>& keys) const
 {
   keys = GetPropertyKeys();
@@ -137,44 +146,9 @@ bool ServiceReferenceBase::operator<(const ServiceReferenceBase& reference) cons
     return false;
   }
 
-
-  Any anyR1;
-  Any anyId1;
-  {
-    auto l = d.load()->registration->properties.Lock(); US_UNUSED(l);
-    anyR1 = d.load()->registration->properties.Value_unlocked(Constants::SERVICE_RANKING);
-    assert(anyR1.Empty() || anyR1.Type() == typeid(int));
-    anyId1 = d.load()->registration->properties.Value_unlocked(Constants::SERVICE_ID);
-    assert(anyId1.Type() == typeid(long int));
-  }
-
-  Any anyR2;
-  Any anyId2;
-  {
-    auto l = reference.d.load()->registration->properties.Lock(); US_UNUSED(l);
-    anyR2 = reference.d.load()->registration->properties.Value_unlocked(Constants::SERVICE_RANKING);
-    assert(anyR2.Empty() || anyR2.Type() == typeid(int));
-    anyId2 = reference.d.load()->registration->properties.Value_unlocked(Constants::SERVICE_ID);
-    assert(anyId2.Type() == typeid(long int));
-  }
-
-  const int r1 = anyR1.Empty() ? 0 : *any_cast<int>(&anyR1);
-  const int r2 = anyR2.Empty() ? 0 : *any_cast<int>(&anyR2);
-
-  if (r1 != r2)
-  {
-    // use ranking if ranking differs
-    return r1 < r2;
-  }
-  else
-  {
-    const long int id1 = *any_cast<long int>(&anyId1);
-    const long int id2 = *any_cast<long int>(&anyId2);
-
-    // otherwise compare using IDs,
-    // is less than if it has a higher ID.
-    return id2 < id1;
-  }
+  // use ranking if ranking differs, otherwise compare using IDs,
+  // is less than if it has a higher ID.
+  return d.load()->registration->IsLessThan(*reference.d.load()->registration);
 }
 
 bool ServiceReferenceBase::operator==(const ServiceReferenceBase& reference) const
@@ -204,7 +178,7 @@ bool ServiceReferenceBase::IsConvertibleTo(const std::string& interfaceId) const
 
 std::string ServiceReferenceBase::GetInterfaceId() const
 {
-  return d.load()->interfaceId;
+  return InterfaceIdTable::Instance().GetName(d.load()->interfaceId);
 }
 
 std::size_t ServiceReferenceBase::Hash() const
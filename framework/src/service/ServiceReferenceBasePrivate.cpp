@@ -39,7 +39,7 @@ US_MSVC_DISABLE_WARNING(4503) // decorated name length exceeded, name was trunca
 namespace cppmicroservices {
 
 ServiceReferenceBasePrivate::ServiceReferenceBasePrivate(ServiceRegistrationBasePrivate* reg)
-  : ref(1), registration(reg)
+  : ref(1), registration(reg), interfaceId(InterfaceIdTable::EMPTY_ID)
 {
   if(registration) ++registration->ref;
 }
@@ -95,7 +95,14 @@ InterfaceMapConstPtr ServiceReferenceBasePrivate::GetPrototypeService(const Bund
       auto factory = std::static_pointer_cast<ServiceFactory>(
                                                   registration->GetService("org.cppmicroservices.factory"));
       s = GetServiceFromFactory(GetPrivate(bundle).get(), factory);
-      registration->Lock(), registration->prototypeServiceInstances[GetPrivate(bundle).get()].push_back(s);
+      auto l = registration->Lock(); US_UNUSED(l);
+      auto& instances = registration->prototypeServiceInstances[GetPrivate(bundle).get()];
+      if (instances.empty() && registration->available)
+      {
+        registration->bundle->coreCtx->services.AddUsedByBundle(GetPrivate(bundle).get(),
+                                                                ServiceRegistrationBase(registration));
+      }
+      instances.push_back(s);
     }
   }
   return s;
@@ -103,7 +110,7 @@ InterfaceMapConstPtr ServiceReferenceBasePrivate::GetPrototypeService(const Bund
 
 std::shared_ptr<void> ServiceReferenceBasePrivate::GetService(BundlePrivate* bundle)
 {
-  auto s = ExtractInterface(GetServiceInterfaceMap(bundle), interfaceId);
+  auto s = ExtractInterface(GetServiceInterfaceMap(bundle), InterfaceIdTable::Instance().GetName(interfaceId));
   if (!s)
   {
     registration->Lock(), --registration->dependents[bundle];
@@ -124,7 +131,12 @@ InterfaceMapConstPtr ServiceReferenceBasePrivate::GetServiceInterfaceMap(BundleP
     if (!registration->available) return s;
     serviceFactory = std::static_pointer_cast<ServiceFactory>(
           registration->GetService_unlocked("org.cppmicroservices.factory"));
-    count = registration->dependents[bundle];
+    auto dependent = registration->dependents.insert(std::make_pair(bundle, 0));
+    count = dependent.first->second;
+    if (dependent.second)
+    {
+      registration->bundle->coreCtx->services.AddUsedByBundle(bundle, ServiceRegistrationBase(registration));
+    }
   }
 
   if (!serviceFactory)
@@ -208,6 +220,12 @@ bool ServiceReferenceBasePrivate::UngetPrototypeService(const std::shared_ptr<Bu
       if (iter->second.empty())
       {
         registration->prototypeServiceInstances.erase(iter);
+        if (registration->bundle &&
+            registration->dependents.find(bundle.get()) == registration->dependents.end())
+        {
+          registration->bundle->coreCtx->services.RemoveUsedByBundle(bundle.get(),
+                                                                     ServiceRegistrationBase(registration));
+        }
       }
       return true;
     }
@@ -225,7 +243,8 @@ bool ServiceReferenceBasePrivate::UngetService(const std::shared_ptr<BundlePriva
 
   {
     auto l = registration->Lock(); US_UNUSED(l);
-    int count= registration->dependents[bundle.get()];
+    auto dependent = registration->dependents.find(bundle.get());
+    int count = dependent != registration->dependents.end() ? dependent->second : 0;
     if (count > 0)
     {
       hadReferences = true;
@@ -235,7 +254,7 @@ bool ServiceReferenceBasePrivate::UngetService(const std::shared_ptr<BundlePriva
     {
       if (count > 1)
       {
-        registration->dependents[bundle.get()] = count - 1;
+        dependent->second = count - 1;
       }
       else if(count == 1)
       {
@@ -256,7 +275,16 @@ bool ServiceReferenceBasePrivate::UngetService(const std::shared_ptr<BundlePriva
               registration->GetService_unlocked("org.cppmicroservices.factory"));
       }
       registration->bundleServiceInstance.erase(bundle.get());
-      registration->dependents.erase(bundle.get());
+      if (dependent != registration->dependents.end())
+      {
+        registration->dependents.erase(dependent);
+        if (registration->bundle &&
+            registration->prototypeServiceInstances.find(bundle.get()) == registration->prototypeServiceInstances.end())
+        {
+          registration->bundle->coreCtx->services.RemoveUsedByBundle(bundle.get(),
+                                                                     ServiceRegistrationBase(registration));
+        }
+      }
     }
   }
 
@@ -26,6 +26,8 @@
 
 #include "cppmicroservices/ServiceInterface.h"
 
+#include "InterfaceIdTable.h"
+
 #include <atomic>
 #include <string>
 
@@ -112,9 +114,9 @@ public:
   ServiceRegistrationBasePrivate* const registration;
 
   /**
-   * The service interface id for this reference.
+   * The interned service interface id for this reference.
    */
-  std::string interfaceId;
+  InterfaceIdTable::Id interfaceId;
 
 private:
 
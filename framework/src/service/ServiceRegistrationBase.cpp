@@ -32,12 +32,34 @@
 #include "ServiceRegistry.h"
 #include "ServiceListenerEntry.h"
 
+#include <algorithm>
 #include <stdexcept>
 
 US_MSVC_DISABLE_WARNING(4503) // decorated name length exceeded, name was truncated
 
 namespace cppmicroservices {
 
+namespace {
+
+void FireModifiedEvents(ServiceListeners& listeners,
+                        const ServiceEvent& modifiedEvent,
+                        const ServiceEvent& modifiedEndMatchEvent,
+                        ServiceRegistrationBasePrivate::PendingModification& pending)
+{
+  // Listeners whose filters do not depend on a changed property match
+  // as before.
+  std::vector<std::string>& changedKeys = pending.changedKeys;
+  std::sort(changedKeys.begin(), changedKeys.end());
+  changedKeys.erase(std::unique(changedKeys.begin(), changedKeys.end()), changedKeys.end());
+
+  ServiceListeners::ServiceListenerEntries matchingListeners;
+  listeners.GetMatchingServiceListeners(modifiedEvent, pending.before, changedKeys, matchingListeners);
+  listeners.ServiceChanged(matchingListeners, modifiedEvent, pending.before.listeners);
+  listeners.ServiceChanged(pending.before.listeners, modifiedEndMatchEvent);
+}
+
+}
+
 ServiceRegistrationBase::ServiceRegistrationBase()
   : d(nullptr)
 {
@@ -101,13 +123,21 @@ ServiceReferenceBase ServiceRegistrationBase::GetReference(const std::string& in
 }
 
 void ServiceRegistrationBase::SetProperties(const ServiceProperties& props)
+{
+  SetProperties(props, std::chrono::milliseconds::zero());
+}
+
+void ServiceRegistrationBase::SetProperties(const ServiceProperties& props, const std::chrono::milliseconds& maxDelay)
 {
   if (!d) throw std::logic_error("ServiceRegistrationBase object invalid");
 
+  typedef ServiceRegistrationBasePrivate::PendingModification PendingModification;
+
   ServiceEvent modifiedEndMatchEvent;
   ServiceEvent modifiedEvent;
 
-  ServiceListeners::ServiceListenerEntries before;
+  std::unique_ptr<PendingModification> pending;
+  bool schedule = false;
 
   if (d->available)
   {
@@ -116,52 +146,119 @@ void ServiceRegistrationBase::SetProperties(const ServiceProperties& props)
       if (!d->available) throw std::logic_error("Service is unregistered");
       modifiedEndMatchEvent = ServiceEvent(ServiceEvent::SERVICE_MODIFIED_ENDMATCH, d->reference);
       modifiedEvent = ServiceEvent(ServiceEvent::SERVICE_MODIFIED, d->reference);
+      pending = std::move(d->pendingModification);
     }
 
-    // This calls into service event listener hooks. We must not hold any looks here
-    d->bundle->coreCtx->listeners.GetMatchingServiceListeners(modifiedEndMatchEvent, before);
+    // Match the listeners against the unmodified service, unless a
+    // deferred modification already did.
+    if (!pending)
+    {
+      pending.reset(new PendingModification());
+      pending->deadline = ServiceEventCoalescer::Clock::now() + maxDelay;
+      schedule = true;
+
+      // This calls into service event listener hooks. We must not hold any looks here
+      d->bundle->coreCtx->listeners.GetMatchingServiceListeners(modifiedEndMatchEvent, pending->before);
+    }
 
     int old_rank = 0;
     int new_rank = 0;
-    std::vector<std::string> classes;
     {
-      auto l = d->Lock(); US_UNUSED(l);
-      if (!d->available) throw std::logic_error("Service is unregistered");
+      // Lock the service registry first, so that the secondary property
+      // indexes are updated atomically with the properties.
+      auto& registry = d->bundle->coreCtx->services;
+      auto l1 = registry.Lock(); US_UNUSED(l1);
 
+      ServiceRegistry::IndexedValues oldValues;
+      ServiceRegistry::IndexedValues newValues;
       {
-        auto l2 = d->properties.Lock(); US_UNUSED(l2);
+        auto l2 = d->Lock(); US_UNUSED(l2);
+        if (!d->available) throw std::logic_error("Service is unregistered");
 
-        Any any = d->properties.Value_unlocked(Constants::SERVICE_RANKING);
-        if (any.Type() == typeid(int)) old_rank = any_cast<int>(any);
-
-        classes = ref_any_cast<std::vector<std::string> >(d->properties.Value_unlocked(Constants::OBJECTCLASS));
+        {
+          auto l3 = d->properties.Lock(); US_UNUSED(l3);
+
+          old_rank = d->ranking;
+
+          const std::vector<std::string> classes =
+              ref_any_cast<std::vector<std::string> >(d->properties.Value_unlocked(Constants::OBJECTCLASS));
+          oldValues = registry.GetIndexedValues_unlocked(d->properties);
+
+          Properties newProperties = ServiceRegistry::CreateServiceProperties(props, classes, false, false, d->id);
+          const std::vector<std::string> changedKeys = d->properties.GetChangedKeys_unlocked(newProperties);
+          pending->changedKeys.insert(pending->changedKeys.end(), changedKeys.begin(), changedKeys.end());
+          d->properties = std::move(newProperties);
+
+          new_rank = ServiceRegistrationBasePrivate::GetRanking_unlocked(d->properties);
+          newValues = registry.GetIndexedValues_unlocked(d->properties);
+          if (old_rank != new_rank)
+          {
+            // Registering threads only hold the shard locks, and must
+            // not see a class list out of ranking order.
+            auto l4 = registry.LockClassShards(d->classIds); US_UNUSED(l4);
+            d->ranking = new_rank;
+            registry.UpdateServiceRegistrationOrder_unlocked(*this);
+          }
+        }
+      }
 
-        long int sid = any_cast<long int>(d->properties.Value_unlocked(Constants::SERVICE_ID));
-        d->properties = ServiceRegistry::CreateServiceProperties(props, classes, false, false, sid);
+      registry.UpdatePropertyIndexes_unlocked(*this, oldValues, newValues);
+      registry.ServiceChanged(*this, ServiceEvent::SERVICE_MODIFIED);
+    }
+  }
+  else
+  {
+    throw std::logic_error("Service is unregistered");
+  }
 
-        any = d->properties.Value_unlocked(Constants::SERVICE_RANKING);
-        if (any.Type() == typeid(int)) new_rank = any_cast<int>(any);
+  auto& listeners = d->bundle->coreCtx->listeners;
+  if (maxDelay > std::chrono::milliseconds::zero())
+  {
+    const auto deadline = std::min(pending->deadline, ServiceEventCoalescer::Clock::now() + maxDelay);
+    schedule = schedule || deadline < pending->deadline;
+    pending->deadline = deadline;
+    {
+      auto l = d->Lock(); US_UNUSED(l);
+      // Another thread may have started deferring meanwhile.
+      if (!d->pendingModification && d->available)
+      {
+        d->pendingModification = std::move(pending);
+        // The coalescer finds nothing to deliver if the deadline of a
+        // modification taken over from an earlier call passed meanwhile.
+        schedule = schedule || deadline <= ServiceEventCoalescer::Clock::now();
       }
     }
-    if (old_rank != new_rank)
+    if (!pending)
     {
-      d->bundle->coreCtx->services.UpdateServiceRegistrationOrder(*this, classes);
+      if (schedule && !listeners.ScheduleModifiedEvents(*this, deadline))
+      {
+        DeliverModifiedEvents();
+      }
+      return;
     }
   }
-  else
+
+  // Notify listeners, we must no hold any locks here
+  FireModifiedEvents(listeners, modifiedEvent, modifiedEndMatchEvent, *pending);
+}
+
+void ServiceRegistrationBase::DeliverModifiedEvents()
+{
+  std::unique_ptr<ServiceRegistrationBasePrivate::PendingModification> pending;
+  CoreBundleContext* coreCtx = nullptr;
+  ServiceEvent modifiedEndMatchEvent;
+  ServiceEvent modifiedEvent;
   {
-    throw std::logic_error("Service is unregistered");
+    auto l = d->Lock(); US_UNUSED(l);
+    if (!d->pendingModification || !d->bundle) return;
+    pending = std::move(d->pendingModification);
+    coreCtx = d->bundle->coreCtx;
+    modifiedEndMatchEvent = ServiceEvent(ServiceEvent::SERVICE_MODIFIED_ENDMATCH, d->reference);
+    modifiedEvent = ServiceEvent(ServiceEvent::SERVICE_MODIFIED, d->reference);
   }
 
   // Notify listeners, we must no hold any locks here
-  ServiceListeners::ServiceListenerEntries matchingListeners;
-  d->bundle->coreCtx->listeners.GetMatchingServiceListeners(modifiedEvent, matchingListeners);
-  d->bundle->coreCtx->listeners.ServiceChanged(matchingListeners,
-                                               modifiedEvent,
-                                               before);
-
-  d->bundle->coreCtx->listeners.ServiceChanged(before,
-                                               modifiedEndMatchEvent);
+  FireModifiedEvents(coreCtx->listeners, modifiedEvent, modifiedEndMatchEvent, *pending);
 }
 
 void ServiceRegistrationBase::Unregister()
@@ -170,7 +267,11 @@ void ServiceRegistrationBase::Unregister()
 
   if (d->unregistering) return; // Silently ignore redundant unregistration.
 
+  // Fire deferred events before the service goes away.
+  DeliverModifiedEvents();
+
   CoreBundleContext* coreContext = nullptr;
+  bool removed = false;
 
   if (d->available)
   {
@@ -180,7 +281,7 @@ void ServiceRegistrationBase::Unregister()
     if (d->unregistering) return;
     d->unregistering = true;
 
-    d->bundle->coreCtx->services.RemoveServiceRegistration_unlocked(*this);
+    removed = d->bundle->coreCtx->services.RemoveServiceRegistration_unlocked(*this);
     coreContext = d->bundle->coreCtx;
   }
   else
@@ -190,6 +291,12 @@ void ServiceRegistrationBase::Unregister()
 
   if (coreContext)
   {
+    // The class index is only guarded by the shard locks.
+    if (removed)
+    {
+      coreContext->services.RemoveFromClassIndex(*this);
+    }
+
     // Notify listeners. We must not hold any locks here.
     ServiceListeners::ServiceListenerEntries listeners;
     ServiceEvent unregisteringEvent(ServiceEvent::SERVICE_UNREGISTERING, d->reference);
@@ -255,6 +362,18 @@ void ServiceRegistrationBase::Unregister()
   {
     auto l = d->Lock(); US_UNUSED(l);
 
+    if (d->bundle)
+    {
+      auto& registry = d->bundle->coreCtx->services;
+      for (auto& dependent : d->dependents)
+      {
+        registry.RemoveUsedByBundle(dependent.first, *this);
+      }
+      for (auto& prototypeInstances : d->prototypeServiceInstances)
+      {
+        registry.RemoveUsedByBundle(prototypeInstances.first, *this);
+      }
+    }
     d->bundle = nullptr;
     d->dependents.clear();
     d->service.reset();
@@ -275,13 +394,7 @@ bool ServiceRegistrationBase::operator<(const ServiceRegistrationBase& o) const
   if ((!d && !o.d) || !o.d) return false;
   if (!d) return true;
 
-  ServiceReferenceBase sr1;
-  ServiceReferenceBase sr2;
-  {
-    d->Lock(), sr1 = d->reference;
-    o.d->Lock(), sr2 = o.d->reference;
-  }
-  return sr1 < sr2;
+  return d->IsLessThan(*o.d);
 }
 
 bool ServiceRegistrationBase::operator==(const ServiceRegistrationBase& registration) const
@@ -22,6 +22,8 @@
 
 #include "ServiceRegistrationBasePrivate.h"
 
+#include "cppmicroservices/Constants.h"
+
 #ifdef _MSC_VER
 #pragma warning(push)
 #pragma warning(disable:4355)
@@ -29,6 +31,24 @@
 
 namespace cppmicroservices {
 
+namespace {
+
+std::vector<InterfaceIdTable::Id> InternClasses(const Properties& props)
+{
+  std::vector<InterfaceIdTable::Id> ids;
+  const Any& classes = props.Value_unlocked(Constants::OBJECTCLASS);
+  if (classes.Type() == typeid(std::vector<std::string>))
+  {
+    for (auto& clazz : ref_any_cast<std::vector<std::string>>(classes))
+    {
+      ids.push_back(InterfaceIdTable::Instance().Intern(clazz));
+    }
+  }
+  return ids;
+}
+
+}
+
 ServiceRegistrationBasePrivate::ServiceRegistrationBasePrivate(
     BundlePrivate* bundle,
     const InterfaceMapConstPtr& service,
@@ -39,6 +59,9 @@ ServiceRegistrationBasePrivate::ServiceRegistrationBasePrivate(
   , bundle(bundle)
   , reference(this)
   , properties(std::move(props))
+  , ranking(GetRanking_unlocked(properties))
+  , id(ref_any_cast<long int>(properties.Value_unlocked(Constants::SERVICE_ID)))
+  , classIds(InternClasses(properties))
   , available(true)
   , unregistering(false)
 {
@@ -46,6 +69,12 @@ ServiceRegistrationBasePrivate::ServiceRegistrationBasePrivate(
   // incremented by the "reference" member.
 }
 
+int ServiceRegistrationBasePrivate::GetRanking_unlocked(const Properties& props)
+{
+  const Any& any = props.Value_unlocked(Constants::SERVICE_RANKING);
+  return any.Type() == typeid(int) ? *any_cast<int>(&any) : 0;
+}
+
 ServiceRegistrationBasePrivate::~ServiceRegistrationBasePrivate()
 {
   properties.Lock(), properties.Clear_unlocked();
@@ -28,9 +28,12 @@
 #include "cppmicroservices/ServiceReference.h"
 #include "cppmicroservices/detail/Threads.h"
 
+#include "InterfaceIdTable.h"
 #include "Properties.h"
+#include "ServiceListeners.h"
 
 #include <atomic>
+#include <memory>
 
 namespace cppmicroservices {
 
@@ -104,6 +107,23 @@ public:
    */
   Properties properties;
 
+  /**
+   * Service ranking, kept in sync with the Constants::SERVICE_RANKING
+   * property so that ordering services does not need to lock and copy
+   * the properties.
+   */
+  std::atomic<int> ranking;
+
+  /**
+   * Service id, the value of the Constants::SERVICE_ID property.
+   */
+  const long int id;
+
+  /**
+   * Interned ids of the Constants::OBJECTCLASS property values.
+   */
+  const std::vector<InterfaceIdTable::Id> classIds;
+
   /**
    * Is service available. I.e., if <code>true</code> then holders
    * of a ServiceReference for the service are allowed to get it.
@@ -117,6 +137,25 @@ public:
    */
   std::atomic<bool> unregistering;
 
+  /**
+   * The SERVICE_MODIFIED events deferred by ServiceRegistrationBase::SetProperties.
+   */
+  struct PendingModification
+  {
+    /* The listeners matching the service before the first deferred modification */
+    ServiceListeners::ModifiedMatch before;
+
+    /* The lower-case keys changed since then */
+    std::vector<std::string> changedKeys;
+
+    ServiceEventCoalescer::Clock::time_point deadline;
+  };
+
+  /**
+   * The deferred SERVICE_MODIFIED events, if any.
+   */
+  std::unique_ptr<PendingModification> pendingModification;
+
 
   ServiceRegistrationBasePrivate(BundlePrivate* bundle, const InterfaceMapConstPtr& service,
                                  Properties&& props);
@@ -133,6 +172,28 @@ public:
 
   InterfaceMapConstPtr GetInterfaces() const;
 
+  /**
+   * Compare the service ranking order of two registrations. A registration
+   * is less than another one if it has a lower ranking or, for equal
+   * rankings, a higher service id.
+   *
+   * This only reads the ranking and id members and does not lock anything.
+   */
+  bool IsLessThan(const ServiceRegistrationBasePrivate& o) const
+  {
+    const int r1 = ranking.load();
+    const int r2 = o.ranking.load();
+    return r1 != r2 ? r1 < r2 : o.id < id;
+  }
+
+  /**
+   * Get the ranking value from the Constants::SERVICE_RANKING property.
+   * Missing or non-integer values rank as 0.
+   *
+   * @param props The service properties, which must be locked by the caller.
+   */
+  static int GetRanking_unlocked(const Properties& props);
+
   std::shared_ptr<void> GetService(const std::string& interfaceId) const;
 
   std::shared_ptr<void> GetService_unlocked(const std::string& interfaceId) const;
@@ -23,25 +23,97 @@
 
 #include "ServiceRegistry.h"
 
-#include "cppmicroservices/ServiceFactory.h"
+#include "cppmicroservices/BundleEventHook.h"
+#include "cppmicroservices/BundleFindHook.h"
 #include "cppmicroservices/PrototypeServiceFactory.h"
+#include "cppmicroservices/ServiceEventListenerHook.h"
+#include "cppmicroservices/ServiceFactory.h"
+#include "cppmicroservices/ServiceFindHook.h"
 
 #include "BundlePrivate.h"
 #include "CoreBundleContext.h"
 #include "ServiceRegistrationBasePrivate.h"
+#include "Utils.h"
 
+#include <algorithm>
 #include <cassert>
 #include <iterator>
 #include <stdexcept>
 
 namespace cppmicroservices {
 
+namespace {
+
+/**
+ * Get a writable object, copying it first if a published
+ * snapshot may still be reading it.
+ */
+template<class T>
+T& Mutable(std::shared_ptr<T>& p)
+{
+  if (!p)
+  {
+    p = std::make_shared<T>();
+  }
+  else if (p.use_count() > 1)
+  {
+    p = std::make_shared<T>(*p);
+  }
+  else
+  {
+    // The last snapshot referencing this object may have been released by
+    // a reader on another thread; synchronize with its release.
+    std::atomic_thread_fence(std::memory_order_acquire);
+  }
+  return *p;
+}
+
+void Remove(ServiceRegistry::ServiceRegistrationsPtr& regs, const ServiceRegistrationBase& sr)
+{
+  ServiceRegistry::ServiceRegistrations& s = Mutable(regs);
+  s.erase(std::remove(s.begin(), s.end(), sr), s.end());
+}
+
+}
+
 void ServiceRegistry::Clear()
 {
   auto l = this->Lock(); US_UNUSED(l);
+  snapshot.Store(nullptr);
   services.clear();
-  classServices.clear();
-  serviceRegistrations.clear();
+  for (auto& shard : classShards)
+  {
+    auto l2 = shard->Lock(); US_UNUSED(l2);
+    shard->snapshot.Store(nullptr);
+    shard->classServices.clear();
+  }
+  for (auto& regs : serviceRegistrations)
+  {
+    regs = std::make_shared<ServiceRegistrations>();
+  }
+  std::fill(removedRegistrations.begin(), removedRegistrations.end(), 0);
+  bundleServices.clear();
+  usedBy.Lock(), usedBy.bundles.clear();
+  for (auto& index : propertyIndexes)
+  {
+    index = std::make_shared<PropertyIndex>();
+  }
+  for (auto& h : hooks)
+  {
+    h.count = 0;
+    h.registrations.Store(nullptr);
+  }
+  generations.ForEach([](ServiceLookupCache::Generation& g) { ++g; });
+  {
+    // All services are dropped without being logged, so earlier
+    // sequence numbers require a resync.
+    auto l2 = changeLog.Lock(); US_UNUSED(l2);
+    changeLog.firstSequenceNumber = ++changeLog.sequenceNumber + 1;
+  }
+  if (lookupCache)
+  {
+    lookupCache->Clear();
+  }
 }
 
 Properties ServiceRegistry::CreateServiceProperties(const ServiceProperties& in,
@@ -78,12 +150,312 @@ Properties ServiceRegistry::CreateServiceProperties(const ServiceProperties& in,
 ServiceRegistry::ServiceRegistry(CoreBundleContext* coreCtx)
   : core(coreCtx)
 {
+  InterfaceIdTable& ids = InterfaceIdTable::Instance();
+  hooks[SERVICE_FIND_HOOK].classId = ids.Intern(detail::GetServiceInterfaceId<ServiceFindHook>());
+  hooks[SERVICE_EVENT_LISTENER_HOOK].classId = ids.Intern(detail::GetServiceInterfaceId<ServiceEventListenerHook>());
+  hooks[BUNDLE_FIND_HOOK].classId = ids.Intern(detail::GetServiceInterfaceId<BundleFindHook>());
+  hooks[BUNDLE_EVENT_HOOK].classId = ids.Intern(detail::GetServiceInterfaceId<BundleEventHook>());
+  for (auto& h : hooks)
+  {
+    h.count = 0;
+  }
+
+  indexedKeys.push_back(Constants::SERVICE_PID);
+
+  for (auto key : GetStringListProperty(coreCtx->frameworkProperties, Constants::FRAMEWORK_SERVICE_INDEXED_KEYS))
+  {
+    std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+    // objectclass is always indexed by classServices.
+    if (!key.empty() && key != Constants::OBJECTCLASS &&
+        std::find(indexedKeys.begin(), indexedKeys.end(), key) == indexedKeys.end())
+    {
+      indexedKeys.push_back(key);
+    }
+  }
+
+  for (std::size_t i = 0; i < indexedKeys.size(); ++i)
+  {
+    propertyIndexes.push_back(std::make_shared<PropertyIndex>());
+  }
+
+  const std::size_t cacheSize = GetSizeProperty(coreCtx->frameworkProperties, Constants::FRAMEWORK_SERVICE_LOOKUP_CACHE_SIZE, 0);
+  if (cacheSize > 0)
+  {
+    lookupCache.reset(new ServiceLookupCache(cacheSize));
+  }
+
+  const std::size_t shardCount =
+      std::max<std::size_t>(1, GetSizeProperty(coreCtx->frameworkProperties, Constants::FRAMEWORK_SERVICE_REGISTRY_SHARDS, 1));
+  for (std::size_t i = 0; i < shardCount; ++i)
+  {
+    classShards.emplace_back(new ClassShard());
+    serviceRegistrations.push_back(std::make_shared<ServiceRegistrations>());
+    removedRegistrations.push_back(0);
+  }
 
+  changeLog.records.resize(GetSizeProperty(coreCtx->frameworkProperties, Constants::FRAMEWORK_SERVICE_CHANGE_LOG_SIZE, 1024));
+  changeLog.sequenceNumber = 0;
+  changeLog.firstSequenceNumber = 1;
 }
 
-ServiceRegistrationBase ServiceRegistry::RegisterService(BundlePrivate* bundle,
-                                                     const InterfaceMapConstPtr& service,
-                                                     const ServiceProperties& properties)
+ServiceRegistry::SnapshotConstPtr ServiceRegistry::GetSnapshot() const
+{
+  auto snap = snapshot.Load();
+  if (snap)
+  {
+    return snap;
+  }
+
+  auto l = this->Lock(); US_UNUSED(l);
+  snap = snapshot.Load();
+  if (!snap)
+  {
+    auto newSnap = std::make_shared<Snapshot>();
+    newSnap->serviceRegistrations.assign(serviceRegistrations.begin(), serviceRegistrations.end());
+    newSnap->propertyIndexes.assign(propertyIndexes.begin(), propertyIndexes.end());
+    snap = newSnap;
+    snapshot.Store(snap);
+  }
+  return snap;
+}
+
+const ServiceRegistry::Snapshot& ServiceRegistry::GetSnapshot(LookupSnapshots& snaps) const
+{
+  if (!snaps.snapshot)
+  {
+    snaps.snapshot = GetSnapshot();
+  }
+  return *snaps.snapshot;
+}
+
+std::size_t ServiceRegistry::GetClassShardIndex(InterfaceIdTable::Id classId) const
+{
+  return std::hash<InterfaceIdTable::Id>()(classId) % classShards.size();
+}
+
+ServiceRegistry::ClassShard& ServiceRegistry::GetClassShard(InterfaceIdTable::Id classId) const
+{
+  return *classShards[GetClassShardIndex(classId)];
+}
+
+ServiceRegistry::ClassSnapshotConstPtr ServiceRegistry::GetClassSnapshot(const ClassShard& shard) const
+{
+  auto snap = shard.snapshot.Load();
+  if (snap)
+  {
+    return snap;
+  }
+
+  auto l = shard.Lock(); US_UNUSED(l);
+  snap = shard.snapshot.Load();
+  if (!snap)
+  {
+    auto newSnap = std::make_shared<ClassSnapshot>();
+    newSnap->reserve(shard.classServices.size());
+    for (auto& i : shard.classServices)
+    {
+      newSnap->insert(std::make_pair(i.first, ServiceRegistrationsConstPtr(i.second)));
+    }
+    snap = newSnap;
+    shard.snapshot.Store(snap);
+  }
+  return snap;
+}
+
+const ServiceRegistry::ServiceRegistrations* ServiceRegistry::GetClassServices(
+    LookupSnapshots& snaps, InterfaceIdTable::Id classId) const
+{
+  const std::size_t index = GetClassShardIndex(classId);
+  if (snaps.classSnapshots.empty())
+  {
+    snaps.classSnapshots.resize(classShards.size());
+  }
+  ClassSnapshotConstPtr& snap = snaps.classSnapshots[index];
+  if (!snap)
+  {
+    snap = GetClassSnapshot(*classShards[index]);
+  }
+  auto iter = snap->find(classId);
+  return iter == snap->end() ? nullptr : iter->second.get();
+}
+
+void ServiceRegistry::AddClassServices_unlocked(InterfaceIdTable::Id classId, ServiceRegistrations& regs)
+{
+  std::sort(regs.begin(), regs.end());
+
+  ClassShard& shard = GetClassShard(classId);
+  shard.snapshot.Store(nullptr);
+  ServiceRegistrations& s = Mutable(shard.classServices[classId]);
+  const auto middle = static_cast<ServiceRegistrations::difference_type>(s.size());
+  s.insert(s.end(), regs.begin(), regs.end());
+  std::inplace_merge(s.begin(), s.begin() + middle, s.end());
+  UpdateHooks_unlocked(shard, classId);
+}
+
+bool ServiceRegistry::RemoveClassService_unlocked(InterfaceIdTable::Id classId, const ServiceRegistrationBase& sr)
+{
+  ClassShard& shard = GetClassShard(classId);
+  auto iter = shard.classServices.find(classId);
+  if (iter == shard.classServices.end() || !iter->second ||
+      std::find(iter->second->begin(), iter->second->end(), sr) == iter->second->end())
+  {
+    return false;
+  }
+
+  shard.snapshot.Store(nullptr);
+  if (iter->second->size() > 1)
+  {
+    ServiceRegistrations& s = Mutable(iter->second);
+    s.erase(std::find(s.begin(), s.end(), sr));
+  }
+  else
+  {
+    shard.classServices.erase(iter);
+  }
+  UpdateHooks_unlocked(shard, classId);
+  return true;
+}
+
+bool ServiceRegistry::IsUnregistered(const ServiceRegistrationBase& sr)
+{
+  return !sr.d->available || sr.d->unregistering;
+}
+
+std::vector<ServiceRegistry::ClassShard::UniqueLock> ServiceRegistry::LockClassShards(
+    const std::vector<InterfaceIdTable::Id>& classIds)
+{
+  std::vector<std::size_t> indexes;
+  for (auto classId : classIds)
+  {
+    indexes.push_back(GetClassShardIndex(classId));
+  }
+  std::sort(indexes.begin(), indexes.end());
+  indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
+
+  std::vector<ClassShard::UniqueLock> locks;
+  for (auto index : indexes)
+  {
+    locks.push_back(classShards[index]->Lock());
+  }
+  return locks;
+}
+
+std::size_t ServiceRegistry::GetPartition(const ServiceRegistrationBase& sr) const
+{
+  return static_cast<std::size_t>(sr.d->id) % serviceRegistrations.size();
+}
+
+ServiceRegistry::ServiceRegistrations& ServiceRegistry::GetServiceRegistrations_unlocked(const ServiceRegistrationBase& sr)
+{
+  return Mutable(serviceRegistrations[GetPartition(sr)]);
+}
+
+ServiceRegistry::IndexedValues ServiceRegistry::GetIndexedValues_unlocked(const Properties& props) const
+{
+  IndexedValues result(indexedKeys.size());
+  for (std::size_t i = 0; i < indexedKeys.size(); ++i)
+  {
+    const Any& value = props.Value_unlocked(indexedKeys[i]);
+    if (value.Empty())
+    {
+      continue;
+    }
+    if (value.Type() == typeid(std::string))
+    {
+      result[i].values.push_back(ref_any_cast<std::string>(value));
+    }
+    else if (value.Type() == typeid(std::vector<std::string>))
+    {
+      result[i].values = ref_any_cast<std::vector<std::string>>(value);
+    }
+    else
+    {
+      result[i].unindexed = true;
+    }
+  }
+  return result;
+}
+
+void ServiceRegistry::AddToPropertyIndexes_unlocked(const ServiceRegistrationBase& sr,
+                                                    const IndexedValues& values)
+{
+  for (std::size_t i = 0; i < values.size(); ++i)
+  {
+    if (values[i].values.empty() && !values[i].unindexed)
+    {
+      continue;
+    }
+    PropertyIndex& index = Mutable(propertyIndexes[i]);
+    if (values[i].unindexed)
+    {
+      Mutable(index.unindexed).push_back(sr);
+    }
+    for (auto& value : values[i].values)
+    {
+      ServiceRegistrations& s = Mutable(index.values[value]);
+      if (std::find(s.begin(), s.end(), sr) == s.end())
+      {
+        s.push_back(sr);
+      }
+    }
+  }
+}
+
+void ServiceRegistry::RemoveFromPropertyIndexes_unlocked(const ServiceRegistrationBase& sr,
+                                                         const IndexedValues& values)
+{
+  for (std::size_t i = 0; i < values.size(); ++i)
+  {
+    if (values[i].values.empty() && !values[i].unindexed)
+    {
+      continue;
+    }
+    PropertyIndex& index = Mutable(propertyIndexes[i]);
+    if (values[i].unindexed)
+    {
+      Remove(index.unindexed, sr);
+    }
+    for (auto& value : values[i].values)
+    {
+      auto iter = index.values.find(value);
+      if (iter == index.values.end())
+      {
+        continue;
+      }
+      if (iter->second->size() > 1)
+      {
+        Remove(iter->second, sr);
+      }
+      else
+      {
+        index.values.erase(iter);
+      }
+    }
+  }
+}
+
+void ServiceRegistry::UpdatePropertyIndexes_unlocked(const ServiceRegistrationBase& sr,
+                                                     const IndexedValues& oldValues,
+                                                     const IndexedValues& newValues)
+{
+  bool changed = false;
+  for (std::size_t i = 0; i < oldValues.size() && !changed; ++i)
+  {
+    changed = oldValues[i].unindexed != newValues[i].unindexed ||
+              oldValues[i].values != newValues[i].values;
+  }
+  if (changed)
+  {
+    snapshot.Store(nullptr);
+    RemoveFromPropertyIndexes_unlocked(sr, oldValues);
+    AddToPropertyIndexes_unlocked(sr, newValues);
+  }
+}
+
+ServiceRegistrationBase ServiceRegistry::CreateServiceRegistration(BundlePrivate* bundle,
+                                                                   const InterfaceMapConstPtr& service,
+                                                                   const ServiceProperties& properties,
+                                                                   std::vector<std::string>& classes)
 {
   if (!service || service->empty())
   {
@@ -94,7 +466,6 @@ ServiceRegistrationBase ServiceRegistry::RegisterService(BundlePrivate* bundle,
   bool isFactory = service->count("org.cppmicroservices.factory") > 0;
   bool isPrototypeFactory = (isFactory ? static_cast<bool>(std::dynamic_pointer_cast<PrototypeServiceFactory>(std::static_pointer_cast<ServiceFactory>(service->find("org.cppmicroservices.factory")->second))) : false);
 
-  std::vector<std::string> classes;
   // Check if service implements claimed classes and that they exist.
   for (auto i : *service)
   {
@@ -105,18 +476,36 @@ ServiceRegistrationBase ServiceRegistry::RegisterService(BundlePrivate* bundle,
     classes.push_back(i.first);
   }
 
-  ServiceRegistrationBase res(bundle, service,
-                              CreateServiceProperties(properties, classes, isFactory, isPrototypeFactory));
+  return ServiceRegistrationBase(bundle, service,
+                                 CreateServiceProperties(properties, classes, isFactory, isPrototypeFactory));
+}
+
+ServiceRegistrationBase ServiceRegistry::RegisterService(BundlePrivate* bundle,
+                                                     const InterfaceMapConstPtr& service,
+                                                     const ServiceProperties& properties)
+{
+  std::vector<std::string> classes;
+  ServiceRegistrationBase res = CreateServiceRegistration(bundle, service, properties, classes);
+  const IndexedValues indexedValues = (res.d->properties.Lock(), GetIndexedValues_unlocked(res.d->properties));
   {
     auto l = this->Lock(); US_UNUSED(l);
-    services.insert(std::make_pair(res, classes));
-    serviceRegistrations.push_back(res);
-    for (auto& clazz : classes)
+    snapshot.Store(nullptr);
+    AddServiceRegistration_unlocked(res);
+    AddToPropertyIndexes_unlocked(res, indexedValues);
+  }
+  // The class index is only guarded by the shard locks. A concurrent
+  // Unregister may have found the service already, in which case it must
+  // not be added after Unregister removed it.
+  {
+    auto locks = LockClassShards(res.d->classIds); US_UNUSED(locks);
+    if (!IsUnregistered(res))
     {
-      std::vector<ServiceRegistrationBase>& s = classServices[clazz];
-      std::vector<ServiceRegistrationBase>::iterator ip =
-          std::lower_bound(s.begin(), s.end(), res);
-      s.insert(ip, res);
+      for (auto clazz : res.d->classIds)
+      {
+        ServiceRegistrations regs(1, res);
+        AddClassServices_unlocked(clazz, regs);
+      }
+      ServiceChanged(res, ServiceEvent::SERVICE_REGISTERED);
     }
   }
 
@@ -129,41 +518,309 @@ ServiceRegistrationBase ServiceRegistry::RegisterService(BundlePrivate* bundle,
   return res;
 }
 
-void ServiceRegistry::UpdateServiceRegistrationOrder(const ServiceRegistrationBase& sr,
-                                                     const std::vector<std::string>& classes)
+std::vector<ServiceRegistrationBase> ServiceRegistry::RegisterServices(
+    BundlePrivate* bundle,
+    const std::vector<std::pair<InterfaceMapConstPtr, ServiceProperties> >& serviceList)
 {
-  auto l = this->Lock(); US_UNUSED(l);
-  for (auto& clazz : classes)
+  const std::size_t n = serviceList.size();
+  std::vector<ServiceRegistrationBase> res;
+  std::vector<std::vector<std::string> > classes(n);
+  std::vector<IndexedValues> indexedValues;
+  res.reserve(n);
+  indexedValues.reserve(n);
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    res.push_back(CreateServiceRegistration(bundle, serviceList[i].first,
+                                            serviceList[i].second, classes[i]));
+    indexedValues.push_back((res[i].d->properties.Lock(), GetIndexedValues_unlocked(res[i].d->properties)));
+  }
+
+  {
+    auto l = this->Lock(); US_UNUSED(l);
+    snapshot.Store(nullptr);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      AddServiceRegistration_unlocked(res[i]);
+      AddToPropertyIndexes_unlocked(res[i], indexedValues[i]);
+    }
+  }
+
+  // The class index is only guarded by the shard locks. Skip services
+  // which a concurrent Unregister has found already, see RegisterService.
+  {
+    std::vector<InterfaceIdTable::Id> classIds;
+    for (auto& sr : res)
+    {
+      classIds.insert(classIds.end(), sr.d->classIds.begin(), sr.d->classIds.end());
+    }
+    auto locks = LockClassShards(classIds); US_UNUSED(locks);
+
+    // Collect the services per class first and merge them into
+    // each class list at once.
+    std::unordered_map<InterfaceIdTable::Id, ServiceRegistrations> added;
+    std::vector<ServiceRegistrationBase> indexed;
+    for (auto& sr : res)
+    {
+      if (IsUnregistered(sr))
+      {
+        continue;
+      }
+      for (auto clazz : sr.d->classIds)
+      {
+        added[clazz].push_back(sr);
+      }
+      indexed.push_back(sr);
+    }
+    for (auto& a : added)
+    {
+      AddClassServices_unlocked(a.first, a.second);
+    }
+    // Class snapshots are published without the registry lock, so the
+    // changes must be recorded after the class lists are complete.
+    for (auto& sr : indexed)
+    {
+      ServiceChanged(sr, ServiceEvent::SERVICE_REGISTERED);
+    }
+  }
+
+  std::vector<ServiceEvent> registeredEvents;
+  registeredEvents.reserve(n);
+  for (auto& sr : res)
   {
-    std::vector<ServiceRegistrationBase>& s = classServices[clazz];
-    s.erase(std::remove(s.begin(), s.end(), sr), s.end());
+    registeredEvents.push_back(ServiceEvent(ServiceEvent::SERVICE_REGISTERED, sr.GetReference(std::string())));
+  }
+  std::vector<ServiceListeners::ServiceListenerEntries> listeners;
+  bundle->coreCtx->listeners.GetMatchingServiceListeners(registeredEvents, listeners);
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    bundle->coreCtx->listeners.ServiceChanged(listeners[i], registeredEvents[i]);
+  }
+  return res;
+}
+
+void ServiceRegistry::AddServiceRegistration_unlocked(const ServiceRegistrationBase& sr)
+{
+  ServiceRegistrations& regs = GetServiceRegistrations_unlocked(sr);
+  ServiceRegistrations& bundleRegs = bundleServices[sr.d->bundle];
+  ServiceInfo info = { regs.size(), bundleRegs.size() };
+  services.insert(std::make_pair(sr, info));
+  regs.push_back(sr);
+  bundleRegs.push_back(sr);
+}
+
+void ServiceRegistry::RemoveRegistration_unlocked(const ServiceRegistrationBase& sr, std::size_t pos)
+{
+  const std::size_t partition = GetPartition(sr);
+  ServiceRegistrations& regs = Mutable(serviceRegistrations[partition]);
+  std::size_t& removed = removedRegistrations[partition];
+  regs[pos] = ServiceRegistrationBase();
+  if (++removed * 2 < regs.size())
+  {
+    return;
+  }
+
+  regs.erase(std::remove_if(regs.begin(), regs.end(),
+                            [](const ServiceRegistrationBase& r) { return !r; }),
+             regs.end());
+  for (std::size_t i = 0; i < regs.size(); ++i)
+  {
+    services.find(regs[i])->second.position = i;
+  }
+  removed = 0;
+}
+
+void ServiceRegistry::RemoveAt_unlocked(ServiceRegistrations& regs, std::size_t pos,
+                                        std::size_t ServiceInfo::* position)
+{
+  if (pos + 1 < regs.size())
+  {
+    regs[pos] = std::move(regs.back());
+    services.find(regs[pos])->second.*position = pos;
+  }
+  regs.pop_back();
+}
+
+void ServiceRegistry::UpdateServiceRegistrationOrder(const ServiceRegistrationBase& sr)
+{
+  auto l = LockClassShards(sr.d->classIds); US_UNUSED(l);
+  UpdateServiceRegistrationOrder_unlocked(sr);
+}
+
+void ServiceRegistry::UpdateServiceRegistrationOrder_unlocked(const ServiceRegistrationBase& sr)
+{
+  for (auto clazz : sr.d->classIds)
+  {
+    ClassShard& shard = GetClassShard(clazz);
+    auto iter = shard.classServices.find(clazz);
+    if (iter == shard.classServices.end())
+    {
+      continue;
+    }
+    // The service may have been removed from the class index by a
+    // concurrent unregistration.
+    ServiceRegistrations& s = Mutable(iter->second);
+    auto pos = std::find(s.begin(), s.end(), sr);
+    if (pos == s.end())
+    {
+      continue;
+    }
+    shard.snapshot.Store(nullptr);
+    s.erase(pos);
     s.insert(std::lower_bound(s.begin(), s.end(), sr), sr);
+    UpdateHooks_unlocked(shard, clazz);
   }
 }
 
-void ServiceRegistry::Get(const std::string& clazz,
-                          std::vector<ServiceRegistrationBase>& serviceRegs) const
+void ServiceRegistry::UpdateHooks_unlocked(const ClassShard& shard, InterfaceIdTable::Id classId)
+{
+  for (auto& h : hooks)
+  {
+    if (h.classId != classId)
+    {
+      continue;
+    }
+    auto iter = shard.classServices.find(classId);
+    if (iter == shard.classServices.end() || !iter->second || iter->second->empty())
+    {
+      h.count = 0;
+      h.registrations.Store(nullptr);
+    }
+    else
+    {
+      h.registrations.Store(iter->second);
+      h.count = iter->second->size();
+    }
+  }
+}
+
+const ServiceLookupCache::Generation* ServiceRegistry::GetGeneration(InterfaceIdTable::Id classId) const
 {
-  this->Lock(), Get_unlocked(clazz, serviceRegs);
+  return &generations[classId];
 }
 
-void ServiceRegistry::Get_unlocked(const std::string& clazz,
-                                   std::vector<ServiceRegistrationBase>& serviceRegs) const
+void ServiceRegistry::InvalidateLookups(const ServiceRegistrationBase& sr)
 {
-  MapClassServices::const_iterator i = classServices.find(clazz);
-  if (i != classServices.end())
+  ++generations[InterfaceIdTable::EMPTY_ID];
+  for (auto clazz : sr.d->classIds)
   {
-    serviceRegs = i->second;
+    ++generations[clazz];
+  }
+}
+
+void ServiceRegistry::ServiceChanged(const ServiceRegistrationBase& sr, ServiceEvent::Type type)
+{
+  InvalidateLookups(sr);
+
+  auto l = changeLog.Lock(); US_UNUSED(l);
+  const std::uint64_t n = ++changeLog.sequenceNumber;
+  if (!changeLog.records.empty())
+  {
+    ChangeLog::Record& record = changeLog.records[(n - 1) % changeLog.records.size()];
+    record.type = type;
+    record.serviceId = sr.d->id;
+    record.classIds.assign(sr.d->classIds.begin(), sr.d->classIds.end());
+  }
+}
+
+ServiceChanges ServiceRegistry::GetChanges(std::uint64_t sequenceNumber) const
+{
+  ServiceChanges result;
+  std::vector<ChangeLog::Record> records;
+  {
+    auto l = changeLog.Lock(); US_UNUSED(l);
+    result.sequenceNumber = changeLog.sequenceNumber;
+    const std::uint64_t size = changeLog.records.size();
+    const std::uint64_t oldest = std::max(changeLog.firstSequenceNumber,
+                                          result.sequenceNumber >= size ? result.sequenceNumber - size + 1 : 1);
+    result.resyncRequired = sequenceNumber > result.sequenceNumber ||
+                            (sequenceNumber < result.sequenceNumber && sequenceNumber + 1 < oldest);
+    if (!result.resyncRequired)
+    {
+      for (std::uint64_t n = sequenceNumber + 1; n <= result.sequenceNumber; ++n)
+      {
+        records.push_back(changeLog.records[(n - 1) % size]);
+      }
+    }
+  }
+
+  // Resolve the class names without holding the lock.
+  InterfaceIdTable& ids = InterfaceIdTable::Instance();
+  result.changes.resize(records.size());
+  for (std::size_t i = 0; i < records.size(); ++i)
+  {
+    ServiceChange& change = result.changes[i];
+    change.sequenceNumber = sequenceNumber + 1 + i;
+    change.type = records[i].type;
+    change.serviceId = records[i].serviceId;
+    for (auto id : records[i].classIds)
+    {
+      change.objectClass.push_back(ids.GetName(id));
+    }
+  }
+  return result;
+}
+
+ServiceRegistry::ServiceRegistrationsConstPtr ServiceRegistry::GetHooks(HookType type) const
+{
+  if (!HasHooks(type))
+  {
+    return nullptr;
+  }
+  return hooks[type].registrations.Load();
+}
+
+void ServiceRegistry::Get(const std::string& clazz,
+                          std::vector<ServiceRegistrationBase>& serviceRegs) const
+{
+  InterfaceIdTable::Id classId;
+  if (!InterfaceIdTable::Instance().Find(clazz, classId))
+  {
+    return;
+  }
+  auto snap = GetClassSnapshot(GetClassShard(classId));
+  auto i = snap->find(classId);
+  if (i != snap->end())
+  {
+    serviceRegs = *i->second;
   }
 }
 
 ServiceReferenceBase ServiceRegistry::Get(BundlePrivate* bundle, const std::string& clazz) const
 {
-  auto l = this->Lock(); US_UNUSED(l);
+  // Without find hooks the best service is the last entry of the
+  // ranking-ordered class list.
+  if (!clazz.empty() && !HasHooks(SERVICE_FIND_HOOK))
+  {
+    InterfaceIdTable::Id classId;
+    if (!InterfaceIdTable::Instance().Find(clazz, classId))
+    {
+      return ServiceReferenceBase();
+    }
+
+    auto snap = GetClassSnapshot(GetClassShard(classId));
+    auto i = snap->find(classId);
+    if (i != snap->end())
+    {
+      const ServiceRegistrations& s = *i->second;
+      for (auto iter = s.rbegin(), iterEnd = s.rend(); iter != iterEnd; ++iter)
+      {
+        try
+        {
+          return iter->GetReference(clazz);
+        }
+        catch (const std::logic_error&)
+        {
+          // The service was unregistered after the snapshot was taken.
+        }
+      }
+    }
+    return ServiceReferenceBase();
+  }
+
   try
   {
     std::vector<ServiceReferenceBase> srs;
-    Get_unlocked(clazz, "", bundle, srs);
+    Get(clazz, "", bundle, srs);
     DIAG_LOG(*core->sink) << "get service ref " << clazz << " for bundle "
              << bundle->symbolicName << " = " << srs.size() << " refs";
 
@@ -178,87 +835,219 @@ ServiceReferenceBase ServiceRegistry::Get(BundlePrivate* bundle, const std::stri
   return ServiceReferenceBase();
 }
 
-void ServiceRegistry::Get(const std::string& clazz, const std::string& filter,
-                          BundlePrivate* bundle, std::vector<ServiceReferenceBase>& res) const
+const ServiceRegistry::ServiceRegistrations* ServiceRegistry::GetCandidates(
+    LookupSnapshots& snaps, InterfaceIdTable::Id classId, const LDAPExpr& ldap,
+    ServiceRegistrations& merged, bool& checkClass) const
 {
-  this->Lock(), Get_unlocked(clazz, filter, bundle, res);
-}
+  checkClass = false;
 
-void ServiceRegistry::Get_unlocked(const std::string& clazz, const std::string& filter,
-                          BundlePrivate* bundle, std::vector<ServiceReferenceBase>& res) const
-{
-  std::vector<ServiceRegistrationBase>::const_iterator s;
-  std::vector<ServiceRegistrationBase>::const_iterator send;
-  std::vector<ServiceRegistrationBase> v;
-  LDAPExpr ldap;
-  if (clazz.empty())
+  // Either a single list or several lists to be merged.
+  const ServiceRegistrations* best = nullptr;
+  std::vector<const ServiceRegistrations*> bestLists;
+  std::size_t bestSize = 0;
+  LDAPExpr::ObjectClassSet matchedClasses;
+  bool allServices = false;
+
+  if (classId != InterfaceIdTable::EMPTY_ID)
+  {
+    best = GetClassServices(snaps, classId);
+    if (best == nullptr)
+    {
+      return nullptr;
+    }
+    bestSize = best->size();
+  }
+  else if (!ldap.IsNull() && ldap.GetMatchedObjectClasses(matchedClasses))
   {
-    if (!filter.empty())
+    for (auto& className : matchedClasses)
     {
-      ldap = LDAPExpr(filter);
-      LDAPExpr::ObjectClassSet matched;
-      if (ldap.GetMatchedObjectClasses(matched))
+      InterfaceIdTable::Id id;
+      if (!InterfaceIdTable::Instance().Find(className, id))
       {
-        v.clear();
-        for(auto& className : matched)
-        {
-          auto i = classServices.find(className);
-          if (i != classServices.end())
-          {
-            std::copy(i->second.begin(), i->second.end(), std::back_inserter(v));
-          }
-        }
-        if (!v.empty())
-        {
-          s = v.begin();
-          send = v.end();
-        }
-        else
-        {
-          return;
-        }
+        continue;
       }
-      else
+      const ServiceRegistrations* s = GetClassServices(snaps, id);
+      if (s != nullptr)
       {
-        s = serviceRegistrations.begin();
-        send = serviceRegistrations.end();
+        bestLists.push_back(s);
+        bestSize += s->size();
       }
     }
-    else
+    if (bestSize == 0)
     {
-      s = serviceRegistrations.begin();
-      send = serviceRegistrations.end();
+      return nullptr;
     }
   }
   else
   {
-    MapClassServices::const_iterator it = classServices.find(clazz);
-    if (it != classServices.end())
+    allServices = true;
+    for (auto& s : GetSnapshot(snaps).serviceRegistrations)
     {
-      s = it->second.begin();
-      send = it->second.end();
+      bestLists.push_back(s.get());
+      bestSize += s->size();
     }
-    else
+    if (bestLists.size() == 1)
     {
-      return;
+      best = bestLists.front();
+    }
+  }
+
+  // Use the most selective secondary index, if any.
+  std::size_t bestIndex = indexedKeys.size();
+  LDAPExpr::ValueSet bestValues;
+  for (std::size_t i = 0; i < indexedKeys.size() && !ldap.IsNull(); ++i)
+  {
+    LDAPExpr::ValueSet values;
+    if (!ldap.GetMatchedValues(indexedKeys[i], values))
+    {
+      continue;
+    }
+    const PropertyIndex& index = *GetSnapshot(snaps).propertyIndexes[i];
+    std::size_t size = index.unindexed ? index.unindexed->size() : 0;
+    for (auto& value : values)
+    {
+      auto iter = index.values.find(value);
+      if (iter != index.values.end())
+      {
+        size += iter->second->size();
+      }
+    }
+    if (size < bestSize)
+    {
+      bestIndex = i;
+      bestSize = size;
+      bestValues.swap(values);
+    }
+  }
+
+  if (bestIndex < indexedKeys.size())
+  {
+    if (bestSize == 0)
+    {
+      return nullptr;
     }
-    if (!filter.empty())
+
+    const PropertyIndex& index = *GetSnapshot(snaps).propertyIndexes[bestIndex];
+    merged.reserve(bestSize);
+    if (index.unindexed)
     {
-      ldap = LDAPExpr(filter);
+      merged.insert(merged.end(), index.unindexed->begin(), index.unindexed->end());
     }
+    for (auto& value : bestValues)
+    {
+      auto iter = index.values.find(value);
+      if (iter != index.values.end())
+      {
+        merged.insert(merged.end(), iter->second->begin(), iter->second->end());
+      }
+    }
+    // Keep the ranking order of the class lists and drop services
+    // found under several values.
+    std::sort(merged.begin(), merged.end());
+    merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+    checkClass = classId != InterfaceIdTable::EMPTY_ID;
+    return &merged;
   }
 
-  for (; s != send; ++s)
+  if (best == nullptr)
+  {
+    merged.reserve(bestSize);
+    for (auto s : bestLists)
+    {
+      const auto middle = static_cast<std::ptrdiff_t>(merged.size());
+      std::copy_if(s->begin(), s->end(), std::back_inserter(merged),
+                   [](const ServiceRegistrationBase& sr) { return static_cast<bool>(sr); });
+      if (allServices)
+      {
+        // Merge the serviceRegistrations lists in registration order.
+        std::inplace_merge(merged.begin(), merged.begin() + middle, merged.end(),
+                           [](const ServiceRegistrationBase& a, const ServiceRegistrationBase& b)
+                           { return a.d->id < b.d->id; });
+      }
+    }
+    return &merged;
+  }
+
+  return best;
+}
+
+void ServiceRegistry::Get(const std::string& clazz, const std::string& filter,
+                          BundlePrivate* bundle, std::vector<ServiceReferenceBase>& res) const
+{
+  InterfaceIdTable::Id classId = InterfaceIdTable::EMPTY_ID;
+  if (!clazz.empty() && !InterfaceIdTable::Instance().Find(clazz, classId))
   {
-    ServiceReferenceBase sri = s->GetReference(clazz);
+    // No service has ever been registered under this class.
+    return;
+  }
 
-    if (filter.empty() || ldap.Evaluate(PropertiesHandle(s->d->properties, true), false))
+  // Results are only cached without find hooks, which may filter
+  // differently for each call and each requesting bundle.
+  const bool useCache = lookupCache && !HasHooks(SERVICE_FIND_HOOK);
+  const std::size_t first = res.size();
+  const ServiceLookupCache::Generation* generation = nullptr;
+  std::uint64_t generationValue = 0;
+  if (useCache)
+  {
+    if (lookupCache->Get(clazz, filter, res))
     {
-      res.push_back(sri);
+      return;
     }
+    // Read the counter before the snapshot, so that a concurrent change
+    // leaves the result outdated rather than cached as current.
+    generation = GetGeneration(classId);
+    generationValue = generation->load();
+  }
+
+  // Keep the snapshots alive until we are done iterating their lists.
+  LookupSnapshots snaps;
+
+  LDAPExpr ldap;
+  if (!filter.empty())
+  {
+    ldap = core->ldapExprCache.Get(filter);
+  }
+
+  ServiceRegistrations merged;
+  bool checkClass = false;
+  const ServiceRegistrations* candidates = GetCandidates(snaps, classId, ldap, merged, checkClass);
+  if (candidates == nullptr)
+  {
+    return;
   }
 
-  if (!res.empty())
+  for (auto& sr : *candidates)
+  {
+    if (!sr)
+    {
+      // A service removed from a serviceRegistrations list.
+      continue;
+    }
+    if (checkClass &&
+        std::find(sr.d->classIds.begin(), sr.d->classIds.end(), classId) == sr.d->classIds.end())
+    {
+      continue;
+    }
+    if (!ldap.IsNull() && !ldap.Evaluate(PropertiesHandle(sr.d->properties, true), false))
+    {
+      continue;
+    }
+
+    try
+    {
+      res.push_back(sr.GetReference(clazz));
+    }
+    catch (const std::logic_error&)
+    {
+      // The service was unregistered after the snapshot was taken.
+    }
+  }
+  if (useCache)
+  {
+    lookupCache->Put(clazz, filter, generation, generationValue,
+                     first == 0 ? res : std::vector<ServiceReferenceBase>(res.begin() + static_cast<std::ptrdiff_t>(first), res.end()));
+  }
+  else if (!res.empty())
   {
     if (bundle != nullptr)
     {
@@ -274,61 +1063,119 @@ void ServiceRegistry::Get_unlocked(const std::string& clazz, const std::string&
 
 void ServiceRegistry::RemoveServiceRegistration(const ServiceRegistrationBase& sr)
 {
-  auto l = this->Lock(); US_UNUSED(l);
-  RemoveServiceRegistration_unlocked(sr);
+  if ((this->Lock(), RemoveServiceRegistration_unlocked(sr)))
+  {
+    RemoveFromClassIndex(sr);
+  }
 }
 
-void ServiceRegistry::RemoveServiceRegistration_unlocked(const ServiceRegistrationBase& sr)
+bool ServiceRegistry::RemoveServiceRegistration_unlocked(const ServiceRegistrationBase& sr)
 {
-  std::vector<std::string> classes;
+  auto iter = services.find(sr);
+  if (iter == services.end())
   {
-    auto l2 = sr.d->properties.Lock(); US_UNUSED(l2);
-    assert(sr.d->properties.Value_unlocked(Constants::OBJECTCLASS).Type() == typeid(std::vector<std::string>));
-    classes = ref_any_cast<std::vector<std::string> >(
-          sr.d->properties.Value_unlocked(Constants::OBJECTCLASS));
+    return false;
   }
-  services.erase(sr);
-  serviceRegistrations.erase(std::remove(serviceRegistrations.begin(), serviceRegistrations.end(), sr),
-                             serviceRegistrations.end());
-  for (auto& clazz : classes)
+  const ServiceInfo info = iter->second;
+  services.erase(iter);
+
+  const IndexedValues indexedValues = (sr.d->properties.Lock(), GetIndexedValues_unlocked(sr.d->properties));
+  snapshot.Store(nullptr);
+  RemoveRegistration_unlocked(sr, info.position);
+  auto bundleIter = bundleServices.find(sr.d->bundle);
+  RemoveAt_unlocked(bundleIter->second, info.bundlePosition, &ServiceInfo::bundlePosition);
+  if (bundleIter->second.empty())
   {
-    std::vector<ServiceRegistrationBase>& s = classServices[clazz];
-    if (s.size() > 1)
-    {
-      s.erase(std::remove(s.begin(), s.end(), sr), s.end());
-    }
-    else
+    bundleServices.erase(bundleIter);
+  }
+  RemoveFromPropertyIndexes_unlocked(sr, indexedValues);
+  return true;
+}
+
+void ServiceRegistry::RemoveFromClassIndex(const ServiceRegistrationBase& sr)
+{
+  auto locks = LockClassShards(sr.d->classIds); US_UNUSED(locks);
+  bool removed = false;
+  for (auto clazz : sr.d->classIds)
+  {
+    if (RemoveClassService_unlocked(clazz, sr))
     {
-      classServices.erase(clazz);
+      removed = true;
     }
   }
+  // A service which RegisterService has not added to the class index yet
+  // is never added, so its registration is not recorded either. Lookups
+  // without a class may have found it in serviceRegistrations, though.
+  if (removed)
+  {
+    ServiceChanged(sr, ServiceEvent::SERVICE_UNREGISTERING);
+  }
+  else
+  {
+    InvalidateLookups(sr);
+  }
 }
 
 void ServiceRegistry::GetRegisteredByBundle(BundlePrivate* p,
                                             std::vector<ServiceRegistrationBase>& res) const
 {
-  auto l = this->Lock(); US_UNUSED(l);
-
-  for (auto& sr : serviceRegistrations)
+  const std::size_t first = res.size();
   {
-    if (sr.d->bundle == p)
+    auto l = this->Lock(); US_UNUSED(l);
+    auto iter = bundleServices.find(p);
+    if (iter != bundleServices.end())
     {
-      res.push_back(sr);
+      res.insert(res.end(), iter->second.begin(), iter->second.end());
     }
   }
+  // Return the services in registration order.
+  std::sort(res.begin() + static_cast<std::ptrdiff_t>(first), res.end(),
+            [](const ServiceRegistrationBase& a, const ServiceRegistrationBase& b)
+            { return a.d->id < b.d->id; });
 }
 
 void ServiceRegistry::GetUsedByBundle(BundlePrivate* bundle,
                                       std::vector<ServiceRegistrationBase>& res) const
 {
-  auto l = this->Lock(); US_UNUSED(l);
+  const std::size_t first = res.size();
+  {
+    auto l = usedBy.Lock(); US_UNUSED(l);
+    auto iter = usedBy.bundles.find(bundle);
+    if (iter != usedBy.bundles.end())
+    {
+      for (auto& sr : iter->second)
+      {
+        // Skip services which are being unregistered and
+        // have already been removed from the registry.
+        if (!sr.d->unregistering)
+        {
+          res.push_back(sr);
+        }
+      }
+    }
+  }
+  // Return the services in registration order.
+  std::sort(res.begin() + static_cast<std::ptrdiff_t>(first), res.end(),
+            [](const ServiceRegistrationBase& a, const ServiceRegistrationBase& b)
+            { return a.d->id < b.d->id; });
+}
+
+void ServiceRegistry::AddUsedByBundle(BundlePrivate* bundle, const ServiceRegistrationBase& sr)
+{
+  auto l = usedBy.Lock(); US_UNUSED(l);
+  usedBy.bundles[bundle].insert(sr);
+}
 
-  for (std::vector<ServiceRegistrationBase>::const_iterator i = serviceRegistrations.begin();
-       i != serviceRegistrations.end(); ++i)
+void ServiceRegistry::RemoveUsedByBundle(BundlePrivate* bundle, const ServiceRegistrationBase& sr)
+{
+  auto l = usedBy.Lock(); US_UNUSED(l);
+  auto iter = usedBy.bundles.find(bundle);
+  if (iter != usedBy.bundles.end())
   {
-    if (i->d->IsUsedByBundle(bundle))
+    iter->second.erase(sr);
+    if (iter->second.empty())
     {
-      res.push_back(*i);
+      usedBy.bundles.erase(iter);
     }
   }
 }
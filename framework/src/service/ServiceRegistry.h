@@ -24,14 +24,22 @@
 #ifndef CPPMICROSERVICES_SERVICEREGISTRY_H
 #define CPPMICROSERVICES_SERVICEREGISTRY_H
 
+#include "cppmicroservices/ServiceChanges.h"
 #include "cppmicroservices/ServiceInterface.h"
 #include "cppmicroservices/ServiceRegistration.h"
 #include "cppmicroservices/detail/Threads.h"
 
+#include "InterfaceIdTable.h"
+#include "ServiceLookupCache.h"
+
+#include <memory>
+#include <unordered_set>
+
 namespace cppmicroservices {
 
 class CoreBundleContext;
 class BundlePrivate;
+class LDAPExpr;
 class Properties;
 
 
@@ -58,24 +66,173 @@ public:
                                             const std::vector<std::string>& classes = std::vector<std::string>(),
                                             bool isFactory = false, bool isPrototypeFactory = false, long sid = -1);
 
-  typedef std::unordered_map<ServiceRegistrationBase, std::vector<std::string> > MapServiceClasses;
-  typedef std::unordered_map<std::string, std::vector<ServiceRegistrationBase> > MapClassServices;
+  typedef std::vector<ServiceRegistrationBase> ServiceRegistrations;
+  typedef std::shared_ptr<ServiceRegistrations> ServiceRegistrationsPtr;
+  typedef std::shared_ptr<const ServiceRegistrations> ServiceRegistrationsConstPtr;
+
+  /**
+   * Bookkeeping for a registered service.
+   */
+  struct ServiceInfo
+  {
+    /**
+     * Position of the service in its serviceRegistrations partition.
+     */
+    std::size_t position;
+
+    /**
+     * Position of the service in the bundleServices list of
+     * the bundle which registered it.
+     */
+    std::size_t bundlePosition;
+  };
+
+  typedef std::unordered_map<ServiceRegistrationBase, ServiceInfo> MapServiceInfo;
+  typedef std::unordered_map<InterfaceIdTable::Id, ServiceRegistrationsPtr> MapClassServices;
+
+  /**
+   * A secondary index of registered services by the value of a
+   * service property.
+   */
+  struct PropertyIndex
+  {
+    /**
+     * Mapping of property value to registered services. Services with a
+     * std::vector<std::string> value are mapped under each element.
+     */
+    std::unordered_map<std::string, ServiceRegistrationsPtr> values;
+
+    /**
+     * Services with a property value which is not of a string type.
+     * They can only be matched by evaluating a filter and are therefore
+     * always lookup candidates.
+     */
+    ServiceRegistrationsPtr unindexed;
+  };
+
+  typedef std::shared_ptr<PropertyIndex> PropertyIndexPtr;
+  typedef std::shared_ptr<const PropertyIndex> PropertyIndexConstPtr;
+
+  /**
+   * The value of an indexed property of a single service.
+   */
+  struct IndexedValue
+  {
+    IndexedValue() : unindexed(false) {}
+
+    std::vector<std::string> values;
+    bool unindexed;
+  };
+
+  /**
+   * The values of all indexed properties of a service, in the
+   * order of ServiceRegistry::indexedKeys.
+   */
+  typedef std::vector<IndexedValue> IndexedValues;
+
+  /**
+   * An immutable view of the registry indexes which are not partitioned
+   * by class.
+   *
+   * Readers load the current snapshot atomically and never take the
+   * registry lock. Writers invalidate the published snapshot under the
+   * registry lock and copy a registration list only if a snapshot still
+   * references it. The next reader publishes a fresh snapshot. Old snapshots
+   * are reclaimed when the last reader releases its reference.
+   */
+  struct Snapshot
+  {
+    std::vector<ServiceRegistrationsConstPtr> serviceRegistrations;
+    std::vector<PropertyIndexConstPtr> propertyIndexes;
+  };
+
+  typedef std::shared_ptr<const Snapshot> SnapshotConstPtr;
+
+  /**
+   * An immutable view of the class lists of one ClassShard, published
+   * and invalidated like Snapshot but under the lock of the shard.
+   */
+  typedef std::unordered_map<InterfaceIdTable::Id, ServiceRegistrationsConstPtr> ClassSnapshot;
+  typedef std::shared_ptr<const ClassSnapshot> ClassSnapshotConstPtr;
+
+  /**
+   * A partition of the class index. The shard of a class is selected by
+   * the hash of its interned name. Writers modify a shard and readers
+   * publish a new shard snapshot while holding only the shard lock.
+   * The ranking of a service only changes while the shards of all its
+   * classes are locked, so writers always find the class lists ordered.
+   */
+  struct ClassShard : detail::MultiThreaded<>
+  {
+    /**
+     * Mapping of interned class name to registered services. The lists
+     * are ordered with the highest ranked service last.
+     */
+    MapClassServices classServices;
+
+    /**
+     * The currently published snapshot of classServices, or an empty
+     * pointer if a writer changed the shard since it was last published.
+     */
+    mutable detail::Atomic<ClassSnapshotConstPtr> snapshot;
+  };
+
+  /**
+   * The framework hook interfaces for which a live count and the list
+   * of registered hooks are maintained, see HasHooks and GetHooks.
+   */
+  enum HookType
+  {
+    SERVICE_FIND_HOOK,
+    SERVICE_EVENT_LISTENER_HOOK,
+    BUNDLE_FIND_HOOK,
+    BUNDLE_EVENT_HOOK,
+    HOOK_TYPE_COUNT
+  };
 
   /**
    * All registered services in the current framework.
    * Mapping of registered service to class names under which
-   * the service is registerd.
+   * the service is registerd and its positions in
+   * serviceRegistrations and bundleServices.
    */
-  MapServiceClasses services;
+  MapServiceInfo services;
 
-  std::vector<ServiceRegistrationBase> serviceRegistrations;
+  /**
+   * All registered services in registration order, partitioned by
+   * service id into one list per class shard. Unregistered services
+   * leave an invalid ServiceRegistrationBase behind until their list is
+   * compacted, see RemoveRegistration_unlocked.
+   */
+  std::vector<ServiceRegistrationsPtr> serviceRegistrations;
+
+  /**
+   * The number of invalid entries in each serviceRegistrations list.
+   */
+  std::vector<std::size_t> removedRegistrations;
+
+  /**
+   * Mapping of bundle to the services it registered, in no
+   * particular order.
+   */
+  std::unordered_map<BundlePrivate*, ServiceRegistrations> bundleServices;
+
+  /**
+   * The class index, partitioned into Constants::FRAMEWORK_SERVICE_REGISTRY_SHARDS
+   * shards. This does not change after construction.
+   */
+  std::vector<std::unique_ptr<ClassShard> > classShards;
+
+  /**
+   * Lower-case property keys for which a secondary index is maintained.
+   * This does not change after construction.
+   */
+  std::vector<std::string> indexedKeys;
 
   /**
-   * Mapping of classname to registered service.
-   * The List of registered services are ordered with the highest
-   * ranked service first.
+   * Secondary indexes, in the order of indexedKeys.
    */
-  MapClassServices classServices;
+  std::vector<PropertyIndexPtr> propertyIndexes;
 
   CoreBundleContext* core;
 
@@ -103,15 +260,45 @@ public:
                                           const InterfaceMapConstPtr& service,
                                           const ServiceProperties& properties);
 
+  /**
+   * Register several services in the framework wide register.
+   *
+   * All services are added to the registry under one lock acquisition
+   * before the SERVICE_REGISTERED events are fired, one event per service
+   * in the order of <code>serviceList</code>.
+   *
+   * @param bundle The bundle registering the services.
+   * @param serviceList The service objects and their properties.
+   * @return The ServiceRegistration objects, in the order of <code>serviceList</code>.
+   * @exception std::invalid_argument If one of the services is invalid, see
+   *            RegisterService. No service is registered in that case.
+   */
+  std::vector<ServiceRegistrationBase> RegisterServices(
+      BundlePrivate* bundle,
+      const std::vector<std::pair<InterfaceMapConstPtr, ServiceProperties> >& serviceList);
+
   /**
    * Service ranking changed, reorder registered services
-   * according to ranking.
+   * according to ranking. This only takes the class shard locks.
    *
-   * @param serviceRegistration The ServiceRegistrationPrivate object.
-   * @param rank New rank of object.
+   * @param sr The ServiceRegistration object.
    */
-  void UpdateServiceRegistrationOrder(const ServiceRegistrationBase& sr,
-                                      const std::vector<std::string>& classes);
+  void UpdateServiceRegistrationOrder(const ServiceRegistrationBase& sr);
+
+  /**
+   * Get the values of all indexed properties.
+   *
+   * @param props The service properties. The caller must hold their lock.
+   * @return The values in the order of indexedKeys.
+   */
+  IndexedValues GetIndexedValues_unlocked(const Properties& props) const;
+
+  /**
+   * Get the changes after <code>sequenceNumber</code>.
+   *
+   * @see BundleContext::GetServiceChanges
+   */
+  ServiceChanges GetChanges(std::uint64_t sequenceNumber) const;
 
   /**
    * Get all services implementing a certain class.
@@ -123,7 +310,27 @@ public:
   void Get(const std::string& clazz, std::vector<ServiceRegistrationBase>& serviceRegs) const;
 
   /**
-   * Get a service implementing a certain class.
+   * Check if any hook of the given type is registered. This is a single
+   * atomic load and does not take any lock.
+   */
+  bool HasHooks(HookType type) const
+  {
+    return hooks[type].count.load() != 0;
+  }
+
+  /**
+   * Get the registered hooks of the given type.
+   *
+   * @return The hook registrations ordered with the highest ranked hook
+   *         last, or an empty pointer if there are none.
+   */
+  ServiceRegistrationsConstPtr GetHooks(HookType type) const;
+
+  /**
+   * Get the highest ranked service implementing a certain class.
+   *
+   * Unless find hooks are registered, this reads the end of the ranking
+   * ordered class list and does not build the list of all references.
    *
    * @param bundle The bundle requesting reference
    * @param clazz The class name of the requested service.
@@ -166,17 +373,289 @@ public:
    */
   void GetUsedByBundle(BundlePrivate* bundle, std::vector<ServiceRegistrationBase>& serviceRegs) const;
 
+  /**
+   * Record that a bundle started to use a service, i.e. it got an entry in
+   * the dependents or prototypeServiceInstances map of the registration.
+   *
+   * This only takes the lock of the usage index and may be called while
+   * holding the registration lock.
+   */
+  void AddUsedByBundle(BundlePrivate* bundle, const ServiceRegistrationBase& sr);
+
+  /**
+   * Record that a bundle no longer uses a service.
+   *
+   * This only takes the lock of the usage index and may be called while
+   * holding the registration lock.
+   */
+  void RemoveUsedByBundle(BundlePrivate* bundle, const ServiceRegistrationBase& sr);
+
 private:
 
   friend class ServiceHooks;
   friend class ServiceRegistrationBase;
 
-  void RemoveServiceRegistration_unlocked(const ServiceRegistrationBase& sr);
+  /**
+   * The currently published snapshot, or an empty pointer if a writer
+   * changed the registry since it was last published.
+   */
+  mutable detail::Atomic<SnapshotConstPtr> snapshot;
 
-  void Get_unlocked(const std::string& clazz, std::vector<ServiceRegistrationBase>& serviceRegs) const;
+  /**
+   * Mapping of bundle to the registered services it uses. This is updated
+   * while holding registration locks, so it has its own lock which must
+   * always be acquired last.
+   */
+  struct UsedByIndex : detail::MultiThreaded<>
+  {
+    std::unordered_map<BundlePrivate*, std::unordered_set<ServiceRegistrationBase> > bundles;
+  };
+
+  UsedByIndex usedBy;
+
+  /**
+   * The registered hooks of one type. The list shares the class list
+   * of its class shard, which is copied on the next write.
+   */
+  struct HookRegistrations
+  {
+    InterfaceIdTable::Id classId;
+    std::atomic<std::size_t> count;
+    detail::Atomic<ServiceRegistrationsConstPtr> registrations;
+  };
 
-  void Get_unlocked(const std::string& clazz, const std::string& filter,
-                    BundlePrivate* bundle, std::vector<ServiceReferenceBase>& serviceRefs) const;
+  HookRegistrations hooks[HOOK_TYPE_COUNT];
+
+  /**
+   * Change counters per interned class name, incremented whenever a
+   * service of that class is registered, unregistered or modified. The
+   * counter of InterfaceIdTable::EMPTY_ID is incremented for every service.
+   * Counters are never removed because cached lookup results refer to them,
+   * and they are read and incremented without the registry lock.
+   */
+  mutable InterfaceIdArray<ServiceLookupCache::Generation> generations;
+
+  /**
+   * Cached lookup results, or empty if the cache is disabled.
+   */
+  std::unique_ptr<ServiceLookupCache> lookupCache;
+
+  /**
+   * A ring buffer of the most recent changes. Registrations and
+   * unregistrations are recorded under the class shard locks of the
+   * service, together with the class index update, so that they are
+   * recorded in order. Modifications are recorded under the registry
+   * lock. Its lock must always be acquired last.
+   */
+  struct ChangeLog : detail::MultiThreaded<>
+  {
+    struct Record
+    {
+      ServiceEvent::Type type;
+      long serviceId;
+      std::vector<InterfaceIdTable::Id> classIds;
+    };
+
+    /**
+     * The record of change number n is stored at (n - 1) % records.size().
+     */
+    std::vector<Record> records;
+
+    /**
+     * The sequence number of the latest change.
+     */
+    std::uint64_t sequenceNumber;
+
+    /**
+     * The lowest sequence number from which on all changes were logged.
+     */
+    std::uint64_t firstSequenceNumber;
+  };
+
+  mutable ChangeLog changeLog;
+
+  /**
+   * The snapshots used by one lookup. They are loaded on first use and
+   * keep the lists returned by GetCandidates alive.
+   */
+  struct LookupSnapshots
+  {
+    SnapshotConstPtr snapshot;
+    std::vector<ClassSnapshotConstPtr> classSnapshots;
+  };
+
+  /**
+   * Get the current snapshot of the registry indexes, publishing a new
+   * one if the registry changed. Must be called without holding the
+   * registry lock.
+   */
+  SnapshotConstPtr GetSnapshot() const;
+
+  const Snapshot& GetSnapshot(LookupSnapshots& snaps) const;
+
+  std::size_t GetClassShardIndex(InterfaceIdTable::Id classId) const;
+
+  ClassShard& GetClassShard(InterfaceIdTable::Id classId) const;
+
+  /**
+   * Get the current snapshot of a class shard, publishing a new one if
+   * the shard changed. Must be called without holding the shard lock.
+   */
+  ClassSnapshotConstPtr GetClassSnapshot(const ClassShard& shard) const;
+
+  /**
+   * Get the services registered under <code>classId</code>.
+   *
+   * @return The ranking-ordered list, or <code>nullptr</code> if there are none.
+   */
+  const ServiceRegistrations* GetClassServices(LookupSnapshots& snaps, InterfaceIdTable::Id classId) const;
+
+  /**
+   * Add the services in <code>regs</code> to the ranking-ordered list of
+   * <code>classId</code>, sorting <code>regs</code>. The caller must hold
+   * the lock of the class shard, see LockClassShards.
+   */
+  void AddClassServices_unlocked(InterfaceIdTable::Id classId, ServiceRegistrations& regs);
+
+  /**
+   * Remove <code>sr</code> from the list of <code>classId</code>. The
+   * caller must hold the lock of the class shard, see LockClassShards.
+   *
+   * @return <code>false</code> if the list does not contain <code>sr</code>.
+   */
+  bool RemoveClassService_unlocked(InterfaceIdTable::Id classId, const ServiceRegistrationBase& sr);
+
+  /**
+   * Whether <code>sr</code> is being or has been unregistered. Unregister
+   * sets <code>unregistering</code> before it removes the service from the
+   * class index and resets it only after clearing <code>available</code>.
+   */
+  static bool IsUnregistered(const ServiceRegistrationBase& sr);
+
+  /**
+   * Lock the shards of the given classes, in the order of the shards.
+   */
+  std::vector<ClassShard::UniqueLock> LockClassShards(const std::vector<InterfaceIdTable::Id>& classIds);
+
+  /**
+   * Get the serviceRegistrations partition of <code>sr</code> for writing.
+   */
+  ServiceRegistrations& GetServiceRegistrations_unlocked(const ServiceRegistrationBase& sr);
+
+  /**
+   * The index of the serviceRegistrations list of <code>sr</code>.
+   */
+  std::size_t GetPartition(const ServiceRegistrationBase& sr) const;
+
+  /**
+   * Select the smallest candidate list which contains all services that
+   * may match <code>classId</code> and <code>ldap</code>, using the class
+   * and secondary property indexes.
+   *
+   * @param classId The interned class name, or InterfaceIdTable::EMPTY_ID
+   *        to match services of any class.
+   * @param merged Storage for candidates merged from several lists.
+   * @param checkClass Set to <code>true</code> if the candidates may
+   *        contain services not registered under <code>classId</code>.
+   * @return The candidates, or <code>nullptr</code> if no service can match.
+   */
+  const ServiceRegistrations* GetCandidates(LookupSnapshots& snaps, InterfaceIdTable::Id classId,
+                                            const LDAPExpr& ldap, ServiceRegistrations& merged,
+                                            bool& checkClass) const;
+
+  /**
+   * Validate <code>service</code> and create a registration object
+   * for it, without adding it to the registry.
+   *
+   * @param classes Receives the class names of the service.
+   */
+  ServiceRegistrationBase CreateServiceRegistration(BundlePrivate* bundle,
+                                                    const InterfaceMapConstPtr& service,
+                                                    const ServiceProperties& properties,
+                                                    std::vector<std::string>& classes);
+
+  /**
+   * Move <code>sr</code> to the position of its current ranking in its
+   * class lists. The caller must hold the shard locks of its classes,
+   * see LockClassShards.
+   */
+  void UpdateServiceRegistrationOrder_unlocked(const ServiceRegistrationBase& sr);
+
+  /**
+   * Add <code>sr</code> to services, serviceRegistrations and bundleServices.
+   */
+  void AddServiceRegistration_unlocked(const ServiceRegistrationBase& sr);
+
+  /**
+   * Replace the element at <code>pos</code> of the serviceRegistrations list
+   * of <code>sr</code> by an invalid ServiceRegistrationBase, keeping the
+   * registration order. The list is compacted when most of its elements
+   * are invalid.
+   */
+  void RemoveRegistration_unlocked(const ServiceRegistrationBase& sr, std::size_t pos);
+
+  /**
+   * Remove the element at <code>pos</code> from <code>regs</code> by moving
+   * the last element into its place, and update the position of the moved
+   * service.
+   *
+   * @param position The ServiceInfo member holding the positions in <code>regs</code>.
+   */
+  void RemoveAt_unlocked(ServiceRegistrations& regs, std::size_t pos,
+                         std::size_t ServiceInfo::* position);
+
+  void AddToPropertyIndexes_unlocked(const ServiceRegistrationBase& sr, const IndexedValues& values);
+
+  void RemoveFromPropertyIndexes_unlocked(const ServiceRegistrationBase& sr, const IndexedValues& values);
+
+  void UpdatePropertyIndexes_unlocked(const ServiceRegistrationBase& sr,
+                                      const IndexedValues& oldValues,
+                                      const IndexedValues& newValues);
+
+  /**
+   * Remove <code>sr</code> from the indexes guarded by the registry lock.
+   * The caller must call RemoveFromClassIndex after releasing the lock.
+   *
+   * @return <code>false</code> if <code>sr</code> was not registered.
+   */
+  bool RemoveServiceRegistration_unlocked(const ServiceRegistrationBase& sr);
+
+  /**
+   * Remove <code>sr</code> from the class index and record its
+   * unregistration, if it was added to the class index. This only
+   * takes the class shard locks.
+   */
+  void RemoveFromClassIndex(const ServiceRegistrationBase& sr);
+
+  /**
+   * Get the change counter for lookups of <code>classId</code>. This does
+   * not take any lock.
+   */
+  const ServiceLookupCache::Generation* GetGeneration(InterfaceIdTable::Id classId) const;
+
+  /**
+   * Record a change of <code>sr</code> in the change log and invalidate the
+   * cached lookup results which may contain <code>sr</code> or may now
+   * match it.
+   *
+   * This does not need the registry lock, but must be called after the
+   * class lists are updated.
+   *
+   * @param type The kind of change, as a service event type.
+   */
+  void ServiceChanged(const ServiceRegistrationBase& sr, ServiceEvent::Type type);
+
+  /**
+   * Invalidate the cached lookup results which may contain <code>sr</code>,
+   * without recording a change.
+   */
+  void InvalidateLookups(const ServiceRegistrationBase& sr);
+
+  /**
+   * Publish the current list of <code>classId</code> if it is the class
+   * of a hook type. The caller must hold the lock of <code>shard</code>.
+   */
+  void UpdateHooks_unlocked(const ClassShard& shard, InterfaceIdTable::Id classId);
 
 };
 
@@ -24,6 +24,7 @@
 
 #include "cppmicroservices/FrameworkEvent.h"
 
+#include "CoreBundleContext.h"
 #include "FrameworkPrivate.h"
 
 namespace cppmicroservices {
@@ -81,4 +82,14 @@ FrameworkEvent Framework::WaitForStop(const std::chrono::milliseconds& timeout)
   return pimpl(d)->WaitForStop(timeout);
 }
 
+std::vector<ListenerStatistics> Framework::GetListenerStatistics() const
+{
+  return d->coreCtx->listeners.GetListenerStatistics();
+}
+
+LDAPFilterCacheStatistics Framework::GetLDAPFilterCacheStatistics() const
+{
+  return d->coreCtx->ldapExprCache.GetStatistics();
+}
+
 }
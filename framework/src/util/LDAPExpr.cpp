@@ -25,14 +25,17 @@
 #include "cppmicroservices/Any.h"
 #include "cppmicroservices/Constants.h"
 
+#include "LDAPExprCache.h"
 #include "Properties.h"
 
+#include <algorithm>
 #include <cctype>
 #include <cerrno>
 #include <cmath>
 #include <cstdlib>
 #include <iterator>
 #include <limits>
+#include <list>
 #include <stdexcept>
 
 namespace cppmicroservices {
@@ -130,6 +133,331 @@ public:
 };
 
 
+namespace {
+
+/**
+ * The operand of a simple expression, converted once to the forms in
+ * which the property values of each type are compared.
+ */
+struct LDAPOperand
+{
+  LDAPOperand(int op, const std::string& attrName, const std::string& value);
+
+  int op;
+  std::string attrName;
+  std::string value;
+
+  //! The case-folded hash of attrName, for the property lookups
+  std::size_t attrHash;
+
+  //! Whether this is an EQ with a lone wildcard, which matches any value
+  bool any;
+
+  //! Whether the value contains a wildcard
+  bool wildcard;
+
+  //! The value parsed by strtol, for integral property values
+  bool isLong;
+  long longValue;
+
+  //! The value parsed by strtod, for floating point property values
+  bool isDouble;
+  double doubleValue;
+
+  //! Whether the boolean property values true and false match
+  bool matchesTrue;
+  bool matchesFalse;
+
+  //! The value in lower case and without white space, for APPROX
+  std::string approxValue;
+};
+
+/**
+ * An instruction of a compiled expression. TEST evaluates the operand
+ * with index \c arg, the jumps continue at the instruction with index
+ * \c arg depending on the current result.
+ */
+struct LDAPInstruction
+{
+  enum Code
+  {
+    TEST,
+    JUMP_IF_FALSE,
+    JUMP_IF_TRUE,
+    NOT,
+    CONSTANT
+  };
+
+  Code code;
+  std::size_t arg;
+};
+
+std::string FixupString(const std::string& s)
+{
+  std::string sb;
+  sb.reserve(s.size());
+  std::size_t len = s.length();
+  for(std::size_t i=0; i<len; i++)
+  {
+    char c = s.at(i);
+    if (!std::isspace(c))
+    {
+      if (std::isupper(c))
+        c = std::tolower(c);
+      sb.append(1, c);
+    }
+  }
+  return sb;
+}
+
+LDAPOperand::LDAPOperand(int op, const std::string& attrName, const std::string& value)
+  : op(op)
+  , attrName(attrName)
+  , value(value)
+  , attrHash(Properties::HashKey(attrName))
+  , any(op == LDAPExpr::EQ && value == LDAPExprConstants::WILDCARD_STRING())
+  , wildcard(value.find(LDAPExprConstants::WILDCARD()) != std::string::npos)
+  , isLong(false)
+  , longValue(0)
+  , isDouble(false)
+  , doubleValue(0)
+  , matchesTrue(value.size() <= 4 && std::equal(value.begin(), value.end(), "true", stricomp))
+  , matchesFalse(value.size() <= 5 && std::equal(value.begin(), value.end(), "false", stricomp))
+  , approxValue(FixupString(value))
+{
+  errno = 0;
+  char* endptr = nullptr;
+  longValue = strtol(value.c_str(), &endptr, 10);
+  isLong = !((errno == ERANGE && (longValue == std::numeric_limits<long>::max() || longValue == std::numeric_limits<long>::min())) ||
+             (errno != 0 && longValue == 0) || endptr == value.c_str());
+
+  errno = 0;
+  endptr = nullptr;
+  doubleValue = strtod(value.c_str(), &endptr);
+  isDouble = !((errno == ERANGE && (doubleValue == 0 || doubleValue == HUGE_VAL || doubleValue == -HUGE_VAL)) ||
+               (errno != 0 && doubleValue == 0) || endptr == value.c_str());
+}
+
+//! Compare a string with an operand, compared like std::string::compare
+int CompareChars(const char* s, std::size_t len, const std::string& value)
+{
+  const int result = std::char_traits<char>::compare(s, value.data(), std::min(len, value.size()));
+  if (result != 0)
+    return result;
+  return len < value.size() ? -1 : (len > value.size() ? 1 : 0);
+}
+
+//! Match a string with a pattern, in which WILDCARD matches any sequence of characters
+bool MatchPattern(const char* s, std::size_t len, const std::string& pat)
+{
+  const std::size_t patLen = pat.size();
+  std::size_t si = 0;
+  std::size_t pi = 0;
+  std::size_t starPi = std::string::npos;
+  std::size_t starSi = 0;
+  while (si < len)
+  {
+    if (pi < patLen && pat[pi] == LDAPExprConstants::WILDCARD())
+    {
+      starPi = pi++;
+      starSi = si;
+    }
+    else if (pi < patLen && pat[pi] == s[si])
+    {
+      ++pi;
+      ++si;
+    }
+    else if (starPi != std::string::npos)
+    {
+      // Let the last wildcard match one more character.
+      pi = starPi + 1;
+      si = ++starSi;
+    }
+    else
+    {
+      return false;
+    }
+  }
+  while (pi < patLen && pat[pi] == LDAPExprConstants::WILDCARD())
+  {
+    ++pi;
+  }
+  return pi == patLen;
+}
+
+//! Whether FixupString(s) equals the already fixed up value
+bool MatchApprox(const char* s, std::size_t len, const std::string& approxValue)
+{
+  std::size_t j = 0;
+  for (std::size_t i = 0; i < len; ++i)
+  {
+    char c = s[i];
+    if (!std::isspace(c))
+    {
+      if (std::isupper(c))
+        c = std::tolower(c);
+      if (j == approxValue.size() || approxValue[j] != c)
+        return false;
+      ++j;
+    }
+  }
+  return j == approxValue.size();
+}
+
+bool CompareString(const char* s, std::size_t len, const LDAPOperand& o)
+{
+  switch(o.op)
+  {
+  case LDAPExpr::LE:
+    return CompareChars(s, len, o.value) <= 0;
+  case LDAPExpr::GE:
+    return CompareChars(s, len, o.value) >= 0;
+  case LDAPExpr::EQ:
+    return o.wildcard ? MatchPattern(s, len, o.value) : CompareChars(s, len, o.value) == 0;
+  case LDAPExpr::APPROX:
+    return MatchApprox(s, len, o.approxValue);
+  default:
+    return false;
+  }
+}
+
+template<typename T>
+bool CompareIntegralType(T intVal, const LDAPOperand& o)
+{
+  if (!o.isLong)
+  {
+    return false;
+  }
+
+  T sInt = static_cast<T>(o.longValue);
+
+  switch(o.op)
+  {
+  case LDAPExpr::LE:
+    return intVal <= sInt;
+  case LDAPExpr::GE:
+    return intVal >= sInt;
+  default: /*APPROX and EQ*/
+    return intVal == sInt;
+  }
+}
+
+template<typename T>
+bool CompareFloatingPointType(double floatVal, const LDAPOperand& o)
+{
+  if (!o.isDouble)
+  {
+    return false;
+  }
+
+  switch(o.op)
+  {
+  case LDAPExpr::LE:
+    return floatVal <= o.doubleValue;
+  case LDAPExpr::GE:
+    return floatVal >= o.doubleValue;
+  default: /*APPROX and EQ*/
+    double diff = floatVal - o.doubleValue;
+    return (diff < std::numeric_limits<T>::epsilon()) && (diff > -std::numeric_limits<T>::epsilon());
+  }
+}
+
+bool Compare(const Any& obj, const LDAPOperand& o)
+{
+  if (obj.Empty())
+    return false;
+  if (o.any)
+    return true;
+
+  const std::type_info& objType = obj.Type();
+  if (objType == typeid(std::string))
+  {
+    const std::string& str = ref_any_cast<std::string>(obj);
+    return CompareString(str.data(), str.size(), o);
+  }
+  else if (objType == typeid(std::vector<std::string>))
+  {
+    for (auto& str : ref_any_cast<std::vector<std::string> >(obj))
+    {
+      if (CompareString(str.data(), str.size(), o))
+        return true;
+    }
+  }
+  else if (objType == typeid(std::list<std::string>))
+  {
+    for (auto& str : ref_any_cast<std::list<std::string> >(obj))
+    {
+      if (CompareString(str.data(), str.size(), o))
+        return true;
+    }
+  }
+  else if (objType == typeid(char))
+  {
+    return CompareString(&ref_any_cast<char>(obj), 1, o);
+  }
+  else if (objType == typeid(bool))
+  {
+    if (o.op == LDAPExpr::LE || o.op == LDAPExpr::GE)
+      return false;
+    return ref_any_cast<bool>(obj) ? o.matchesTrue : o.matchesFalse;
+  }
+  else if (objType == typeid(short))
+  {
+    return CompareIntegralType(ref_any_cast<short>(obj), o);
+  }
+  else if (objType == typeid(int))
+  {
+    return CompareIntegralType(ref_any_cast<int>(obj), o);
+  }
+  else if (objType == typeid(long int))
+  {
+    return CompareIntegralType(ref_any_cast<long int>(obj), o);
+  }
+  else if (objType == typeid(long long int))
+  {
+    return CompareIntegralType(ref_any_cast<long long int>(obj), o);
+  }
+  else if (objType == typeid(unsigned char))
+  {
+    return CompareIntegralType(ref_any_cast<unsigned char>(obj), o);
+  }
+  else if (objType == typeid(unsigned short))
+  {
+    return CompareIntegralType(ref_any_cast<unsigned short>(obj), o);
+  }
+  else if (objType == typeid(unsigned int))
+  {
+    return CompareIntegralType(ref_any_cast<unsigned int>(obj), o);
+  }
+  else if (objType == typeid(unsigned long int))
+  {
+    return CompareIntegralType(ref_any_cast<unsigned long int>(obj), o);
+  }
+  else if (objType == typeid(unsigned long long int))
+  {
+    return CompareIntegralType(ref_any_cast<unsigned long long int>(obj), o);
+  }
+  else if (objType == typeid(float))
+  {
+    return CompareFloatingPointType<float>(static_cast<double>(ref_any_cast<float>(obj)), o);
+  }
+  else if (objType == typeid(double))
+  {
+    return CompareFloatingPointType<double>(ref_any_cast<double>(obj), o);
+  }
+  else if (objType == typeid(std::vector<Any>))
+  {
+    for (auto& any : ref_any_cast<std::vector<Any> >(obj))
+    {
+      if (Compare(any, o))
+        return true;
+    }
+  }
+  return false;
+}
+
+}
+
 class LDAPExprData : public SharedData
 {
 public:
@@ -137,17 +465,45 @@ public:
   LDAPExprData( int op, const std::vector<LDAPExpr>& args )
     : m_operator(op), m_args(args), m_attrName(), m_attrValue()
   {
+    // Concatenate the operands' programs. Each operand of an AND or OR
+    // but the last is followed by a jump to the end, taken if the
+    // operand's result decides the result of the whole expression.
+    if (args.empty())
+    {
+      m_code.push_back({ LDAPInstruction::CONSTANT, op == LDAPExpr::AND ? 1u : 0u });
+    }
+    std::vector<std::size_t> jumps;
+    for (std::size_t i = 0; i < args.size(); ++i)
+    {
+      Append(*args[i].d);
+      if (op != LDAPExpr::NOT && i + 1 < args.size())
+      {
+        jumps.push_back(m_code.size());
+        m_code.push_back({ op == LDAPExpr::AND ? LDAPInstruction::JUMP_IF_FALSE : LDAPInstruction::JUMP_IF_TRUE, 0 });
+      }
+    }
+    if (op == LDAPExpr::NOT)
+    {
+      m_code.push_back({ LDAPInstruction::NOT, 0 });
+    }
+    for (auto jump : jumps)
+    {
+      m_code[jump].arg = m_code.size();
+    }
   }
 
   LDAPExprData( int op, std::string attrName, const std::string& attrValue )
     : m_operator(op), m_args(), m_attrName(attrName), m_attrValue(attrValue)
   {
+    m_operands.emplace_back(op, attrName, attrValue);
+    m_code.push_back({ LDAPInstruction::TEST, 0 });
   }
 
   LDAPExprData( const LDAPExprData& other )
     : SharedData(other), m_operator(other.m_operator),
     m_args(other.m_args), m_attrName(other.m_attrName),
-    m_attrValue(other.m_attrValue)
+    m_attrValue(other.m_attrValue), m_operands(other.m_operands),
+    m_code(other.m_code)
   {
   }
 
@@ -155,6 +511,31 @@ public:
   std::vector<LDAPExpr> m_args;
   std::string m_attrName;
   std::string m_attrValue;
+
+  //! The compiled expression, evaluated by LDAPExpr::Evaluate
+  std::vector<LDAPOperand> m_operands;
+  std::vector<LDAPInstruction> m_code;
+
+private:
+
+  void Append(const LDAPExprData& other)
+  {
+    const std::size_t operandOffset = m_operands.size();
+    const std::size_t codeOffset = m_code.size();
+    m_operands.insert(m_operands.end(), other.m_operands.begin(), other.m_operands.end());
+    for (auto instruction : other.m_code)
+    {
+      if (instruction.code == LDAPInstruction::TEST)
+      {
+        instruction.arg += operandOffset;
+      }
+      else if (instruction.code == LDAPInstruction::JUMP_IF_FALSE || instruction.code == LDAPInstruction::JUMP_IF_TRUE)
+      {
+        instruction.arg += codeOffset;
+      }
+      m_code.push_back(instruction);
+    }
+  }
 };
 
 LDAPExpr::LDAPExpr() : d()
@@ -214,14 +595,19 @@ std::string LDAPExpr::Trim(std::string str)
 }
 
 bool LDAPExpr::GetMatchedObjectClasses(ObjectClassSet& objClasses) const
+{
+  return GetMatchedValues(Constants::OBJECTCLASS, objClasses);
+}
+
+bool LDAPExpr::GetMatchedValues(const std::string& attrName, ValueSet& values) const
 {
   if (d->m_operator == EQ)
   {
-    if (d->m_attrName.length() == Constants::OBJECTCLASS.length() &&
-        std::equal(d->m_attrName.begin(), d->m_attrName.end(), Constants::OBJECTCLASS.begin(), stricomp) &&
+    if (d->m_attrName.length() == attrName.length() &&
+        std::equal(d->m_attrName.begin(), d->m_attrName.end(), attrName.begin(), stricomp) &&
         d->m_attrValue.find(LDAPExprConstants::WILDCARD()) == std::string::npos)
     {
-      objClasses.insert( d->m_attrValue );
+      values.insert( d->m_attrValue );
       return true;
     }
     return false;
@@ -229,58 +615,50 @@ bool LDAPExpr::GetMatchedObjectClasses(ObjectClassSet& objClasses) const
   else if (d->m_operator == AND)
   {
     bool result = false;
+    LDAPExpr::ValueSet matched;
     for (std::size_t i = 0; i < d->m_args.size( ); i++)
     {
-      LDAPExpr::ObjectClassSet r;
-      if (d->m_args[i].GetMatchedObjectClasses(r))
+      LDAPExpr::ValueSet r;
+      if (d->m_args[i].GetMatchedValues(attrName, r))
       {
-        result = true;
-        if (objClasses.empty())
+        if (!result)
         {
-          objClasses = r;
+          result = true;
+          matched.swap(r);
         }
         else
         {
-          // if AND op and classes in several operands,
+          // if AND op and values in several operands,
           // then only the intersection is possible.
-          LDAPExpr::ObjectClassSet::iterator it1 = objClasses.begin();
-          LDAPExpr::ObjectClassSet::iterator it2 = r.begin();
-          while ( (it1 != objClasses.end()) && (it2 != r.end()) )
+          for (auto it = matched.begin(); it != matched.end(); )
           {
-            if (*it1 < *it2)
-            {
-              objClasses.erase(it1++);
-            }
-            else if (*it2 < *it1)
+            if (r.count(*it) == 0)
             {
-              ++it2;
+              it = matched.erase(it);
             }
             else
-            { // *it1 == *it2
-              ++it1;
-              ++it2;
+            {
+              ++it;
             }
           }
-          // Anything left in set_1 from here on did not appear in set_2,
-          // so we remove it.
-          objClasses.erase(it1, objClasses.end());
         }
       }
     }
+    values.insert(matched.begin(), matched.end());
     return result;
   }
   else if (d->m_operator == OR)
   {
     for (std::size_t i = 0; i < d->m_args.size( ); i++)
     {
-      LDAPExpr::ObjectClassSet r;
-      if (d->m_args[i].GetMatchedObjectClasses(r))
+      LDAPExpr::ValueSet r;
+      if (d->m_args[i].GetMatchedValues(attrName, r))
       {
-        std::copy(r.begin(), r.end(), std::inserter(objClasses, objClasses.begin()));
+        std::copy(r.begin(), r.end(), std::inserter(values, values.begin()));
       }
       else
       {
-        objClasses.clear();
+        values.clear();
         return false;
       }
     }
@@ -310,7 +688,7 @@ bool LDAPExpr::IsSimple(const StringList& keywords, LocalCache& cache,
     if ((index = std::find(keywords.begin(), keywords.end(), matchCase ? d->m_attrName : ToLower(d->m_attrName))) != keywords.end() &&
         d->m_attrValue.find_first_of(LDAPExprConstants::WILDCARD()) == std::string::npos)
     {
-      cache[index - keywords.begin()] = StringList(1, d->m_attrValue);
+      cache[index - keywords.begin()].push_back(d->m_attrValue);
       return true;
     }
   }
@@ -333,285 +711,69 @@ bool LDAPExpr::IsNull() const
 
 bool LDAPExpr::Query( const std::string& filter, const PropertiesHandle& pd)
 {
-  return LDAPExpr(filter).Evaluate(pd, false);
+  return LDAPExprCache::Instance().Get(filter).Evaluate(pd, false);
 }
 
 bool LDAPExpr::Evaluate( const PropertiesHandle& p, bool matchCase ) const
 {
-  if ((d->m_operator & SIMPLE) != 0)
-  {
-    // try case sensitive match first
-    int index = p->FindCaseSensitive_unlocked(d->m_attrName);
-    if (index < 0 && !matchCase) index = p->Find_unlocked(d->m_attrName);
-    return index < 0 ? false : Compare(p->Value_unlocked(index), d->m_operator, d->m_attrValue);
-  }
-  else
-  { // (d->m_operator & COMPLEX) != 0
-    switch (d->m_operator)
-    {
-    case AND:
-      for (std::size_t i = 0; i < d->m_args.size(); i++)
-      {
-        if (!d->m_args[i].Evaluate(p, matchCase))
-          return false;
-      }
-      return true;
-    case OR:
-      for (std::size_t i = 0; i < d->m_args.size(); i++)
-      {
-        if (d->m_args[i].Evaluate(p, matchCase))
-          return true;
-      }
-      return false;
-    case NOT:
-      return !d->m_args[0].Evaluate(p, matchCase);
-    default:
-      return false; // Cannot happen
-    }
-  }
-}
-
-bool LDAPExpr::Compare( const Any& obj, int op, const std::string& s ) const
-{
-  if (obj.Empty())
-    return false;
-  if (op == EQ && s == LDAPExprConstants::WILDCARD_STRING())
-    return true;
-
-  try
+  const std::vector<LDAPOperand>& operands = d->m_operands;
+  const std::vector<LDAPInstruction>& code = d->m_code;
+  bool result = false;
+  std::size_t pc = 0;
+  while (pc < code.size())
   {
-    const std::type_info& objType = obj.Type();
-    if (objType == typeid(std::string))
-    {
-      return CompareString(ref_any_cast<std::string>(obj), op, s);
-    }
-    else if (objType == typeid(std::vector<std::string>))
-    {
-      const std::vector<std::string>& list = ref_any_cast<std::vector<std::string> >(obj);
-      for (std::size_t it = 0; it != list.size(); it++)
-      {
-         if (CompareString(list[it], op, s))
-           return true;
-      }
-    }
-    else if (objType == typeid(std::list<std::string>))
-    {
-      const std::list<std::string>& list = ref_any_cast<std::list<std::string> >(obj);
-      for (std::list<std::string>::const_iterator it = list.begin();
-           it != list.end(); ++it)
-      {
-         if (CompareString(*it, op, s))
-           return true;
-      }
-    }
-    else if (objType == typeid(char))
-    {
-      return CompareString(std::string(1, ref_any_cast<char>(obj)), op, s);
-    }
-    else if (objType == typeid(bool))
-    {
-      if (op==LE || op==GE)
-        return false;
-
-      std::string boolVal = any_cast<bool>(obj) ? "true" : "false";
-      return std::equal(s.begin(), s.end(), boolVal.begin(), stricomp);
-    }
-    else if (objType == typeid(short))
-    {
-      return CompareIntegralType<short>(obj, op, s);
-    }
-    else if (objType == typeid(int))
-    {
-      return CompareIntegralType<int>(obj, op, s);
-    }
-    else if (objType == typeid(long int))
-    {
-      return CompareIntegralType<long int>(obj, op, s);
-    }
-    else if (objType == typeid(long long int))
-    {
-      return CompareIntegralType<long long int>(obj, op, s);
-    }
-    else if (objType == typeid(unsigned char))
-    {
-      return CompareIntegralType<unsigned char>(obj, op, s);
-    }
-    else if (objType == typeid(unsigned short))
-    {
-      return CompareIntegralType<unsigned short>(obj, op, s);
-    }
-    else if (objType == typeid(unsigned int))
-    {
-      return CompareIntegralType<unsigned int>(obj, op, s);
-    }
-    else if (objType == typeid(unsigned long int))
-    {
-      return CompareIntegralType<unsigned long int>(obj, op, s);
-    }
-    else if (objType == typeid(unsigned long long int))
+    const LDAPInstruction& instruction = code[pc++];
+    switch (instruction.code)
     {
-      return CompareIntegralType<unsigned long long int>(obj, op, s);
-    }
-    else if (objType == typeid(float))
-    {
-      errno = 0;
-      char* endptr = nullptr;
-      double sFloat = strtod(s.c_str(), &endptr);
-      if ((errno == ERANGE && (sFloat == 0 || sFloat == HUGE_VAL || sFloat == -HUGE_VAL)) ||
-          (errno != 0 && sFloat == 0) || endptr == s.c_str())
-      {
-        return false;
-      }
-
-      double floatVal = static_cast<double>(any_cast<float>(obj));
-
-      switch(op)
-      {
-      case LE:
-        return floatVal <= sFloat;
-      case GE:
-        return floatVal >= sFloat;
-      default: /*APPROX and EQ*/
-        double diff = floatVal - sFloat;
-        return (diff < std::numeric_limits<float>::epsilon()) && (diff > -std::numeric_limits<float>::epsilon());
-      }
-    }
-    else if (objType == typeid(double))
+    case LDAPInstruction::TEST:
     {
-      errno = 0;
-      char* endptr = nullptr;
-      double sDouble = strtod(s.c_str(), &endptr);
-      if ((errno == ERANGE && (sDouble == 0 || sDouble == HUGE_VAL || sDouble == -HUGE_VAL)) ||
-          (errno != 0 && sDouble == 0) || endptr == s.c_str())
-      {
-        return false;
-      }
-
-      double doubleVal = any_cast<double>(obj);
-
-      switch(op)
-      {
-      case LE:
-        return doubleVal <= sDouble;
-      case GE:
-        return doubleVal >= sDouble;
-      default: /*APPROX and EQ*/
-        double diff = doubleVal - sDouble;
-        return (diff < std::numeric_limits<double>::epsilon()) && (diff > -std::numeric_limits<double>::epsilon());
-      }
+      const LDAPOperand& operand = operands[instruction.arg];
+      // try case sensitive match first
+      int index = p->FindCaseSensitive_unlocked(operand.attrName, operand.attrHash);
+      if (index < 0 && !matchCase) index = p->Find_unlocked(operand.attrName, operand.attrHash);
+      result = index < 0 ? false : Compare(p->Value_unlocked(index), operand);
+      break;
     }
-    else if (objType == typeid(std::vector<Any>))
-    {
-      const std::vector<Any>& list = ref_any_cast<std::vector<Any> >(obj);
-      for (std::size_t it = 0; it != list.size(); it++)
-      {
-         if (Compare(list[it], op, s))
-           return true;
-      }
+    case LDAPInstruction::JUMP_IF_FALSE:
+      if (!result) pc = instruction.arg;
+      break;
+    case LDAPInstruction::JUMP_IF_TRUE:
+      if (result) pc = instruction.arg;
+      break;
+    case LDAPInstruction::NOT:
+      result = !result;
+      break;
+    case LDAPInstruction::CONSTANT:
+      result = instruction.arg != 0;
+      break;
     }
   }
-  catch (...)
-  {
-    // This might happen if a std::string-to-datatype conversion fails
-    // Just consider it a false match and ignore the exception
-  }
-  return false;
+  return result;
 }
 
-template<typename T>
-bool LDAPExpr::CompareIntegralType(const Any& obj, const int op, const std::string& s) const
+int LDAPExpr::GetOperator() const
 {
-  errno = 0;
-  char* endptr = nullptr;
-  long longInt = strtol(s.c_str(), &endptr, 10);
-  if ((errno == ERANGE && (longInt == std::numeric_limits<long>::max() || longInt == std::numeric_limits<long>::min())) ||
-       (errno != 0 && longInt == 0) || endptr == s.c_str())
-  {
-    return false;
-  }
-
-  T sInt = static_cast<T>(longInt);
-  T intVal = any_cast<T>(obj);
-
-  switch(op)
-  {
-  case LE:
-    return intVal <= sInt;
-  case GE:
-    return intVal >= sInt;
-  default: /*APPROX and EQ*/
-    return intVal == sInt;
-  }
+  return d->m_operator;
 }
 
-bool LDAPExpr::CompareString( const std::string& s1, int op, const std::string& s2 )
+const std::vector<LDAPExpr>& LDAPExpr::GetArgs() const
 {
-  switch(op)
-  {
-  case LE:
-    return s1.compare(s2) <= 0;
-  case GE:
-    return s1.compare(s2) >= 0;
-  case EQ:
-    return PatSubstr(s1,s2);
-  case APPROX:
-    return FixupString(s2) == FixupString(s1);
-  default:
-    return false;
-  }
+  return d->m_args;
 }
 
-std::string LDAPExpr::FixupString( const std::string& s )
+const std::string& LDAPExpr::GetAttrName() const
 {
-  std::string sb;
-  sb.reserve(s.size());
-  std::size_t len = s.length();
-  for(std::size_t i=0; i<len; i++)
-  {
-    char c = s.at(i);
-    if (!std::isspace(c))
-    {
-      if (std::isupper(c))
-        c = std::tolower(c);
-      sb.append(1, c);
-    }
-  }
-  return sb;
+  return d->m_attrName;
 }
 
-bool LDAPExpr::PatSubstr( const std::string& s, int si, const std::string& pat, int pi )
+const std::string& LDAPExpr::GetAttrValue() const
 {
-  if (pat.size()-pi == 0)
-    return s.size()-si == 0;
-  if (pat[pi] == LDAPExprConstants::WILDCARD())
-  {
-    pi++;
-    for (;;)
-    {
-      if (PatSubstr(s, si, pat, pi))
-        return true;
-      if (s.size()-si == 0)
-        return false;
-      si++;
-    }
-  }
-  else
-  {
-    if (s.size()-si == 0)
-    {
-      return false;
-    }
-    if(s[si] != pat[pi])
-    {
-      return false;
-    }
-    return PatSubstr(s, ++si, pat, ++pi);
-  }
+  return d->m_attrValue;
 }
 
-bool LDAPExpr::PatSubstr( const std::string& s, const std::string& pat )
+bool LDAPExpr::EvaluateValue(const Any& value) const
 {
-  return PatSubstr(s, 0, pat, 0);
+  return Compare(value, d->m_operands.front());
 }
 
 LDAPExpr LDAPExpr::ParseExpr( ParseState& ps )
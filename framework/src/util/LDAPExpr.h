@@ -57,7 +57,8 @@ public:
   typedef char Byte;
   typedef std::vector<std::string> StringList;
   typedef std::vector<StringList> LocalCache;
-  typedef std::unordered_set<std::string> ObjectClassSet;
+  typedef std::unordered_set<std::string> ValueSet;
+  typedef ValueSet ObjectClassSet;
 
 
   /**
@@ -84,6 +85,17 @@ public:
    */
   bool GetMatchedObjectClasses(ObjectClassSet& objClasses) const;
 
+  /**
+   * Get the set of values an attribute must be equal to for this LDAP expression
+   * to match. This will not work with wildcards and NOT expressions. If a set can
+   * not be determined return <code>false</code>.
+   *
+   * \param attrName The attribute name, compared case-insensitively.
+   * \param values The set of matched values will be added to values.
+   * \return If the set cannot be determined, <code>false</code> is returned, <code>true</code> otherwise.
+   */
+  bool GetMatchedValues(const std::string& attrName, ValueSet& values) const;
+
   /**
    * Checks if this LDAP expression is "simple". The definition of
    * a simple filter is:
@@ -126,6 +138,24 @@ public:
   //! Evaluate this LDAP filter.
   bool Evaluate(const PropertiesHandle& p, bool matchCase) const;
 
+  //! The operator of this expression, one of the constants above.
+  int GetOperator() const;
+
+  //! The operands of an AND, OR or NOT expression.
+  const std::vector<LDAPExpr>& GetArgs() const;
+
+  //! The attribute name of a simple expression.
+  const std::string& GetAttrName() const;
+
+  //! The attribute value of a simple expression.
+  const std::string& GetAttrValue() const;
+
+  /**
+   * Evaluate a simple expression against the value of its attribute,
+   * which is empty if the attribute is not set.
+   */
+  bool EvaluateValue(const Any& value) const;
+
   //!
   const std::string ToString() const;
 
@@ -150,24 +180,7 @@ private:
 
   static std::string ToLower(const std::string& str);
 
-  //!
-  bool Compare(const Any& obj, int op, const std::string& s) const;
-
-  //!
-  template<typename T>
-  bool CompareIntegralType(const Any& obj, const int op, const std::string& s) const;
-
-  //!
-  static bool CompareString(const std::string& s1, int op, const std::string& s2);
-
-  //!
-  static std::string FixupString(const std::string &s);
-
-  //!
-  static bool PatSubstr(const std::string& s, const std::string& pat);
-
-  //!
-  static bool PatSubstr(const std::string& s, int si, const std::string& pat, int pi);
+  friend class LDAPExprData;
 
   //! Shared pointer
   SharedDataPointer<LDAPExprData> d;
@@ -0,0 +1,70 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#include "LDAPExprCache.h"
+
+namespace cppmicroservices {
+
+LDAPExprCache& LDAPExprCache::Instance()
+{
+  static LDAPExprCache cache(DEFAULT_CAPACITY);
+  return cache;
+}
+
+LDAPExprCache::LDAPExprCache(std::size_t capacity)
+  : cache(capacity)
+{
+}
+
+LDAPExpr LDAPExprCache::Get(const std::string& filter)
+{
+  LDAPExpr expr;
+  if (cache.Find(filter, [&expr](const LDAPExpr& cached) { expr = cached; return true; }))
+  {
+    return expr;
+  }
+
+  // Parse without holding the shard lock. This throws for invalid filters.
+  expr = LDAPExpr(filter);
+  // Another thread may have parsed the same filter concurrently; share its result.
+  cache.Insert(filter, expr, [&expr](const LDAPExpr& cached) { expr = cached; });
+  return expr;
+}
+
+LDAPFilterCacheStatistics LDAPExprCache::GetStatistics() const
+{
+  const auto cacheStats = cache.GetStatistics();
+  LDAPFilterCacheStatistics stats;
+  stats.hits = cacheStats.hits;
+  stats.misses = cacheStats.misses;
+  stats.evictions = cacheStats.evictions;
+  stats.size = cacheStats.size;
+  stats.capacity = cacheStats.capacity;
+  return stats;
+}
+
+void LDAPExprCache::Clear()
+{
+  cache.Clear();
+}
+
+}
@@ -0,0 +1,91 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+#ifndef CPPMICROSERVICES_LDAPEXPRCACHE_H
+#define CPPMICROSERVICES_LDAPEXPRCACHE_H
+
+#include "cppmicroservices/LDAPFilterCacheStatistics.h"
+
+#include "LDAPExpr.h"
+#include "ShardedLruCache.h"
+
+#include <string>
+
+namespace cppmicroservices {
+
+/**
+ * A bounded, thread-safe cache of parsed LDAP expressions keyed by
+ * their filter string.
+ *
+ * Parsed expressions are immutable and implicitly shared, so all users
+ * of the same filter string (service lookups, service listeners and
+ * LDAPFilter objects) share a single expression tree. The least recently
+ * used expressions are evicted, see ShardedLruCache. A cache with a
+ * capacity of zero parses every filter.
+ *
+ * Each framework has its own cache for its service lookups and service
+ * listeners. LDAPFilter objects, which are not tied to a framework, use
+ * the process-wide instance.
+ *
+ * This class is not part of the public API.
+ */
+class LDAPExprCache
+{
+
+public:
+
+  static const std::size_t DEFAULT_CAPACITY = 1024;
+
+  /**
+   * The process-wide cache used by LDAPFilter objects.
+   */
+  static LDAPExprCache& Instance();
+
+  explicit LDAPExprCache(std::size_t capacity);
+
+  LDAPExprCache(const LDAPExprCache&) = delete;
+  LDAPExprCache& operator=(const LDAPExprCache&) = delete;
+
+  /**
+   * Get the parsed expression for <code>filter</code>, parsing and
+   * caching it if necessary.
+   *
+   * @param filter A non-empty LDAP filter string.
+   * @return The parsed expression.
+   * @throws std::invalid_argument if <code>filter</code> is not a
+   *         valid LDAP filter string. Invalid filters are not cached.
+   */
+  LDAPExpr Get(const std::string& filter);
+
+  LDAPFilterCacheStatistics GetStatistics() const;
+
+  void Clear();
+
+private:
+
+  ShardedLruCache<LDAPExpr> cache;
+};
+
+}
+
+#endif // CPPMICROSERVICES_LDAPEXPRCACHE_H
@@ -0,0 +1,138 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#include "LDAPExprNetwork.h"
+
+#include "Properties.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace cppmicroservices {
+
+LDAPExprNetwork::Evaluation::Evaluation(const LDAPExprNetwork& network, const PropertiesHandle& props)
+  : network(network)
+  , props(props)
+  , results(network.nodes.size(), 0)
+  , values(network.attributes.size(), nullptr)
+{
+}
+
+bool LDAPExprNetwork::Evaluation::Evaluate(std::size_t node)
+{
+  if (results[node] == 0)
+  {
+    const Node& n = network.nodes[node];
+    bool result = false;
+    switch (n.op)
+    {
+    case LDAPExpr::AND:
+      result = std::all_of(n.args.begin(), n.args.end(), [this](std::size_t arg) { return Evaluate(arg); });
+      break;
+    case LDAPExpr::OR:
+      result = std::any_of(n.args.begin(), n.args.end(), [this](std::size_t arg) { return Evaluate(arg); });
+      break;
+    case LDAPExpr::NOT:
+      result = !Evaluate(n.args.front());
+      break;
+    default:
+      result = n.expr.EvaluateValue(GetValue(n.attribute));
+      break;
+    }
+    results[node] = result ? 2 : 1;
+  }
+  return results[node] == 2;
+}
+
+const Any& LDAPExprNetwork::Evaluation::GetValue(std::size_t attribute)
+{
+  if (values[attribute] == nullptr)
+  {
+    // Property keys are unique regardless of case, so a case-insensitive
+    // look-up finds the same value as LDAPExpr::Evaluate.
+    values[attribute] = &props->Value_unlocked(network.attributes[attribute]);
+  }
+  return *values[attribute];
+}
+
+std::size_t LDAPExprNetwork::Add(const LDAPExpr& expr)
+{
+  Node node;
+  node.op = expr.GetOperator();
+  node.attribute = 0;
+
+  std::string key = std::to_string(node.op);
+  if ((node.op & LDAPExpr::SIMPLE) != 0)
+  {
+    std::string attrName = expr.GetAttrName();
+    std::transform(attrName.begin(), attrName.end(), attrName.begin(), ::tolower);
+
+    auto iter = attributeIndexes.find(attrName);
+    if (iter == attributeIndexes.end())
+    {
+      iter = attributeIndexes.insert(std::make_pair(attrName, attributes.size())).first;
+      attributes.push_back(attrName);
+    }
+    node.expr = expr;
+    node.attribute = iter->second;
+
+    key.append(1, '\0').append(attrName).append(1, '\0').append(expr.GetAttrValue());
+  }
+  else
+  {
+    for (auto& arg : expr.GetArgs())
+    {
+      node.args.push_back(Add(arg));
+    }
+    // Predicates have no side effects, so the operands of AND and OR
+    // can be ordered to share permuted combinations as well.
+    if (node.op != LDAPExpr::NOT)
+    {
+      std::sort(node.args.begin(), node.args.end());
+      node.args.erase(std::unique(node.args.begin(), node.args.end()), node.args.end());
+    }
+    for (auto arg : node.args)
+    {
+      key.append(1, ',').append(std::to_string(arg));
+    }
+  }
+  return AddNode(key, node);
+}
+
+std::size_t LDAPExprNetwork::GetNodeCount() const
+{
+  return nodes.size();
+}
+
+std::size_t LDAPExprNetwork::AddNode(const std::string& key, const Node& node)
+{
+  auto iter = nodeIndexes.find(key);
+  if (iter != nodeIndexes.end())
+  {
+    return iter->second;
+  }
+  nodeIndexes.insert(std::make_pair(key, nodes.size()));
+  nodes.push_back(node);
+  return nodes.size() - 1;
+}
+
+}
@@ -0,0 +1,115 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#ifndef CPPMICROSERVICES_LDAPEXPRNETWORK_H
+#define CPPMICROSERVICES_LDAPEXPRNETWORK_H
+
+#include "cppmicroservices/Any.h"
+
+#include "LDAPExpr.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cppmicroservices {
+
+class PropertiesHandle;
+
+/**
+ * A network of LDAP expressions sharing their common sub-expressions.
+ *
+ * Each distinct atomic predicate (attribute, operator, value) and each
+ * distinct AND, OR or NOT combination is a single node, no matter how
+ * many of the added expressions contain it. An Evaluation computes a
+ * node at most once, so matching many filters against the same
+ * properties costs one evaluation per distinct predicate instead of one
+ * per filter.
+ *
+ * This class is not part of the public API.
+ */
+class LDAPExprNetwork
+{
+
+public:
+
+  /**
+   * Evaluates the nodes of a network against one set of properties,
+   * remembering the result of every evaluated node.
+   */
+  class Evaluation
+  {
+
+  public:
+
+    Evaluation(const LDAPExprNetwork& network, const PropertiesHandle& props);
+
+    bool Evaluate(std::size_t node);
+
+  private:
+
+    const Any& GetValue(std::size_t attribute);
+
+    const LDAPExprNetwork& network;
+    const PropertiesHandle& props;
+
+    // 0 if not evaluated yet, otherwise 1 + the result
+    std::vector<char> results;
+    // the looked up property values, or nullptr if not looked up yet
+    std::vector<const Any*> values;
+  };
+
+  /**
+   * Adds an expression to the network.
+   *
+   * @param expr A valid LDAP expression.
+   * @return The node evaluating the expression.
+   */
+  std::size_t Add(const LDAPExpr& expr);
+
+  std::size_t GetNodeCount() const;
+
+private:
+
+  struct Node
+  {
+    int op;
+    // The predicate and the index of its attribute, for simple expressions
+    LDAPExpr expr;
+    std::size_t attribute;
+    // The operand nodes, for complex expressions
+    std::vector<std::size_t> args;
+  };
+
+  std::size_t AddNode(const std::string& key, const Node& node);
+
+  std::vector<Node> nodes;
+  std::unordered_map<std::string, std::size_t> nodeIndexes;
+
+  // lower-case attribute names
+  std::vector<std::string> attributes;
+  std::unordered_map<std::string, std::size_t> attributeIndexes;
+};
+
+}
+
+#endif // CPPMICROSERVICES_LDAPEXPRNETWORK_H
@@ -26,6 +26,7 @@
 #include "cppmicroservices/ServiceReference.h"
 
 #include "LDAPExpr.h"
+#include "LDAPExprCache.h"
 #include "Properties.h"
 #include "ServiceReferenceBasePrivate.h"
 
@@ -41,7 +42,7 @@ public:
   {}
 
   LDAPFilterData(const std::string& filter)
-    : ldapExpr(filter)
+    : ldapExpr(LDAPExprCache::Instance().Get(filter))
   {}
 
   LDAPFilterData(const LDAPFilterData& other)
@@ -22,18 +22,79 @@
 
 #include "Properties.h"
 
+#include <algorithm>
+#include <cctype>
 #include <limits>
+#include <list>
 #include <stdexcept>
-#ifdef US_PLATFORM_WINDOWS
-#include <string.h>
-#define ci_compare strnicmp
-#else
-#include <strings.h>
-#define ci_compare strncasecmp
-#endif
 
 namespace cppmicroservices {
 
+namespace {
+
+template<class T>
+bool ValuesEqual(const Any& a, const Any& b)
+{
+  return ref_any_cast<T>(a) == ref_any_cast<T>(b);
+}
+
+bool ValuesEqual(const Any& a, const Any& b)
+{
+  const std::type_info& type = a.Type();
+  if (type != b.Type()) return false;
+
+  if (type == typeid(std::string)) return ValuesEqual<std::string>(a, b);
+  if (type == typeid(std::vector<std::string>)) return ValuesEqual<std::vector<std::string> >(a, b);
+  if (type == typeid(std::list<std::string>)) return ValuesEqual<std::list<std::string> >(a, b);
+  if (type == typeid(char)) return ValuesEqual<char>(a, b);
+  if (type == typeid(bool)) return ValuesEqual<bool>(a, b);
+  if (type == typeid(short)) return ValuesEqual<short>(a, b);
+  if (type == typeid(int)) return ValuesEqual<int>(a, b);
+  if (type == typeid(long int)) return ValuesEqual<long int>(a, b);
+  if (type == typeid(long long int)) return ValuesEqual<long long int>(a, b);
+  if (type == typeid(unsigned char)) return ValuesEqual<unsigned char>(a, b);
+  if (type == typeid(unsigned short)) return ValuesEqual<unsigned short>(a, b);
+  if (type == typeid(unsigned int)) return ValuesEqual<unsigned int>(a, b);
+  if (type == typeid(unsigned long int)) return ValuesEqual<unsigned long int>(a, b);
+  if (type == typeid(unsigned long long int)) return ValuesEqual<unsigned long long int>(a, b);
+  if (type == typeid(float)) return ValuesEqual<float>(a, b);
+  if (type == typeid(double)) return ValuesEqual<double>(a, b);
+  if (type == typeid(std::vector<Any>))
+  {
+    const std::vector<Any>& list1 = ref_any_cast<std::vector<Any> >(a);
+    const std::vector<Any>& list2 = ref_any_cast<std::vector<Any> >(b);
+    return list1.size() == list2.size() &&
+           std::equal(list1.begin(), list1.end(), list2.begin(),
+                      [](const Any& v1, const Any& v2) { return ValuesEqual(v1, v2); });
+  }
+  return false;
+}
+
+std::string ToLower(std::string str)
+{
+  std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+  return str;
+}
+
+inline unsigned char FoldCase(char c)
+{
+  const unsigned char uc = static_cast<unsigned char>(c);
+  return (uc >= 'A' && uc <= 'Z') ? static_cast<unsigned char>(uc + ('a' - 'A')) : uc;
+}
+
+bool EqualsIgnoreCase(const std::string& a, const std::string& b)
+{
+  if (a.size() != b.size()) return false;
+  for (std::size_t i = 0; i < a.size(); ++i)
+  {
+    if (a[i] != b[i] && FoldCase(a[i]) != FoldCase(b[i])) return false;
+  }
+  return true;
+}
+
+
+}
+
 const Any Properties::emptyAny;
 
 Properties::Properties(const AnyMap& p)
@@ -43,25 +104,38 @@ Properties::Properties(const AnyMap& p)
     throw std::runtime_error("Properties contain too many keys");
   }
 
+  auto newValues = std::make_shared<std::vector<Any>>();
   keys.reserve(p.size());
-  values.reserve(p.size());
+  newValues->reserve(p.size());
+  hashes.reserve(p.size());
+
+  std::size_t slots = 8;
+  while (slots < 2 * p.size()) slots *= 2;
+  index.assign(p.size() ? slots : 0, -1);
 
   for (auto& iter : p)
   {
-    if (Find_unlocked(iter.first) > -1)
+    const std::size_t hash = HashKey(iter.first);
+    const std::size_t slot = Probe_unlocked(iter.first, hash, false);
+    if (index[slot] > -1)
     {
       std::string msg("Properties contain case variants of the key: ");
       msg += iter.first;
       throw std::runtime_error(msg.c_str());
     }
+    index[slot] = static_cast<int>(keys.size());
     keys.push_back(iter.first);
-    values.push_back(iter.second);
+    newValues->push_back(iter.second);
+    hashes.push_back(hash);
   }
+  values = std::move(newValues);
 }
 
 Properties::Properties(Properties&& o)
   : keys(std::move(o.keys))
   , values(std::move(o.values))
+  , hashes(std::move(o.hashes))
+  , index(std::move(o.index))
 {
 }
 
@@ -69,50 +143,83 @@ Properties& Properties::operator=(Properties&& o)
 {
   keys = std::move(o.keys);
   values = std::move(o.values);
+  hashes = std::move(o.hashes);
+  index = std::move(o.index);
   return *this;
 }
 
-Any Properties::Value_unlocked(const std::string& key) const
+const Any& Properties::Value_unlocked(const std::string& key) const
 {
-  int i = Find_unlocked(key);
-  if (i < 0)
+  return Value_unlocked(Find_unlocked(key));
+}
+
+const Any& Properties::Value_unlocked(int index) const
+{
+  if (index < 0 || static_cast<std::size_t>(index) >= keys.size())
   {
     return emptyAny;
   }
-  return values[i];
+  return (*values)[static_cast<std::size_t>(index)];
 }
 
-Any Properties::Value_unlocked(int index) const
+std::shared_ptr<const Any> Properties::SharedValue_unlocked(const std::string& key) const
 {
-  if (index < 0 || static_cast<std::size_t>(index) >= values.size())
+  const int i = Find_unlocked(key);
+  if (i < 0)
   {
-    return emptyAny;
+    return std::shared_ptr<const Any>(std::shared_ptr<const Any>(), &emptyAny);
   }
-  return values[static_cast<std::size_t>(index)];
+  return std::shared_ptr<const Any>(values, &(*values)[static_cast<std::size_t>(i)]);
 }
 
-int Properties::Find_unlocked(const std::string& key) const
+std::size_t Properties::Probe_unlocked(const std::string& key, std::size_t hash, bool caseSensitive) const
 {
-  for (std::size_t i = 0; i < keys.size(); ++i)
+  const std::size_t mask = index.size() - 1;
+  for (std::size_t slot = hash & mask; ; slot = (slot + 1) & mask)
   {
-    if (ci_compare(key.c_str(), keys[i].c_str(), key.size()) == 0)
+    const int i = index[slot];
+    if (i < 0) return slot;
+    const std::size_t pos = static_cast<std::size_t>(i);
+    if (hashes[pos] == hash &&
+        (caseSensitive ? keys[pos] == key : EqualsIgnoreCase(keys[pos], key)))
     {
-      return static_cast<int>(i);
+      return slot;
     }
   }
-  return -1;
 }
 
-int Properties::FindCaseSensitive_unlocked(const std::string& key) const
+std::size_t Properties::HashKey(const std::string& key)
 {
-  for (std::size_t i = 0; i < keys.size(); ++i)
+  // FNV-1a over the lower-cased characters of the key
+  std::size_t hash = static_cast<std::size_t>(14695981039346656037ULL);
+  for (char c : key)
   {
-    if (key == keys[i])
-    {
-      return static_cast<int>(i);
-    }
+    hash ^= FoldCase(c);
+    hash *= static_cast<std::size_t>(1099511628211ULL);
   }
-  return -1;
+  return hash;
+}
+
+int Properties::Find_unlocked(const std::string& key) const
+{
+  return Find_unlocked(key, HashKey(key));
+}
+
+int Properties::FindCaseSensitive_unlocked(const std::string& key) const
+{
+  return FindCaseSensitive_unlocked(key, HashKey(key));
+}
+
+int Properties::Find_unlocked(const std::string& key, std::size_t hash) const
+{
+  if (index.empty()) return -1;
+  return index[Probe_unlocked(key, hash, false)];
+}
+
+int Properties::FindCaseSensitive_unlocked(const std::string& key, std::size_t hash) const
+{
+  if (index.empty()) return -1;
+  return index[Probe_unlocked(key, hash, true)];
 }
 
 std::vector<std::string> Properties::Keys_unlocked() const
@@ -120,10 +227,43 @@ std::vector<std::string> Properties::Keys_unlocked() const
   return keys;
 }
 
+std::vector<std::string> Properties::GetChangedKeys_unlocked(const Properties& other) const
+{
+  std::vector<bool> matched(other.keys.size(), false);
+
+  std::vector<std::string> changed;
+  for (std::size_t i = 0; i < keys.size(); ++i)
+  {
+    const int j = other.index.empty() ? -1 : other.index[other.Probe_unlocked(keys[i], hashes[i], false)];
+    if (j < 0)
+    {
+      changed.push_back(ToLower(keys[i]));
+    }
+    else
+    {
+      if (!ValuesEqual((*values)[i], (*other.values)[static_cast<std::size_t>(j)]))
+      {
+        changed.push_back(ToLower(keys[i]));
+      }
+      matched[static_cast<std::size_t>(j)] = true;
+    }
+  }
+  for (std::size_t j = 0; j < other.keys.size(); ++j)
+  {
+    if (!matched[j])
+    {
+      changed.push_back(ToLower(other.keys[j]));
+    }
+  }
+  return changed;
+}
+
 void Properties::Clear_unlocked()
 {
   keys.clear();
-  values.clear();
+  values.reset();
+  hashes.clear();
+  index.clear();
 }
 
 }
@@ -27,6 +27,8 @@
 #include "cppmicroservices/AnyMap.h"
 #include "cppmicroservices/detail/Threads.h"
 
+#include <cstddef>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -42,20 +44,71 @@ public:
   Properties(Properties&& o);
   Properties& operator=(Properties&& o);
 
-  Any Value_unlocked(const std::string& key) const;
-  Any Value_unlocked(int index) const;
+  /**
+   * The returned references are only valid while the properties are
+   * locked, and become invalid when the properties are replaced.
+   */
+  const Any& Value_unlocked(const std::string& key) const;
+  const Any& Value_unlocked(int index) const;
+
+  /**
+   * Returns the value of \c key, or an empty Any, without copying it.
+   * The returned pointer shares the ownership of the values and stays
+   * valid after the properties are unlocked or replaced.
+   */
+  std::shared_ptr<const Any> SharedValue_unlocked(const std::string& key) const;
+
+  /**
+   * Returns the hash of \c key which Find_unlocked and
+   * FindCaseSensitive_unlocked look it up by. Case variants of a key
+   * have the same hash.
+   */
+  static std::size_t HashKey(const std::string& key);
 
   int Find_unlocked(const std::string& key) const;
   int FindCaseSensitive_unlocked(const std::string& key) const;
 
+  /**
+   * Overloads for callers which look up the same key repeatedly and
+   * computed its \c hash with HashKey beforehand.
+   */
+  int Find_unlocked(const std::string& key, std::size_t hash) const;
+  int FindCaseSensitive_unlocked(const std::string& key, std::size_t hash) const;
+
   std::vector<std::string> Keys_unlocked() const;
 
+  /**
+   * Returns the lower-case keys whose values differ between these and the
+   * \c other properties, including the keys only one of them contains.
+   * Values of types which LDAP filters cannot compare are always
+   * considered to differ.
+   */
+  std::vector<std::string> GetChangedKeys_unlocked(const Properties& other) const;
+
   void Clear_unlocked();
 
 private:
 
+  /**
+   * Returns the index of the slot in \c index where a key with the given
+   * case-folded \c hash is stored or could be inserted, probing linearly
+   * from the hash's home slot. Keys are matched case-insensitively, or
+   * exactly if \c caseSensitive is true. The index must not be empty.
+   */
+  std::size_t Probe_unlocked(const std::string& key, std::size_t hash, bool caseSensitive) const;
+
   std::vector<std::string> keys;
-  std::vector<Any> values;
+
+  // Shared with the pointers returned by SharedValue_unlocked
+  std::shared_ptr<const std::vector<Any>> values;
+
+  // Case-folded hash of each entry in keys.
+  std::vector<std::size_t> hashes;
+
+  // Open-addressing table of indices into keys, or -1 for an empty slot.
+  // Its size is a power of two holding at least twice as many slots as
+  // there are keys, so lookups take O(1) expected probes.
+  std::vector<int> index;
 
   static const Any emptyAny;
 };
@@ -0,0 +1,195 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#ifndef CPPMICROSERVICES_SHARDEDLRUCACHE_H
+#define CPPMICROSERVICES_SHARDEDLRUCACHE_H
+
+#include "cppmicroservices/detail/Threads.h"
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace cppmicroservices {
+
+/**
+ * A bounded, thread-safe map from strings to values of type V.
+ *
+ * The keys are spread over a fixed number of shards with one lock each.
+ * The capacity is split exactly over the shards, and each shard evicts
+ * its least recently used entry when it is full. Shards with a capacity
+ * of zero do not store anything.
+ *
+ * This class is not part of the public API.
+ */
+template<class V>
+class ShardedLruCache
+{
+
+public:
+
+  struct Statistics
+  {
+    std::size_t hits;
+    std::size_t misses;
+    std::size_t evictions;
+    std::size_t size;
+    std::size_t capacity;
+  };
+
+  explicit ShardedLruCache(std::size_t capacity)
+    : capacity(capacity)
+    , hits(0)
+    , misses(0)
+    , evictions(0)
+  {
+    for (std::size_t i = 0; i < SHARD_COUNT; ++i)
+    {
+      shards[i].capacity = capacity / SHARD_COUNT + (i < capacity % SHARD_COUNT ? 1 : 0);
+    }
+  }
+
+  ShardedLruCache(const ShardedLruCache&) = delete;
+  ShardedLruCache& operator=(const ShardedLruCache&) = delete;
+
+  /**
+   * Call <code>f</code> with the value of <code>key</code>, if there is one,
+   * while holding the lock of its shard. The entry is removed if
+   * <code>f</code> returns <code>false</code>, for example because the
+   * value is outdated.
+   *
+   * @return <code>true</code> if <code>f</code> was called and returned
+   *         <code>true</code>.
+   */
+  template<class F>
+  bool Find(const std::string& key, F f)
+  {
+    Shard& shard = GetShard(key);
+    auto l = shard.Lock(); US_UNUSED(l);
+    auto iter = shard.index.find(key);
+    if (iter == shard.index.end())
+    {
+      ++misses;
+      return false;
+    }
+    if (!f(iter->second->second))
+    {
+      shard.lru.erase(iter->second);
+      shard.index.erase(iter);
+      ++misses;
+      return false;
+    }
+    ++hits;
+    shard.lru.splice(shard.lru.begin(), shard.lru, iter->second);
+    return true;
+  }
+
+  /**
+   * Insert <code>value</code> under <code>key</code>. If another thread
+   * inserted a value concurrently, call <code>update</code> with it instead,
+   * while holding the lock of its shard.
+   */
+  template<class F>
+  void Insert(const std::string& key, V value, F update)
+  {
+    Shard& shard = GetShard(key);
+    auto l = shard.Lock(); US_UNUSED(l);
+    auto iter = shard.index.find(key);
+    if (iter != shard.index.end())
+    {
+      update(iter->second->second);
+      shard.lru.splice(shard.lru.begin(), shard.lru, iter->second);
+      return;
+    }
+    if (shard.capacity == 0)
+    {
+      return;
+    }
+
+    shard.lru.emplace_front(key, std::move(value));
+    shard.index.insert(std::make_pair(key, shard.lru.begin()));
+    if (shard.lru.size() > shard.capacity)
+    {
+      shard.index.erase(shard.lru.back().first);
+      shard.lru.pop_back();
+      ++evictions;
+    }
+  }
+
+  Statistics GetStatistics() const
+  {
+    Statistics stats;
+    stats.hits = hits;
+    stats.misses = misses;
+    stats.evictions = evictions;
+    stats.size = 0;
+    stats.capacity = capacity;
+    for (auto& shard : shards)
+    {
+      stats.size += (shard.Lock(), shard.lru.size());
+    }
+    return stats;
+  }
+
+  void Clear()
+  {
+    for (auto& shard : shards)
+    {
+      auto l = shard.Lock(); US_UNUSED(l);
+      shard.index.clear();
+      shard.lru.clear();
+    }
+  }
+
+private:
+
+  static const std::size_t SHARD_COUNT = 16;
+
+  typedef std::list<std::pair<std::string, V>> LruList;
+
+  struct Shard : detail::MultiThreaded<>
+  {
+    LruList lru;
+    std::unordered_map<std::string, typename LruList::iterator> index;
+    std::size_t capacity;
+  };
+
+  Shard& GetShard(const std::string& key)
+  {
+    return shards[std::hash<std::string>()(key) % SHARD_COUNT];
+  }
+
+  const std::size_t capacity;
+
+  Shard shards[SHARD_COUNT];
+
+  std::atomic<std::size_t> hits;
+  std::atomic<std::size_t> misses;
+  std::atomic<std::size_t> evictions;
+};
+
+}
+
+#endif // CPPMICROSERVICES_SHARDEDLRUCACHE_H
@@ -33,6 +33,7 @@
 #include <algorithm>
 #include <cstdio>
 #include <cctype>
+#include <stdexcept>
 #include <string>
 #include <typeinfo>
 
@@ -451,6 +452,43 @@ void TerminateForDebug(const std::exception_ptr ex)
 #endif
 }
 
+std::size_t GetSizeProperty(const std::map<std::string, Any>& props, const std::string& key,
+                            std::size_t defaultValue)
+{
+  auto iter = props.find(key);
+  if (iter == props.end())
+  {
+    return defaultValue;
+  }
+  if (iter->second.Type() == typeid(int) && ref_any_cast<int>(iter->second) >= 0)
+  {
+    return static_cast<std::size_t>(ref_any_cast<int>(iter->second));
+  }
+  if (iter->second.Type() == typeid(std::size_t))
+  {
+    return ref_any_cast<std::size_t>(iter->second);
+  }
+  throw std::invalid_argument("The " + key + " property must be a non-negative int or a std::size_t");
+}
+
+std::vector<std::string> GetStringListProperty(const std::map<std::string, Any>& props, const std::string& key)
+{
+  auto iter = props.find(key);
+  if (iter == props.end())
+  {
+    return std::vector<std::string>();
+  }
+  if (iter->second.Type() == typeid(std::string))
+  {
+    return std::vector<std::string>(1, ref_any_cast<std::string>(iter->second));
+  }
+  if (iter->second.Type() == typeid(std::vector<std::string>))
+  {
+    return ref_any_cast<std::vector<std::string>>(iter->second);
+  }
+  throw std::invalid_argument("The " + key + " property must be a std::string or std::vector<std::string>");
+}
+
 namespace detail
 {
 std::string GetDemangledName(const std::type_info& typeInfo)
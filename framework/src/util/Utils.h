@@ -27,6 +27,7 @@
 #include "cppmicroservices/FrameworkConfig.h"
 
 #include <exception>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -112,6 +113,19 @@ std::string GetCurrentWorkingDirectory();
 
 void TerminateForDebug(const std::exception_ptr ex);
 
+class Any;
+
+// Get a framework property holding a size, as a non-negative int or a std::size_t.
+// Returns defaultValue if the property is not set and throws std::invalid_argument
+// if it has another type.
+std::size_t GetSizeProperty(const std::map<std::string, Any>& props, const std::string& key,
+                            std::size_t defaultValue);
+
+// Get a framework property holding a list of strings, as a std::string or a
+// std::vector<std::string>. Returns an empty list if the property is not set
+// and throws std::invalid_argument if it has another type.
+std::vector<std::string> GetStringListProperty(const std::map<std::string, Any>& props, const std::string& key);
+
 namespace detail {
 US_Framework_EXPORT std::string GetDemangledName(const std::type_info& typeInfo);
 }
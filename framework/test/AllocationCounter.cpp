@@ -0,0 +1,211 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<int> counters(0);
+std::atomic<unsigned long long> allocations(0);
+
+void* Allocate(std::size_t size) noexcept
+{
+  if (counters.load(std::memory_order_relaxed) > 0)
+  {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  return std::malloc(size ? size : 1);
+}
+
+void* AllocateOrThrow(std::size_t size)
+{
+  if (void* p = Allocate(size))
+  {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+#ifdef __cpp_aligned_new
+// Over-allocate and keep the pointer returned by malloc in front of
+// the aligned block.
+void* AllocateAligned(std::size_t size, std::align_val_t alignment) noexcept
+{
+  const std::size_t align = static_cast<std::size_t>(alignment);
+  void* p = Allocate(size + align + sizeof(void*));
+  if (p == nullptr)
+  {
+    return nullptr;
+  }
+  const std::uintptr_t address = (reinterpret_cast<std::uintptr_t>(p) + sizeof(void*) + align - 1) & ~(align - 1);
+  reinterpret_cast<void**>(address)[-1] = p;
+  return reinterpret_cast<void*>(address);
+}
+
+void* AllocateAlignedOrThrow(std::size_t size, std::align_val_t alignment)
+{
+  if (void* p = AllocateAligned(size, alignment))
+  {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void FreeAligned(void* p) noexcept
+{
+  if (p != nullptr)
+  {
+    std::free(static_cast<void**>(p)[-1]);
+  }
+}
+#endif
+
+}
+
+namespace cppmicroservices {
+
+AllocationCounter::AllocationCounter()
+{
+  ++counters;
+  start = allocations.load();
+}
+
+AllocationCounter::~AllocationCounter()
+{
+  --counters;
+}
+
+unsigned long long AllocationCounter::Count() const
+{
+  return allocations.load() - start;
+}
+
+}
+
+void* operator new(std::size_t size)
+{
+  return AllocateOrThrow(size);
+}
+
+void* operator new[](std::size_t size)
+{
+  return AllocateOrThrow(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+  return Allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+  return Allocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+  std::free(p);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+#endif
+
+#ifdef __cpp_aligned_new
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+  return AllocateAlignedOrThrow(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+  return AllocateAlignedOrThrow(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+  return AllocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+  return AllocateAligned(size, alignment);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+  FreeAligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+  FreeAligned(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+  FreeAligned(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+  FreeAligned(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+  FreeAligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+  FreeAligned(p);
+}
+#endif
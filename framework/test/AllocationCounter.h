@@ -0,0 +1,57 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#ifndef CPPMICROSERVICES_ALLOCATIONCOUNTER_H
+#define CPPMICROSERVICES_ALLOCATIONCOUNTER_H
+
+namespace cppmicroservices {
+
+/**
+ * Counts the allocations made through the global operator new while an
+ * object of this class exists, including those of other threads.
+ *
+ * The replacement operators are defined in AllocationCounter.cpp, which
+ * is only linked into the allocation test driver. Where the replacement
+ * does not apply to shared libraries, allocations of the framework
+ * library are not counted.
+ */
+class AllocationCounter
+{
+public:
+
+  AllocationCounter();
+  ~AllocationCounter();
+
+  AllocationCounter(const AllocationCounter&) = delete;
+  AllocationCounter& operator=(const AllocationCounter&) = delete;
+
+  /** \brief The number of allocations since this object was created. */
+  unsigned long long Count() const;
+
+private:
+
+  unsigned long long start;
+};
+
+}
+
+#endif // CPPMICROSERVICES_ALLOCATIONCOUNTER_H
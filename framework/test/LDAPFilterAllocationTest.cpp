@@ -0,0 +1,113 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#include "cppmicroservices/BundleContext.h"
+#include "cppmicroservices/FrameworkFactory.h"
+#include "cppmicroservices/Framework.h"
+#include "cppmicroservices/FrameworkEvent.h"
+#include "cppmicroservices/LDAPFilter.h"
+
+#include "AllocationCounter.h"
+#include "TestingMacros.h"
+
+#include <string>
+#include <vector>
+
+using namespace cppmicroservices;
+
+namespace {
+
+struct IAllocTestService
+{
+  virtual ~IAllocTestService() {}
+};
+
+// Return the number of allocations per call of f.
+template<class F>
+double CountAllocations(F f)
+{
+  const int iterations = 1000;
+  AllocationCounter counter;
+  for (int i = 0; i < iterations; ++i)
+  {
+    f();
+  }
+  return static_cast<double>(counter.Count()) / iterations;
+}
+
+// Count the allocations of reading the properties of a service, as
+// done for every service event by the listener filters.
+void TestPropertyReads(const BundleContext& context)
+{
+  ServiceProperties props;
+  props["name"] = std::string("Service.Name");
+  props["level"] = 5;
+  props["description"] = std::string("Some Descriptive  Text");
+  props["tags"] = std::vector<std::string>{ "alpha", "beta", "gamma" };
+  auto reg = BundleContext(context).RegisterService<IAllocTestService>(std::make_shared<IAllocTestService>(), props);
+  auto ref = reg.GetReference();
+
+  const LDAPFilter filter("(&(name=Serv*)(level>=3)(DESCRIPTION~=somedescriptivetext)(tags=beta)(objectclass=*))");
+  US_TEST_CONDITION(filter.Match(ref), "Match " + filter.ToString())
+
+  const double copies = CountAllocations([&] { ref.GetProperty("tags"); });
+  const double shared = CountAllocations([&] { ref.GetSharedProperty("tags"); });
+  const double matches = CountAllocations([&] { filter.Match(ref); });
+  US_TEST_OUTPUT(<< "GetProperty: " << copies << " allocations per call");
+  US_TEST_OUTPUT(<< "GetSharedProperty: " << shared << " allocations per call");
+  US_TEST_OUTPUT(<< filter.ToString() << ": " << matches << " allocations per match");
+
+  // Allocations made by the framework library are not seen on
+  // platforms where the replacement operator new does not apply to it.
+  if (copies > 0)
+  {
+    US_TEST_CONDITION(shared == 0, "GetSharedProperty does not allocate")
+    US_TEST_CONDITION(matches == 0, "LDAPFilter::Match does not allocate")
+  }
+
+  reg.SetProperties(ServiceProperties{ { "name", std::string("Changed") } });
+  auto tags = ref.GetSharedProperty("tags");
+  US_TEST_CONDITION(tags && tags->Empty(), "Removed property is an invalid Any")
+  auto name = ref.GetSharedProperty("NAME");
+  reg.SetProperties(ServiceProperties{ { "name", std::string("Changed again") } });
+  US_TEST_CONDITION(ref_any_cast<std::string>(*name) == "Changed", "Shared property outlives the properties")
+
+  reg.Unregister();
+}
+
+}
+
+int LDAPFilterAllocationTest(int /*argc*/, char* /*argv*/[])
+{
+  US_TEST_BEGIN("LDAPFilterAllocationTest")
+
+  FrameworkFactory factory;
+  auto framework = factory.NewFramework();
+  framework.Start();
+
+  TestPropertyReads(framework.GetBundleContext());
+
+  framework.Stop();
+  framework.WaitForStop(std::chrono::milliseconds::zero());
+
+  US_TEST_END()
+}
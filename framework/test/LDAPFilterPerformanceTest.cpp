@@ -0,0 +1,315 @@
+/*=============================================================================
+
+  Library: CppMicroServices
+
+  Copyright (c) The CppMicroServices developers. See the COPYRIGHT
+  file at the top-level directory of this distribution and at
+  https://github.com/CppMicroServices/CppMicroServices/COPYRIGHT .
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#include "cppmicroservices/BundleContext.h"
+#include "cppmicroservices/FrameworkFactory.h"
+#include "cppmicroservices/Framework.h"
+#include "cppmicroservices/LDAPFilter.h"
+
+#include "TestingMacros.h"
+#include "TestUtils.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace cppmicroservices;
+
+namespace {
+
+struct IPerfTestService
+{
+  virtual ~IPerfTestService() {}
+};
+
+/**
+ * The baseline for the compiled evaluator of LDAPExpr: an expression tree
+ * which is walked recursively on every match and converts the filter
+ * values on every comparison, as LDAPExpr did before it was compiled.
+ * It only parses the filters of TestMatch, without escapes.
+ */
+class TreeExpr
+{
+public:
+
+  explicit TreeExpr(const std::string& filter)
+  {
+    std::size_t pos = 0;
+    *this = Parse(filter, pos);
+    if (pos != filter.size())
+    {
+      throw std::invalid_argument("Trailing characters in " + filter);
+    }
+  }
+
+  bool Match(const ServiceReferenceBase& ref) const
+  {
+    switch (op)
+    {
+    case '&':
+      for (auto& arg : args)
+      {
+        if (!arg.Match(ref)) return false;
+      }
+      return true;
+    case '|':
+      for (auto& arg : args)
+      {
+        if (arg.Match(ref)) return true;
+      }
+      return false;
+    case '!':
+      return !args.front().Match(ref);
+    default:
+      {
+        auto value = ref.GetSharedProperty(attrName);
+        return value && Compare(*value);
+      }
+    }
+  }
+
+private:
+
+  TreeExpr() : op(0) {}
+
+  static TreeExpr Parse(const std::string& s, std::size_t& pos)
+  {
+    TreeExpr expr;
+    Expect(s, pos, '(');
+    const char c = pos < s.size() ? s[pos] : 0;
+    if (c == '&' || c == '|' || c == '!')
+    {
+      expr.op = c;
+      ++pos;
+      while (pos < s.size() && s[pos] == '(')
+      {
+        expr.args.push_back(Parse(s, pos));
+      }
+    }
+    else
+    {
+      const std::size_t end = s.find_first_of("=<>~", pos);
+      if (end == std::string::npos) throw std::invalid_argument("Missing operator in " + s);
+      expr.attrName = s.substr(pos, end - pos);
+      expr.op = s[end];
+      pos = end + (expr.op == '=' ? 1 : 2);
+      const std::size_t close = s.find(')', pos);
+      if (close == std::string::npos) throw std::invalid_argument("Missing ')' in " + s);
+      expr.attrValue = s.substr(pos, close - pos);
+      pos = close;
+    }
+    Expect(s, pos, ')');
+    return expr;
+  }
+
+  static void Expect(const std::string& s, std::size_t& pos, char c)
+  {
+    if (pos >= s.size() || s[pos] != c)
+    {
+      throw std::invalid_argument(std::string("Expected '") + c + "' in " + s);
+    }
+    ++pos;
+  }
+
+  bool Compare(const Any& value) const
+  {
+    if (op == '=' && attrValue == "*") return true;
+
+    const std::type_info& type = value.Type();
+    if (type == typeid(std::string))
+    {
+      return CompareString(ref_any_cast<std::string>(value));
+    }
+    else if (type == typeid(std::vector<std::string>))
+    {
+      for (auto& s : ref_any_cast<std::vector<std::string>>(value))
+      {
+        if (CompareString(s)) return true;
+      }
+    }
+    else if (type == typeid(bool))
+    {
+      if (op == '<' || op == '>') return false;
+      const std::string boolValue = ref_any_cast<bool>(value) ? "true" : "false";
+      return FixupString(attrValue) == boolValue;
+    }
+    else if (type == typeid(int))
+    {
+      return CompareIntegral(ref_any_cast<int>(value));
+    }
+    else if (type == typeid(long))
+    {
+      return CompareIntegral(ref_any_cast<long>(value));
+    }
+    else if (type == typeid(double))
+    {
+      char* end = nullptr;
+      const double d = std::strtod(attrValue.c_str(), &end);
+      if (end == attrValue.c_str()) return false;
+      const double v = ref_any_cast<double>(value);
+      if (op == '<') return v <= d;
+      if (op == '>') return v >= d;
+      return v - d < std::numeric_limits<double>::epsilon() && d - v < std::numeric_limits<double>::epsilon();
+    }
+    return false;
+  }
+
+  template<class T>
+  bool CompareIntegral(T v) const
+  {
+    char* end = nullptr;
+    const long l = std::strtol(attrValue.c_str(), &end, 10);
+    if (end == attrValue.c_str()) return false;
+    const T i = static_cast<T>(l);
+    if (op == '<') return v <= i;
+    if (op == '>') return v >= i;
+    return v == i;
+  }
+
+  bool CompareString(const std::string& s) const
+  {
+    switch (op)
+    {
+    case '<': return s.compare(attrValue) <= 0;
+    case '>': return s.compare(attrValue) >= 0;
+    case '~': return FixupString(s) == FixupString(attrValue);
+    default: return PatSubstr(s, 0, 0);
+    }
+  }
+
+  static std::string FixupString(const std::string& s)
+  {
+    std::string result;
+    for (char c : s)
+    {
+      if (!std::isspace(static_cast<unsigned char>(c)))
+      {
+        result += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+      }
+    }
+    return result;
+  }
+
+  bool PatSubstr(const std::string& s, std::size_t si, std::size_t pi) const
+  {
+    if (pi == attrValue.size()) return si == s.size();
+    if (attrValue[pi] == '*')
+    {
+      for (;; ++si)
+      {
+        if (PatSubstr(s, si, pi + 1)) return true;
+        if (si == s.size()) return false;
+      }
+    }
+    return si < s.size() && s[si] == attrValue[pi] && PatSubstr(s, si + 1, pi + 1);
+  }
+
+  // '&', '|', '!' or the first character of the comparison operator.
+  char op;
+  std::vector<TreeExpr> args;
+  std::string attrName;
+  std::string attrValue;
+};
+
+// Match each filter many times against the properties of a service
+// carrying \c extraProperties additional properties and report the
+// time per match of the compiled evaluator and of the tree walker.
+void TestMatch(const BundleContext& context, int extraProperties)
+{
+  ServiceProperties props;
+  for (int i = 0; i < extraProperties; ++i)
+  {
+    props["service.extra." + std::to_string(i) + ".value"] = std::to_string(i);
+  }
+  props["name"] = std::string("Service.Name");
+  props["level"] = 5;
+  props["size"] = 1024L;
+  props["weight"] = 2.5;
+  props["enabled"] = true;
+  props["description"] = std::string("Some Descriptive  Text");
+  props["tags"] = std::vector<std::string>{ "alpha", "beta", "gamma" };
+  auto reg = BundleContext(context).RegisterService<IPerfTestService>(std::make_shared<IPerfTestService>(), props);
+  auto ref = reg.GetReference();
+
+  const std::vector<std::pair<std::string, bool>> filters = {
+    { "(name=Service.Name)", true },
+    { "(&(name=Service.Name)(level>=3)(size<=2048))", true },
+    { "(|(level<=1)(weight>=3.0)(enabled=false)(size=1000))", false },
+    { "(description~=somedescriptivetext)", true },
+    { "(name=Serv*Na*e)", true },
+    { "(&(tags=beta)(!(level=7))(|(name=foo)(name=Service.*)))", true },
+    { "(&(LEVEL>=3)(Enabled=true)(Weight<=2.5))", true }
+  };
+
+  const int iterations = 200000;
+  US_TEST_OUTPUT(<< "Service with " << props.size() << " properties");
+  HighPrecisionTimer timer;
+  for (auto& filter : filters)
+  {
+    LDAPFilter ldap(filter.first);
+    int matches = 0;
+    timer.Start();
+    for (int i = 0; i < iterations; ++i)
+    {
+      if (ldap.Match(ref)) ++matches;
+    }
+    long long elapsed = timer.ElapsedMicro();
+    US_TEST_CONDITION(matches == (filter.second ? iterations : 0), "Match " + filter.first)
+
+    TreeExpr tree(filter.first);
+    int treeMatches = 0;
+    timer.Start();
+    for (int i = 0; i < iterations; ++i)
+    {
+      if (tree.Match(ref)) ++treeMatches;
+    }
+    long long treeElapsed = timer.ElapsedMicro();
+    US_TEST_CONDITION(treeMatches == matches, "Tree walker match " + filter.first)
+
+    US_TEST_OUTPUT(<< filter.first << ": " << (elapsed * 1000.0 / iterations) << " ns per match, tree walker "
+                   << (treeElapsed * 1000.0 / iterations) << " ns");
+  }
+
+  reg.Unregister();
+}
+
+}
+
+int LDAPFilterPerformanceTest(int /*argc*/, char* /*argv*/[])
+{
+  US_TEST_BEGIN("LDAPFilterPerformanceTest")
+
+  FrameworkFactory factory;
+  auto framework = factory.NewFramework();
+  framework.Start();
+
+  TestMatch(framework.GetBundleContext(), 0);
+  TestMatch(framework.GetBundleContext(), 60);
+
+  framework.Stop();
+
+  US_TEST_END()
+}
@@ -21,13 +21,22 @@
 =============================================================================*/
 
 #include "cppmicroservices/Any.h"
+#include "cppmicroservices/BundleContext.h"
 #include "cppmicroservices/Constants.h"
+#include "cppmicroservices/Framework.h"
+#include "cppmicroservices/FrameworkEvent.h"
+#include "cppmicroservices/FrameworkFactory.h"
 #include "cppmicroservices/LDAPFilter.h"
 #include "cppmicroservices/LDAPProp.h"
 
 #include "TestingMacros.h"
 
+#include <chrono>
+#include <map>
 #include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
 
 using namespace cppmicroservices;
 
@@ -160,6 +169,149 @@ void TestLDAPExpressions()
   US_TEST_CONDITION(filter1 == filter2, "test null expressions")
 }
 
+// Evaluate the compiled expressions for each property value type.
+void TestEvaluateTypes()
+{
+  AnyMap props(AnyMap::UNORDERED_MAP);
+  props["one"] = 1;
+  props["five"] = 5;
+  props["three"] = 3;
+  props["str"] = std::string("axxbyyc");
+  props["text"] = std::string(" So me TEXT");
+  props["flag"] = false;
+  props["shrt"] = static_cast<short>(12);
+  props["size"] = 1024UL;
+  props["dbl"] = 2.5;
+  props["flt"] = 0.5f;
+  props["chr"] = 'x';
+  props["tags"] = std::vector<std::string>{ "alpha", "beta" };
+  props["anys"] = std::vector<Any>{ std::string("x"), 7 };
+
+  const std::vector<std::pair<std::string, bool>> filters = {
+    { "(str=a*b*c)", true },
+    { "(str=a*y*b*c)", false },
+    { "(str=*yc)", true },
+    { "(str=axxbyyc*)", true },
+    { "(str<=b)", true },
+    { "(str>=b)", false },
+    { "(one=*)", true },
+    { "(missing=*)", false },
+    { "(text~=sometext)", true },
+    { "(text~=some)", false },
+    { "(flag=FALSE)", true },
+    { "(flag=true)", false },
+    { "(flag<=false)", false },
+    { "(shrt>=10)", true },
+    { "(shrt=abc)", false },
+    { "(size<=2048)", true },
+    { "(dbl~=2.5)", true },
+    { "(dbl>=2.6)", false },
+    { "(flt<=0.5)", true },
+    { "(chr=x)", true },
+    { "(tags=b*)", true },
+    { "(tags=gamma)", false },
+    { "(anys=7)", true },
+    { "(&(|(one=0)(five=5))(!(three=4)))", true },
+    { "(&(|(one=0)(five=5))(!(three=3)))", false },
+    { "(|(&(one=1)(five=2))(three=3))", true },
+    { "(|(&(one=1)(five=5))(three=0))", true },
+    { "(|(&(one=1)(five=2))(three=0))", false },
+    { "(!(|(one=0)(five=0)(three=0)))", true }
+  };
+  for (auto& filter : filters)
+  {
+    US_TEST_CONDITION(LDAPFilter(filter.first).Match(props) == filter.second, "Evaluate " + filter.first)
+  }
+}
+
+// Look up keys which are prefixes or case variants of each other, among
+// as many properties as a richly described service carries.
+void TestPropertyKeys()
+{
+  AnyMap props(AnyMap::UNORDERED_MAP);
+  props["s"] = 1;
+  props["size"] = 2;
+  props["Sizes"] = 3;
+  for (int i = 0; i < 60; ++i)
+  {
+    props["key" + std::to_string(i)] = i;
+  }
+
+  const std::vector<std::pair<std::string, bool>> filters = {
+    { "(s=1)", true },
+    { "(S=1)", true },
+    { "(size=2)", true },
+    { "(SIZE=2)", true },
+    { "(sizes=3)", true },
+    { "(siz=*)", false },
+    { "(key0=0)", true },
+    { "(KEY59=59)", true },
+    { "(key6=6)", true },
+    { "(key60=*)", false }
+  };
+  for (auto& filter : filters)
+  {
+    US_TEST_CONDITION(LDAPFilter(filter.first).Match(props) == filter.second, "Evaluate " + filter.first)
+  }
+
+  props["SIZE"] = 4;
+  try
+  {
+    LDAPFilter("(size=2)").Match(props);
+    US_TEST_FAILED_MSG(<< "Case variants of a key must be rejected")
+  }
+  catch (const std::runtime_error&)
+  {
+  }
+}
+
+// The filters of service lookups and service listeners are parsed once
+// and kept in a cache of the configured size.
+void TestFilterCache()
+{
+  FrameworkFactory factory;
+  std::map<std::string, Any> frameworkProps;
+  frameworkProps[Constants::FRAMEWORK_LDAP_FILTER_CACHE_SIZE] = 20;
+  auto framework = factory.NewFramework(frameworkProps);
+  framework.Start();
+  auto context = framework.GetBundleContext();
+
+  auto stats = framework.GetLDAPFilterCacheStatistics();
+  US_TEST_CONDITION(stats.capacity == 20, "Filter cache capacity")
+  const std::size_t hits = stats.hits;
+  const std::size_t misses = stats.misses;
+
+  context.GetServiceReferences("", "(cache.test=1)");
+  context.GetServiceReferences("", "(cache.test=1)");
+  auto token = context.AddServiceListener([](const ServiceEvent&) {}, "(cache.test=1)");
+  stats = framework.GetLDAPFilterCacheStatistics();
+  US_TEST_CONDITION(stats.misses == misses + 1 && stats.hits == hits + 2, "Filter parsed once")
+
+  for (int i = 0; i < 100; ++i)
+  {
+    context.GetServiceReferences("", "(cache.test=" + std::to_string(i) + ")");
+  }
+  stats = framework.GetLDAPFilterCacheStatistics();
+  US_TEST_CONDITION(stats.size <= 20 && stats.evictions > 0, "Full filter cache evicts filters")
+  context.RemoveListener(std::move(token));
+
+  framework.Stop();
+  framework.WaitForStop(std::chrono::milliseconds::zero());
+
+  frameworkProps[Constants::FRAMEWORK_LDAP_FILTER_CACHE_SIZE] = 0;
+  framework = factory.NewFramework(frameworkProps);
+  framework.Start();
+  framework.GetBundleContext().GetServiceReferences("", "(cache.test=1)");
+  framework.GetBundleContext().GetServiceReferences("", "(cache.test=1)");
+  stats = framework.GetLDAPFilterCacheStatistics();
+  US_TEST_CONDITION(stats.capacity == 0 && stats.size == 0 && stats.hits == 0, "Disabled filter cache")
+  framework.Stop();
+  framework.WaitForStop(std::chrono::milliseconds::zero());
+
+  frameworkProps[Constants::FRAMEWORK_LDAP_FILTER_CACHE_SIZE] = std::string("20");
+  US_TEST_FOR_EXCEPTION(std::invalid_argument, factory.NewFramework(frameworkProps))
+}
+
 int LDAPFilterTest(int /*argc*/, char* /*argv*/[])
 {
   US_TEST_BEGIN("LDAPFilterTest");
@@ -167,6 +319,9 @@ int LDAPFilterTest(int /*argc*/, char* /*argv*/[])
   TestLDAPExpressions();
   US_TEST_CONDITION(TestParsing() == EXIT_SUCCESS, "Parsing LDAP expressions: ")
   US_TEST_CONDITION(TestEvaluate() == EXIT_SUCCESS, "Evaluating LDAP expressions: ")
+  TestEvaluateTypes();
+  TestPropertyKeys();
+  TestFilterCache();
 
   US_TEST_END()
 }
@@ -390,6 +390,53 @@ void TestFindHook(const Framework& framework)
   context.RemoveServiceListener(&serviceListener, &TestServiceListener::ServiceChanged);
 }
 
+// A find hook unregistered by a find hook called before it is skipped.
+void TestUnregisterFindHook(const Framework& framework)
+{
+  auto context = framework.GetBundleContext();
+
+  struct UnregisteringFindHook : public ServiceFindHook
+  {
+    ServiceRegistration<ServiceFindHook> victim;
+
+    void Find(const BundleContext&, const std::string&, const std::string&,
+              ShrinkableVector<ServiceReferenceBase>&)
+    {
+      if (victim)
+      {
+        victim.Unregister();
+        victim = nullptr;
+      }
+    }
+  };
+
+  struct NoOpFindHook : public ServiceFindHook
+  {
+    void Find(const BundleContext&, const std::string&, const std::string&,
+              ShrinkableVector<ServiceReferenceBase>&)
+    {
+    }
+  };
+
+  auto unregisteringHook = std::make_shared<UnregisteringFindHook>();
+  ServiceProperties props;
+  props[Constants::SERVICE_RANKING] = 10;
+  auto reg = context.RegisterService<ServiceFindHook>(unregisteringHook, props);
+  unregisteringHook->victim = context.RegisterService<ServiceFindHook>(std::make_shared<NoOpFindHook>());
+
+  try
+  {
+    context.GetServiceReferences<ServiceFindHook>();
+    US_TEST_CONDITION(!unregisteringHook->victim, "Lookup with a find hook unregistered during the lookup")
+  }
+  catch (const std::exception& e)
+  {
+    US_TEST_FAILED_MSG(<< "Lookup with an unregistered find hook: " << e.what())
+  }
+
+  reg.Unregister();
+}
+
 } // end unnamed namespace
 
 int ServiceHooksTest(int /*argc*/, char* /*argv*/[])
@@ -420,6 +467,7 @@ int ServiceHooksTest(int /*argc*/, char* /*argv*/[])
 
   TestListenerHook(framework);
   TestFindHook(framework);
+  TestUnregisterFindHook(framework);
   TestEventListenerHook(framework);
 
   US_TEST_END()
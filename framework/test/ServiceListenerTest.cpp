@@ -25,8 +25,11 @@
 #include "cppmicroservices/Constants.h"
 #include "cppmicroservices/FrameworkFactory.h"
 #include "cppmicroservices/Framework.h"
+#include "cppmicroservices/FrameworkEvent.h"
 #include "cppmicroservices/GetBundleContext.h"
 #include "cppmicroservices/ServiceEvent.h"
+#include "cppmicroservices/ServiceEventListenerHook.h"
+#include "cppmicroservices/ServiceTracker.h"
 #include "cppmicroservices/SharedLibrary.h"
 
 #include "BundlePropsInterface.h"
@@ -34,6 +37,12 @@
 #include "TestingMacros.h"
 #include "TestingConfig.h"
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 using namespace cppmicroservices;
 
 class TestServiceListener
@@ -539,6 +548,713 @@ void frameSL25a(const Framework& framework)
 
 }
 
+#ifdef US_ENABLE_THREADING_SUPPORT
+
+// Records the events and calling threads of an asynchronous listener.
+// The listener blocks while the gate is closed.
+struct AsyncServiceListener
+{
+  std::mutex mutex;
+  std::condition_variable cond;
+  bool gateOpen = true;
+  std::size_t entered = 0;
+  std::vector<ServiceEvent::Type> events;
+  std::vector<std::thread::id> threads;
+
+  void ServiceChanged(const ServiceEvent& evt)
+  {
+    std::unique_lock<std::mutex> l(mutex);
+    ++entered;
+    cond.notify_all();
+    cond.wait(l, [this] { return gateOpen; });
+    events.push_back(evt.GetType());
+    threads.push_back(std::this_thread::get_id());
+    cond.notify_all();
+  }
+
+  void SetGate(bool open)
+  {
+    std::lock_guard<std::mutex> l(mutex);
+    gateOpen = open;
+    cond.notify_all();
+  }
+
+  bool WaitForEntered(std::size_t n)
+  {
+    std::unique_lock<std::mutex> l(mutex);
+    return cond.wait_for(l, std::chrono::seconds(10), [this, n] { return entered >= n; });
+  }
+
+  bool WaitForEvents(std::size_t n)
+  {
+    std::unique_lock<std::mutex> l(mutex);
+    return cond.wait_for(l, std::chrono::seconds(10), [this, n] { return events.size() >= n; });
+  }
+};
+
+// Records the threads on which a service tracker calls it
+struct ThreadRecordingCustomizer : public ServiceTrackerCustomizer<TestServiceListener>
+{
+  BundleContext context;
+  std::thread::id added;
+  std::thread::id removed;
+
+  explicit ThreadRecordingCustomizer(const BundleContext& context)
+    : context(context)
+  {}
+
+  std::shared_ptr<TestServiceListener> AddingService(const ServiceReference<TestServiceListener>& reference) override
+  {
+    added = std::this_thread::get_id();
+    return context.GetService(reference);
+  }
+
+  void ModifiedService(const ServiceReference<TestServiceListener>&, const std::shared_ptr<TestServiceListener>&) override {}
+
+  void RemovedService(const ServiceReference<TestServiceListener>&, const std::shared_ptr<TestServiceListener>&) override
+  {
+    removed = std::this_thread::get_id();
+  }
+};
+
+void frameSL30a()
+{
+  FrameworkFactory factory;
+  std::map<std::string, Any> frameworkProps;
+  frameworkProps[Constants::FRAMEWORK_SERVICE_LISTENER_QUEUE_SIZE] = 2;
+  auto framework = factory.NewFramework(frameworkProps);
+  framework.Start();
+  auto context = framework.GetBundleContext();
+
+  std::size_t warnings = 0;
+  auto fwToken = context.AddFrameworkListener([&warnings](const FrameworkEvent& evt) {
+    if (evt.GetType() == FrameworkEvent::Type::FRAMEWORK_WARNING) ++warnings;
+  });
+
+  AsyncServiceListener async;
+  AsyncServiceListener sync;
+  auto asyncToken = context.AddServiceListener(
+      std::bind(&AsyncServiceListener::ServiceChanged, &async, std::placeholders::_1), "",
+      ServiceListenerDelivery::ASYNCHRONOUS);
+  auto syncToken = context.AddServiceListener(
+      std::bind(&AsyncServiceListener::ServiceChanged, &sync, std::placeholders::_1));
+
+  // A blocked asynchronous listener does not block the registration.
+  async.SetGate(false);
+  auto reg = context.RegisterService<TestServiceListener>(std::make_shared<TestServiceListener>(context));
+  US_TEST_CONDITION_REQUIRED(async.WaitForEntered(1), "Asynchronous listener called")
+  US_TEST_CONDITION(sync.events.size() == 1 && sync.threads.front() == std::this_thread::get_id(),
+                    "Synchronous listener called on the registering thread")
+
+  // Two events fit into the queue, the other two are dropped.
+  for (int i = 0; i < 3; ++i)
+  {
+    reg.SetProperties(ServiceProperties{{"value", i}});
+  }
+  reg.Unregister();
+  US_TEST_CONDITION(warnings == 1, "One warning for a full listener queue")
+
+  async.SetGate(true);
+  US_TEST_CONDITION_REQUIRED(async.WaitForEvents(3), "Asynchronous listener received the queued events")
+  {
+    std::lock_guard<std::mutex> l(async.mutex);
+    US_TEST_CONDITION(async.events == std::vector<ServiceEvent::Type>({ ServiceEvent::SERVICE_REGISTERED,
+                                                                        ServiceEvent::SERVICE_MODIFIED,
+                                                                        ServiceEvent::SERVICE_MODIFIED }),
+                      "Asynchronous listener events in order")
+    US_TEST_CONDITION(async.threads.front() != std::this_thread::get_id(),
+                      "Asynchronous listener called on a framework thread")
+  }
+  US_TEST_CONDITION(sync.events.size() == 5, "Synchronous listener received all events")
+
+  context.RemoveListener(std::move(asyncToken));
+  context.RemoveListener(std::move(syncToken));
+  context.RemoveListener(std::move(fwToken));
+  framework.Stop();
+  framework.WaitForStop(std::chrono::milliseconds::zero());
+
+  // Listeners are asynchronous by default if the framework property is set.
+  frameworkProps.clear();
+  frameworkProps[Constants::FRAMEWORK_SERVICE_LISTENER_ASYNC] = true;
+  framework = factory.NewFramework(frameworkProps);
+  framework.Start();
+  context = framework.GetBundleContext();
+
+  AsyncServiceListener byDefault;
+  AsyncServiceListener explicitlySync;
+  context.AddServiceListener(std::bind(&AsyncServiceListener::ServiceChanged, &byDefault, std::placeholders::_1));
+  context.AddServiceListener(std::bind(&AsyncServiceListener::ServiceChanged, &explicitlySync, std::placeholders::_1),
+                             "", ServiceListenerDelivery::SYNCHRONOUS);
+  ThreadRecordingCustomizer customizer(context);
+  ServiceTracker<TestServiceListener> tracker(context, &customizer);
+  tracker.Open();
+  reg = context.RegisterService<TestServiceListener>(std::make_shared<TestServiceListener>(context));
+  US_TEST_CONDITION(customizer.added == std::this_thread::get_id() && tracker.Size() == 1,
+                    "Service tracker in an asynchronous framework adds the service synchronously")
+  US_TEST_CONDITION(explicitlySync.events.size() == 1 && explicitlySync.threads.front() == std::this_thread::get_id(),
+                    "Synchronous listener in an asynchronous framework")
+  US_TEST_CONDITION_REQUIRED(byDefault.WaitForEvents(1), "Default listener in an asynchronous framework called")
+  {
+    std::lock_guard<std::mutex> l(byDefault.mutex);
+    US_TEST_CONDITION(byDefault.threads.front() != std::this_thread::get_id(),
+                      "Default listener in an asynchronous framework called on a framework thread")
+  }
+  reg.Unregister();
+  US_TEST_CONDITION(customizer.removed == std::this_thread::get_id() && tracker.Size() == 0,
+                    "Service tracker in an asynchronous framework removes the service synchronously")
+  tracker.Close();
+
+  framework.Stop();
+  framework.WaitForStop(std::chrono::milliseconds::zero());
+}
+
+#endif
+
+void frameSL35a()
+{
+  FrameworkFactory factory;
+  std::map<std::string, Any> frameworkProps;
+  frameworkProps[Constants::FRAMEWORK_SERVICE_LISTENER_INDEXED_KEYS] =
+      std::vector<std::string>{ "Component.Name", "size", "flag" };
+  auto framework = factory.NewFramework(frameworkProps);
+  framework.Start();
+  auto context = framework.GetBundleContext();
+
+  std::map<std::string, int> counts;
+  auto addListener = [&context, &counts](const std::string& filter) {
+    counts[filter] = 0;
+    context.AddServiceListener([&counts, filter](const ServiceEvent&) { ++counts[filter]; }, filter);
+  };
+  addListener("(service.pid=my.pid)");
+  addListener("(component.name=my.comp)");
+  addListener("(|(component.name=other)(component.name=my.comp))");
+  addListener("(size=5)");
+  addListener("(size=300)");
+  addListener("(flag=true)");
+
+  auto service = std::make_shared<TestServiceListener>(context);
+  ServiceProperties props1{ { Constants::SERVICE_PID, std::string("my.pid") },
+                            { "component.name", std::string("my.comp") },
+                            { "size", 5 },
+                            { "flag", true } };
+  auto reg1 = context.RegisterService<TestServiceListener>(service, props1);
+  US_TEST_CONDITION(counts["(service.pid=my.pid)"] == 1, "Listener indexed by service.pid")
+  US_TEST_CONDITION(counts["(component.name=my.comp)"] == 1, "Listener indexed by a configured key")
+  US_TEST_CONDITION(counts["(|(component.name=other)(component.name=my.comp))"] == 1,
+                    "Listener indexed by several values of a configured key")
+  US_TEST_CONDITION(counts["(size=5)"] == 1, "Listener indexed by an integer value")
+  US_TEST_CONDITION(counts["(size=300)"] == 0, "Listener not matching an integer value")
+  US_TEST_CONDITION(counts["(flag=true)"] == 1, "Listener indexed by a key with a boolean value")
+
+  // Filter values are cast to the property type, like in LDAPExpr.
+  ServiceProperties props2{ { Constants::SERVICE_PID, std::string("other.pid") },
+                            { "component.name", std::string("none") },
+                            { "size", static_cast<unsigned char>(300 % 256) },
+                            { "flag", false } };
+  auto reg2 = context.RegisterService<TestServiceListener>(service, props2);
+  US_TEST_CONDITION(counts["(size=300)"] == 1, "Listener matching a truncated integer value")
+  US_TEST_CONDITION(counts["(service.pid=my.pid)"] == 1 && counts["(component.name=my.comp)"] == 1 &&
+                    counts["(size=5)"] == 1 && counts["(flag=true)"] == 1,
+                    "Indexed listeners not called for other values")
+
+  auto reg3 = context.RegisterService<TestServiceListener>(service, {{ "size", 5L }});
+  US_TEST_CONDITION(counts["(size=5)"] == 2, "Listener indexed by an integer value of another type")
+
+  const long id = any_cast<long>(reg1.GetReference().GetProperty(Constants::SERVICE_ID));
+  const std::string idFilter = "(service.id=" + std::to_string(id) + ")";
+  addListener(idFilter);
+  reg2.SetProperties(props2);
+  reg1.SetProperties(props1);
+  US_TEST_CONDITION(counts[idFilter] == 1, "Listener indexed by service.id")
+
+  framework.Stop();
+  framework.WaitForStop(std::chrono::milliseconds::zero());
+}
+
+void frameSL40a(const Framework& framework)
+{
+  auto context = framework.GetBundleContext();
+
+  // Filters sharing sub-expressions, in different order and case
+  const std::vector<std::string> filters = {
+    "(&(objectclass=sl40a.Foo)(env=prod))",
+    "(&(env=prod)(ObjectClass=sl40a.Foo))",
+    "(&(objectclass=sl40a.Foo)(!(env=prod)))",
+    "(|(&(objectclass=sl40a.Foo)(env=prod))(level>=3))",
+    "(&(objectclass=sl40a.*)(level<=2))",
+    "(&(objectclass=sl40a.Foo)(env=prod)(env=prod))",
+    "(!(objectclass=sl40a.Foo))"
+  };
+  std::map<std::string, int> counts;
+  std::vector<ListenerToken> tokens;
+  for (auto& filter : filters)
+  {
+    counts[filter] = 0;
+    tokens.push_back(context.AddServiceListener(
+        [&counts, filter](const ServiceEvent& evt) {
+          if (evt.GetType() != ServiceEvent::SERVICE_MODIFIED_ENDMATCH) ++counts[filter];
+        },
+        filter));
+  }
+
+  auto service = std::make_shared<TestServiceListener>(context);
+  std::map<std::string, int> expected = counts;
+  auto check = [&counts, &expected](const std::string& msg) {
+    US_TEST_CONDITION(counts == expected, msg)
+  };
+
+  auto reg = context.RegisterService(
+      std::make_shared<InterfaceMap>(InterfaceMap{ { "sl40a.Foo", service } }),
+      ServiceProperties{ { "env", std::string("prod") }, { "level", 1 } });
+  expected[filters[0]] = expected[filters[1]] = expected[filters[3]] = 1;
+  expected[filters[4]] = expected[filters[5]] = 1;
+  check("Shared sub-expressions for matching properties");
+
+  reg.SetProperties(ServiceProperties{ { "env", std::string("test") }, { "level", 3 } });
+  expected[filters[2]] = 1;
+  expected[filters[3]] = 2;
+  check("Shared sub-expressions for modified properties");
+
+  reg.Unregister();
+  expected[filters[2]] = 2;
+  expected[filters[3]] = 3;
+  check("Shared sub-expressions for an unregistered service");
+
+  reg = context.RegisterService(std::make_shared<InterfaceMap>(InterfaceMap{ { "sl40a.Bar", service } }),
+                                ServiceProperties{ { "level", 2 } });
+  expected[filters[4]] = 2;
+  expected[filters[6]] = 1;
+  check("Shared sub-expressions for another service");
+  reg.Unregister();
+
+  for (auto& token : tokens)
+  {
+    context.RemoveListener(std::move(token));
+  }
+}
+
+void frameSL45a()
+{
+  // Event listener hooks are called through the bundle context of the
+  // most recently started framework, so this test starts its own.
+  FrameworkFactory factory;
+  auto framework = factory.NewFramework();
+  framework.Start();
+  auto context = framework.GetBundleContext();
+
+  typedef std::vector<ServiceEvent::Type> Events;
+  const std::vector<std::string> filters = {
+    "(&(objectclass=sl45a.Foo)(level>=3))",
+    "(objectclass=sl45a.Foo)",
+    "(&(objectclass=sl45a.Foo)(counter=*))",
+    "(&(objectclass=sl45a.Foo)(!(level>=3)))"
+  };
+  std::map<std::string, Events> events;
+  std::vector<ListenerToken> tokens;
+  for (auto& filter : filters)
+  {
+    tokens.push_back(context.AddServiceListener(
+        [&events, filter](const ServiceEvent& evt) { events[filter].push_back(evt.GetType()); }, filter));
+  }
+  std::map<std::string, Events> expected;
+
+  auto reg = context.RegisterService(
+      std::make_shared<InterfaceMap>(InterfaceMap{ { "sl45a.Foo", std::make_shared<int>(0) } }),
+      ServiceProperties{ { "level", 1 }, { "counter", 0 } });
+  expected[filters[1]].push_back(ServiceEvent::SERVICE_REGISTERED);
+  expected[filters[2]].push_back(ServiceEvent::SERVICE_REGISTERED);
+  expected[filters[3]].push_back(ServiceEvent::SERVICE_REGISTERED);
+  US_TEST_CONDITION(events == expected, "Events for a registered service")
+
+  // Only a key no filter depends on changes
+  reg.SetProperties(ServiceProperties{ { "level", 1 }, { "counter", 1 } });
+  expected[filters[1]].push_back(ServiceEvent::SERVICE_MODIFIED);
+  expected[filters[2]].push_back(ServiceEvent::SERVICE_MODIFIED);
+  expected[filters[3]].push_back(ServiceEvent::SERVICE_MODIFIED);
+  US_TEST_CONDITION(events == expected, "Events for a modified unrelated property")
+
+  reg.SetProperties(ServiceProperties{ { "level", 5 }, { "counter", 1 } });
+  expected[filters[0]].push_back(ServiceEvent::SERVICE_MODIFIED);
+  expected[filters[1]].push_back(ServiceEvent::SERVICE_MODIFIED);
+  expected[filters[2]].push_back(ServiceEvent::SERVICE_MODIFIED);
+  expected[filters[3]].push_back(ServiceEvent::SERVICE_MODIFIED_ENDMATCH);
+  US_TEST_CONDITION(events == expected, "Events for a modified filter property")
+
+  reg.SetProperties(ServiceProperties{ { "level", 5 } });
+  expected[filters[0]].push_back(ServiceEvent::SERVICE_MODIFIED);
+  expected[filters[1]].push_back(ServiceEvent::SERVICE_MODIFIED);
+  expected[filters[2]].push_back(ServiceEvent::SERVICE_MODIFIED_ENDMATCH);
+  US_TEST_CONDITION(events == expected, "Events for a removed filter property")
+
+  // A hook hiding the modification from one listener
+  struct HidingHook : public ServiceEventListenerHook
+  {
+    std::string hidden;
+    void Event(const ServiceEvent& evt, ShrinkableMapType& listeners)
+    {
+      if (evt.GetType() != ServiceEvent::SERVICE_MODIFIED) return;
+      for (auto& l : listeners)
+      {
+        for (auto iter = l.second.begin(); iter != l.second.end(); ++iter)
+        {
+          if (iter->GetFilter() == hidden)
+          {
+            l.second.erase(iter);
+            break;
+          }
+        }
+      }
+    }
+  };
+  auto hook = std::make_shared<HidingHook>();
+  hook->hidden = filters[1];
+  auto hookReg = context.RegisterService<ServiceEventListenerHook>(hook);
+  reg.SetProperties(ServiceProperties{ { "level", 5 }, { "counter", 2 } });
+  expected[filters[0]].push_back(ServiceEvent::SERVICE_MODIFIED);
+  expected[filters[1]].push_back(ServiceEvent::SERVICE_MODIFIED_ENDMATCH);
+  expected[filters[2]].push_back(ServiceEvent::SERVICE_MODIFIED);
+  US_TEST_CONDITION(events == expected, "Events for a modified service with an event listener hook")
+  hookReg.Unregister();
+
+  framework.Stop();
+  framework.WaitForStop(std::chrono::milliseconds::zero());
+}
+
+#ifdef US_ENABLE_THREADING_SUPPORT
+
+void frameSL50a(const Framework& framework)
+{
+  auto context = framework.GetBundleContext();
+
+  typedef std::vector<ServiceEvent::Type> Events;
+  AsyncServiceListener level;
+  AsyncServiceListener foo;
+  auto levelToken = context.AddServiceListener(
+      std::bind(&AsyncServiceListener::ServiceChanged, &level, std::placeholders::_1),
+      "(&(objectclass=sl50a.Foo)(level>=3))");
+  auto fooToken = context.AddServiceListener(
+      std::bind(&AsyncServiceListener::ServiceChanged, &foo, std::placeholders::_1), "(objectclass=sl50a.Foo)");
+  auto getEvents = [](AsyncServiceListener& l) {
+    std::lock_guard<std::mutex> lock(l.mutex);
+    return l.events;
+  };
+
+  auto reg = context.RegisterService(
+      std::make_shared<InterfaceMap>(InterfaceMap{ { "sl50a.Foo", std::make_shared<int>(0) } }),
+      ServiceProperties{ { "level", 5 } });
+
+  // Deferred modifications change the properties immediately
+  const std::chrono::milliseconds longDelay(std::chrono::minutes(1));
+  for (int i = 1; i <= 4; ++i)
+  {
+    reg.SetProperties(ServiceProperties{ { "level", i } }, longDelay);
+  }
+  US_TEST_CONDITION(reg.GetReference().GetProperty("level") == 4, "Deferred modification of properties")
+  US_TEST_CONDITION(getEvents(foo) == Events({ ServiceEvent::SERVICE_REGISTERED }), "Deferred modified events")
+
+  // A modification without delay fires the deferred events with it,
+  // matched against the properties before the first deferred one
+  reg.SetProperties(ServiceProperties{ { "level", 1 } });
+  US_TEST_CONDITION(getEvents(foo) == Events({ ServiceEvent::SERVICE_REGISTERED, ServiceEvent::SERVICE_MODIFIED }),
+                    "Coalesced modified event")
+  US_TEST_CONDITION(getEvents(level) ==
+                      Events({ ServiceEvent::SERVICE_REGISTERED, ServiceEvent::SERVICE_MODIFIED_ENDMATCH }),
+                    "Coalesced modified end match event")
+
+  // Deferred events are fired when the delay has elapsed
+  reg.SetProperties(ServiceProperties{ { "level", 5 } }, std::chrono::milliseconds(20));
+  reg.SetProperties(ServiceProperties{ { "level", 2 } }, std::chrono::milliseconds(20));
+  US_TEST_CONDITION_REQUIRED(foo.WaitForEvents(3), "Coalesced modified event after a delay")
+  US_TEST_CONDITION(getEvents(level).size() == 2, "No event for a listener matching neither before nor after")
+
+  // Deferred modifications made while the coalescer delivers the earlier
+  // ones are delivered too, when their own delay has elapsed
+  std::mutex lastMutex;
+  std::condition_variable lastCond;
+  int lastLevel = 0;
+  auto lastToken = context.AddServiceListener(
+      [&](const ServiceEvent& evt) {
+        std::lock_guard<std::mutex> lock(lastMutex);
+        lastLevel = any_cast<int>(evt.GetServiceReference().GetProperty("level"));
+        lastCond.notify_all();
+      },
+      "(objectclass=sl50a.Bar)");
+  auto barReg = context.RegisterService(
+      std::make_shared<InterfaceMap>(InterfaceMap{ { "sl50a.Bar", std::make_shared<int>(0) } }),
+      ServiceProperties{ { "level", 0 } });
+  int lostRounds = 0;
+  for (int round = 1; round <= 50; ++round)
+  {
+    int level = round * 100000;
+    const auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(5);
+    while (std::chrono::steady_clock::now() < end)
+    {
+      barReg.SetProperties(ServiceProperties{ { "level", ++level } }, std::chrono::milliseconds(1));
+    }
+    std::unique_lock<std::mutex> lock(lastMutex);
+    if (!lastCond.wait_for(lock, std::chrono::seconds(5), [&] { return lastLevel == level; }))
+    {
+      ++lostRounds;
+    }
+  }
+  US_TEST_CONDITION(lostRounds == 0, "No deferred modified events lost, lost rounds: " << lostRounds)
+  barReg.Unregister();
+  context.RemoveListener(std::move(lastToken));
+
+  // Unregistering fires deferred events first
+  reg.SetProperties(ServiceProperties{ { "level", 7 } }, longDelay);
+  reg.Unregister();
+  US_TEST_CONDITION(getEvents(level) == Events({ ServiceEvent::SERVICE_REGISTERED,
+                                                 ServiceEvent::SERVICE_MODIFIED_ENDMATCH,
+                                                 ServiceEvent::SERVICE_MODIFIED,
+                                                 ServiceEvent::SERVICE_UNREGISTERING }),
+                    "Deferred events before unregistering")
+
+  context.RemoveListener(std::move(levelToken));
+  context.RemoveListener(std::move(fooToken));
+}
+
+#endif
+
+// Add and remove many service listeners, by token, by member function and
+// by stopping the bundle which added them.
+void frameSL55a(const Framework& framework)
+{
+  auto context = framework.GetBundleContext();
+  const int listenerCount = 200;
+
+  std::vector<int> counts(listenerCount, 0);
+  std::vector<ListenerToken> tokens;
+  for (int i = 0; i < listenerCount; ++i)
+  {
+    tokens.push_back(context.AddServiceListener(
+        [&counts, i](const ServiceEvent& evt) {
+          if (evt.GetType() == ServiceEvent::SERVICE_REGISTERED) ++counts[i];
+        },
+        "(objectclass=sl55a.Foo)"));
+  }
+
+  // Remove every other listener by token, in reverse order
+  for (int i = listenerCount - 1; i >= 0; i -= 2)
+  {
+    context.RemoveListener(std::move(tokens[i]));
+  }
+
+  TestServiceListener sListen(context, false);
+  context.AddServiceListener(&sListen, &TestServiceListener::serviceChanged, "(objectclass=sl55a.Foo)");
+
+  auto bundle = testing::InstallLib(context, "TestBundleSL1");
+  bundle.Start();
+  int bundleCount = 0;
+  for (int i = 0; i < 10; ++i)
+  {
+    bundle.GetBundleContext().AddServiceListener(
+        [&bundleCount](const ServiceEvent&) { ++bundleCount; }, "(objectclass=sl55a.Foo)");
+  }
+
+  auto service = std::make_shared<TestServiceListener>(context);
+  auto reg = context.RegisterService(std::make_shared<InterfaceMap>(InterfaceMap{ { "sl55a.Foo", service } }));
+  reg.Unregister();
+  US_TEST_CONDITION(bundleCount == 20, "Bundle listeners called before bundle stop")
+
+  bool success = true;
+  for (int i = 0; i < listenerCount; ++i)
+  {
+    success = success && counts[i] == (i % 2 == 0 ? 1 : 0);
+  }
+  US_TEST_CONDITION(success, "Only the remaining listeners are called")
+  US_TEST_CONDITION(sListen.checkEvents({ ServiceEvent::SERVICE_REGISTERED,
+                                           ServiceEvent::SERVICE_UNREGISTERING }),
+                    "Member function listener called")
+
+  // Stopping the bundle removes all its listeners
+  bundle.Stop();
+  context.RemoveServiceListener(&sListen, &TestServiceListener::serviceChanged);
+  reg = context.RegisterService(std::make_shared<InterfaceMap>(InterfaceMap{ { "sl55a.Foo", service } }));
+  reg.Unregister();
+  US_TEST_CONDITION(bundleCount == 20, "Bundle listeners removed on bundle stop")
+  US_TEST_CONDITION(sListen.checkEvents({ ServiceEvent::SERVICE_REGISTERED,
+                                           ServiceEvent::SERVICE_UNREGISTERING }),
+                    "Member function listener removed")
+
+  success = true;
+  for (int i = 0; i < listenerCount; ++i)
+  {
+    success = success && counts[i] == (i % 2 == 0 ? 2 : 0);
+  }
+  US_TEST_CONDITION(success, "Remaining listeners called again")
+
+  for (int i = 0; i < listenerCount; i += 2)
+  {
+    context.RemoveListener(std::move(tokens[i]));
+  }
+}
+
+#ifdef US_ENABLE_THREADING_SUPPORT
+
+// Call the synchronous listeners of different bundles in parallel.
+void frameSL60a()
+{
+  FrameworkFactory factory;
+  std::map<std::string, Any> frameworkProps;
+  frameworkProps[Constants::FRAMEWORK_SERVICE_LISTENER_PARALLEL_THREADS] = 2;
+  auto framework = factory.NewFramework(frameworkProps);
+  framework.Start();
+  auto context = framework.GetBundleContext();
+
+  auto bundleA = testing::InstallLib(context, "TestBundleA");
+  auto bundleA2 = testing::InstallLib(context, "TestBundleA2");
+  bundleA.Start();
+  bundleA2.Start();
+  std::vector<BundleContext> contexts = { context, bundleA.GetBundleContext(), bundleA2.GetBundleContext() };
+
+  // The first listener called in each bundle waits for the other bundles,
+  // which only succeeds if the bundles' listeners are called in parallel.
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::size_t entered = 0;
+  bool allEntered = true;
+  std::vector<std::vector<std::thread::id>> threads(contexts.size());
+  std::size_t nestedCalls = 0;
+  for (std::size_t i = 0; i < contexts.size(); ++i)
+  {
+    for (int j = 0; j < 2; ++j)
+    {
+      contexts[i].AddServiceListener(
+          [&, i](const ServiceEvent& evt) {
+            if (evt.GetType() != ServiceEvent::SERVICE_REGISTERED) return;
+            std::unique_lock<std::mutex> l(mutex);
+            threads[i].push_back(std::this_thread::get_id());
+            if (threads[i].size() == 1)
+            {
+              ++entered;
+              cond.notify_all();
+              allEntered = cond.wait_for(l, std::chrono::seconds(10),
+                                         [&] { return entered == contexts.size(); }) && allEntered;
+            }
+          },
+          "(objectclass=sl60a.Foo)");
+    }
+    contexts[i].AddServiceListener(
+        [&](const ServiceEvent& evt) {
+          if (evt.GetType() == ServiceEvent::SERVICE_REGISTERED)
+          {
+            std::lock_guard<std::mutex> l(mutex);
+            ++nestedCalls;
+          }
+        },
+        "(objectclass=sl60a.Bar)");
+  }
+
+  // A listener registering a service fans out the nested event as well.
+  ServiceRegistrationU nestedReg;
+  auto nestedToken = bundleA.GetBundleContext().AddServiceListener(
+      [&](const ServiceEvent& evt) {
+        if (evt.GetType() == ServiceEvent::SERVICE_REGISTERED)
+        {
+          nestedReg = contexts[1].RegisterService(
+              std::make_shared<InterfaceMap>(InterfaceMap{ { "sl60a.Bar", std::make_shared<int>(0) } }));
+        }
+      },
+      "(objectclass=sl60a.Foo)");
+
+  auto reg = context.RegisterService(
+      std::make_shared<InterfaceMap>(InterfaceMap{ { "sl60a.Foo", std::make_shared<int>(0) } }));
+  {
+    std::lock_guard<std::mutex> l(mutex);
+    US_TEST_CONDITION(allEntered, "Listeners of different bundles called in parallel")
+    bool inOrder = true;
+    for (auto& bundleThreads : threads)
+    {
+      inOrder = inOrder && bundleThreads.size() == 2 && bundleThreads[0] == bundleThreads[1];
+    }
+    US_TEST_CONDITION(inOrder, "Listeners of a bundle called on one thread before the registration returns")
+    US_TEST_CONDITION(nestedCalls == contexts.size(), "Nested event delivered before the registration returns")
+  }
+
+  bundleA.GetBundleContext().RemoveListener(std::move(nestedToken));
+  nestedReg.Unregister();
+  reg.Unregister();
+  framework.Stop();
+  framework.WaitForStop(std::chrono::milliseconds::zero());
+}
+
+#endif
+
+// Record listener call durations and warn about slow listeners.
+void frameSL65a()
+{
+  FrameworkFactory factory;
+  std::map<std::string, Any> frameworkProps;
+  frameworkProps[Constants::FRAMEWORK_LISTENER_STATISTICS] = true;
+  frameworkProps[Constants::FRAMEWORK_LISTENER_WARNING_THRESHOLD] = 20;
+  auto framework = factory.NewFramework(frameworkProps);
+  framework.Start();
+  auto context = framework.GetBundleContext();
+
+  std::vector<std::string> warnings;
+  auto fwToken = context.AddFrameworkListener([&warnings](const FrameworkEvent& evt) {
+    if (evt.GetType() == FrameworkEvent::Type::FRAMEWORK_WARNING) warnings.push_back(evt.GetMessage());
+  });
+  auto fastToken = context.AddServiceListener([](const ServiceEvent&) {}, "(objectclass=sl65a.Foo)");
+  auto slowToken = context.AddServiceListener(
+      [](const ServiceEvent& evt) {
+        if (evt.GetType() == ServiceEvent::SERVICE_REGISTERED)
+          std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      },
+      "(&(objectclass=sl65a.Foo)(slow=true))");
+  int bundleEvents = 0;
+  auto bundleToken = context.AddBundleListener([&bundleEvents](const BundleEvent&) { ++bundleEvents; });
+
+  auto reg = context.RegisterService(
+      std::make_shared<InterfaceMap>(InterfaceMap{ { "sl65a.Foo", std::make_shared<int>(0) } }),
+      ServiceProperties{ { "slow", std::string("true") } });
+  reg.Unregister();
+  auto bundle = testing::InstallLib(context, "TestBundleA");
+
+  US_TEST_CONDITION(std::count_if(warnings.begin(), warnings.end(), [](const std::string& msg) {
+                      return msg.find("(slow=true)") != std::string::npos;
+                    }) == 1,
+                    "Warning for the slow listener")
+
+  auto stats = framework.GetListenerStatistics();
+  // The framework adds a service listener for hooks as well.
+  const std::size_t statsCount = stats.size();
+  US_TEST_CONDITION(statsCount == 5, "Statistics of all listeners")
+  for (auto& s : stats)
+  {
+    if (s.type == ListenerStatistics::Type::SERVICE_LISTENER && s.filter.find("slow") != std::string::npos)
+    {
+      US_TEST_CONDITION(s.calls == 2 && s.bundle == framework, "Slow listener calls")
+      US_TEST_CONDITION(s.max >= std::chrono::milliseconds(50) && s.p99 == s.max && s.total >= s.max,
+                        "Slow listener maximum and 99th percentile")
+      US_TEST_CONDITION(s.median < std::chrono::milliseconds(50), "Slow listener median")
+    }
+    else if (s.type == ListenerStatistics::Type::SERVICE_LISTENER && s.filter.find("sl65a") != std::string::npos)
+    {
+      US_TEST_CONDITION(s.calls == 2 && s.filter == "(objectclass=sl65a.Foo)", "Fast listener calls")
+      US_TEST_CONDITION(s.median <= s.p99 && s.p99 <= s.max, "Fast listener percentiles")
+    }
+    else if (s.type == ListenerStatistics::Type::BUNDLE_LISTENER)
+    {
+      US_TEST_CONDITION(s.calls == static_cast<std::uint64_t>(bundleEvents) && s.calls > 0, "Bundle listener calls")
+    }
+    else if (s.type == ListenerStatistics::Type::FRAMEWORK_LISTENER)
+    {
+      US_TEST_CONDITION(s.calls > 0 && s.filter.empty(), "Framework listener calls")
+    }
+  }
+
+  context.RemoveListener(std::move(slowToken));
+  US_TEST_CONDITION(framework.GetListenerStatistics().size() == statsCount - 1, "No statistics for removed listeners")
+
+  context.RemoveListener(std::move(fastToken));
+  context.RemoveListener(std::move(bundleToken));
+  context.RemoveListener(std::move(fwToken));
+  framework.Stop();
+  framework.WaitForStop(std::chrono::milliseconds::zero());
+}
+
 int ServiceListenerTest(int /*argc*/, char* /*argv*/[])
 {
   US_TEST_BEGIN("ServiceListenerTest");
@@ -554,6 +1270,20 @@ int ServiceListenerTest(int /*argc*/, char* /*argv*/[])
   frameSL05a(framework);
   frameSL10a(framework);
   frameSL25a(framework);
+#ifdef US_ENABLE_THREADING_SUPPORT
+  frameSL30a();
+#endif
+  frameSL35a();
+  frameSL40a(framework);
+  frameSL45a();
+#ifdef US_ENABLE_THREADING_SUPPORT
+  frameSL50a(framework);
+#endif
+  frameSL55a(framework);
+#ifdef US_ENABLE_THREADING_SUPPORT
+  frameSL60a();
+#endif
+  frameSL65a();
 
   US_TEST_END()
 }
@@ -21,14 +21,21 @@
 =============================================================================*/
 
 #include "cppmicroservices/BundleContext.h"
+#include "cppmicroservices/Constants.h"
+#include "cppmicroservices/FrameworkEvent.h"
 #include "cppmicroservices/FrameworkFactory.h"
 #include "cppmicroservices/Framework.h"
 #include "cppmicroservices/GetBundleContext.h"
 #include "cppmicroservices/ServiceEvent.h"
+#include "cppmicroservices/ServiceEventListenerHook.h"
+#include "cppmicroservices/ServiceFindHook.h"
 
 #include "TestingMacros.h"
 #include "TestUtils.h"
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
 #include <vector>
 
 using namespace cppmicroservices;
@@ -58,6 +65,7 @@ private:
   std::size_t nModified;
 
   std::vector<ServiceRegistration<IPerfTestService> > regs;
+  std::vector<ServiceRegistrationU> batchRegs;
   std::vector<MyServiceListener*> listeners;
   std::vector<std::shared_ptr<IPerfTestService>> services;
 
@@ -70,10 +78,25 @@ public:
 
   void TestAddListeners();
   void TestRegisterServices();
+  void TestRegisterServicesBatch();
+  void TestPidLookups();
+  void TestHookOverhead();
+  void TestManyListenerEvents();
+  void TestSharedFilterEvaluation();
+  void TestModifyUnrelatedProperty();
+  void TestListenerChurn();
+#ifdef US_ENABLE_THREADING_SUPPORT
+  void TestConcurrentLookups();
+#endif
 
   void TestModifyServices();
   void TestUnregisterServices();
 
+  void TestShardedRegistryScaling();
+#ifdef US_ENABLE_THREADING_SUPPORT
+  void TestConcurrentWriters();
+#endif
+
 private:
 
   std::ostream& Log() const
@@ -83,8 +106,10 @@ private:
 
   void AddListeners(int n);
   void RegisterServices(int n);
+  void RegisterServicesBatch(int n);
   void ModifyServices();
   void UnregisterServices();
+  long long LookupAndModify(int n);
 
 };
 
@@ -224,6 +249,353 @@ void ServiceRegistryPerformanceTest::RegisterServices(int n)
   }
 }
 
+void ServiceRegistryPerformanceTest::TestRegisterServicesBatch()
+{
+  Log() << "Register services in one batch, and check that we get #of services ("
+        << nServices << ") * #of listeners (" << nListeners << ")  SERVICE_REGISTERED events\n";
+  Log() << "registering " << nServices << " services, listener count=" << listeners.size() << "\n";
+
+  HighPrecisionTimer t;
+  t.Start();
+  RegisterServicesBatch(nServices);
+  long long ms = t.ElapsedMilli();
+  Log() << "batch register took " << ms << "ms\n";
+  US_TEST_CONDITION_REQUIRED(nServices * listeners.size() == nRegistered,
+                             "# SERVICE_REGISTERED events must be same as # of registered services  * # of listeners");
+}
+
+void ServiceRegistryPerformanceTest::RegisterServicesBatch(int n)
+{
+  class PerfTestService : public IPerfTestService
+  {
+  };
+
+  std::string pid("my.service.");
+
+  std::vector<std::pair<InterfaceMapConstPtr, ServiceProperties> > batch;
+  for(int i = 0; i < n; i++)
+  {
+    ServiceProperties props;
+    std::stringstream ss;
+    ss << pid << i;
+    props["service.pid"] = ss.str();
+    props["perf.service.value"] = i+1;
+
+    services.emplace_back(std::make_shared<PerfTestService>());
+    batch.push_back(std::make_pair(MakeInterfaceMap<IPerfTestService>(services.back()), props));
+  }
+
+  batchRegs = context.RegisterServices(batch);
+}
+
+void ServiceRegistryPerformanceTest::TestPidLookups()
+{
+  Log() << "Look up each registered service by its service.pid\n";
+
+  std::size_t nFound = 0;
+  HighPrecisionTimer t;
+  t.Start();
+  for (int i = 0; i < nServices; ++i)
+  {
+    std::stringstream ss;
+    ss << "(" << Constants::SERVICE_PID << "=my.service." << i << ")";
+    nFound += context.GetServiceReferences("", ss.str()).size();
+  }
+  long long ms = t.ElapsedMilli();
+  Log() << nServices << " pid lookups took " << ms << "ms\n";
+  US_TEST_CONDITION_REQUIRED(nFound == static_cast<std::size_t>(nServices), "Each pid lookup must find exactly one service")
+}
+
+long long ServiceRegistryPerformanceTest::LookupAndModify(int n)
+{
+  const std::string filter = "(" + Constants::SERVICE_PID + "=my.service.0)";
+  ServiceRegistration<IPerfTestService> reg = regs.front();
+  ServiceProperties props;
+  props["service.pid"] = std::string("my.service.0");
+  props["perf.service.value"] = 1;
+
+  std::size_t nFound = 0;
+  HighPrecisionTimer t;
+  t.Start();
+  for (int i = 0; i < n; ++i)
+  {
+    nFound += context.GetServiceReferences<IPerfTestService>(filter).size();
+    reg.SetProperties(props);
+  }
+  long long us = t.ElapsedMicro();
+  US_TEST_CONDITION_REQUIRED(nFound == static_cast<std::size_t>(n), "Each lookup must find exactly one service")
+  return us;
+}
+
+void ServiceRegistryPerformanceTest::TestHookOverhead()
+{
+  Log() << "Compare the cost of a lookup and a SERVICE_MODIFIED event with and without service hooks\n";
+
+  struct NoopFindHook : public ServiceFindHook
+  {
+    void Find(const BundleContext&, const std::string&, const std::string&,
+              ShrinkableVector<ServiceReferenceBase>&) {}
+  };
+
+  struct NoopEventListenerHook : public ServiceEventListenerHook
+  {
+    void Event(const ServiceEvent&, ShrinkableMapType&) {}
+  };
+
+  const int n = 1000;
+  const std::size_t modified = nModified;
+
+  long long noHooks = LookupAndModify(n);
+
+  auto findReg = context.RegisterService<ServiceFindHook>(std::make_shared<NoopFindHook>());
+  auto eventReg = context.RegisterService<ServiceEventListenerHook>(std::make_shared<NoopEventListenerHook>());
+  long long withHooks = LookupAndModify(n);
+  findReg.Unregister();
+  eventReg.Unregister();
+
+  Log() << n << " lookups and events without hooks took " << noHooks / 1000 << "ms ("
+        << noHooks * 1000 / n << "ns each), with no-op hooks " << withHooks / 1000 << "ms ("
+        << withHooks * 1000 / n << "ns each)\n";
+
+  nModified = modified;
+}
+
+void ServiceRegistryPerformanceTest::TestManyListenerEvents()
+{
+  const int nOther = 5000;
+  const int n = 1000;
+  Log() << "Modify a service " << n << " times with " << nOther
+        << " service listeners for other services, with and without an event listener hook\n";
+
+  struct NoopEventListenerHook : public ServiceEventListenerHook
+  {
+    void Event(const ServiceEvent&, ShrinkableMapType&) {}
+  };
+
+  std::vector<ListenerToken> tokens;
+  for (int i = 0; i < nOther; ++i)
+  {
+    std::stringstream ss;
+    ss << "(" << Constants::OBJECTCLASS << "=perf.Other" << i << ")";
+    tokens.push_back(context.AddServiceListener([](const ServiceEvent&) {}, ss.str()));
+  }
+
+  ServiceRegistration<IPerfTestService> reg = regs.front();
+  ServiceProperties props;
+  props["service.pid"] = std::string("my.service.0");
+  const std::size_t modified = nModified;
+
+  HighPrecisionTimer t;
+  t.Start();
+  for (int i = 0; i < n; ++i)
+  {
+    reg.SetProperties(props);
+  }
+  long long noHook = t.ElapsedMicro();
+
+  auto hookReg = context.RegisterService<ServiceEventListenerHook>(std::make_shared<NoopEventListenerHook>());
+  t.Start();
+  for (int i = 0; i < n; ++i)
+  {
+    reg.SetProperties(props);
+  }
+  long long withHook = t.ElapsedMicro();
+  hookReg.Unregister();
+
+  for (auto& token : tokens)
+  {
+    context.RemoveListener(std::move(token));
+  }
+
+  Log() << n << " events took " << noHook / 1000 << "ms (" << noHook * 1000 / n << "ns each) without hooks, "
+        << withHook / 1000 << "ms (" << withHook * 1000 / n << "ns each) with a no-op event listener hook\n";
+  nModified = modified;
+}
+
+void ServiceRegistryPerformanceTest::TestSharedFilterEvaluation()
+{
+  const int nListeners = 5000;
+  const int n = 1000;
+  Log() << "Modify a service " << n << " times with " << nListeners
+        << " service listeners whose filters share or do not share sub-expressions\n";
+
+  ServiceRegistration<IPerfTestService> reg = regs.front();
+  ServiceProperties props;
+  props["service.pid"] = std::string("my.service.0");
+  props["env"] = std::string("prod");
+  props["level"] = 5;
+  const std::size_t modified = nModified;
+
+  for (int shared = 1; shared >= 0; --shared)
+  {
+    std::vector<ListenerToken> tokens;
+    for (int i = 0; i < nListeners; ++i)
+    {
+      // Shared filters only differ in a few distinct levels
+      std::stringstream ss;
+      ss << "(&(" << Constants::OBJECTCLASS << "=perf.Other)(env=prod)(level>=" << (shared ? i % 10 : i) << "))";
+      tokens.push_back(context.AddServiceListener([](const ServiceEvent&) {}, ss.str()));
+    }
+
+    HighPrecisionTimer t;
+    t.Start();
+    for (int i = 0; i < n; ++i)
+    {
+      reg.SetProperties(props);
+    }
+    long long elapsed = t.ElapsedMicro();
+
+    for (auto& token : tokens)
+    {
+      context.RemoveListener(std::move(token));
+    }
+
+    Log() << n << " events took " << elapsed / 1000 << "ms (" << elapsed * 1000 / n << "ns each) with "
+          << (shared ? "shared" : "distinct") << " sub-expressions\n";
+  }
+  nModified = modified;
+}
+
+void ServiceRegistryPerformanceTest::TestModifyUnrelatedProperty()
+{
+  const int nListeners = 5000;
+  const int n = 1000;
+  Log() << "Modify a service " << n << " times with " << nListeners
+        << " service listeners depending or not depending on the modified property\n";
+
+  std::vector<ListenerToken> tokens;
+  for (int i = 0; i < nListeners; ++i)
+  {
+    std::stringstream ss;
+    ss << "(&(env=prod)(level>=" << i << "))";
+    tokens.push_back(context.AddServiceListener([](const ServiceEvent&) {}, ss.str()));
+  }
+
+  ServiceRegistration<IPerfTestService> reg = regs.front();
+  ServiceProperties props;
+  props["service.pid"] = std::string("my.service.0");
+  props["env"] = std::string("prod");
+  props["level"] = 5;
+  reg.SetProperties(props);
+  const std::size_t modified = nModified;
+
+  HighPrecisionTimer t;
+  t.Start();
+  for (int i = 0; i < n; ++i)
+  {
+    props["counter"] = i;
+    reg.SetProperties(props);
+  }
+  long long unrelated = t.ElapsedMicro();
+
+  t.Start();
+  for (int i = 0; i < n; ++i)
+  {
+    props["level"] = i % 10;
+    reg.SetProperties(props);
+  }
+  long long related = t.ElapsedMicro();
+
+  for (auto& token : tokens)
+  {
+    context.RemoveListener(std::move(token));
+  }
+
+  Log() << n << " events took " << unrelated / 1000 << "ms (" << unrelated * 1000 / n
+        << "ns each) for an unrelated property, " << related / 1000 << "ms (" << related * 1000 / n
+        << "ns each) for a filter property\n";
+  nModified = modified;
+}
+
+void ServiceRegistryPerformanceTest::TestListenerChurn()
+{
+  const int nListeners = 5000;
+  const int n = 1000;
+  Log() << "Alternately add or remove a service listener and modify a service " << n << " times with "
+        << nListeners << " service listeners for other services\n";
+
+  std::vector<ListenerToken> tokens;
+  for (int i = 0; i < nListeners; ++i)
+  {
+    std::stringstream ss;
+    ss << "(" << Constants::OBJECTCLASS << "=perf.Other" << i << ")";
+    tokens.push_back(context.AddServiceListener([](const ServiceEvent&) {}, ss.str()));
+  }
+
+  ServiceRegistration<IPerfTestService> reg = regs.front();
+  ServiceProperties props;
+  props["service.pid"] = std::string("my.service.0");
+  const std::size_t modified = nModified;
+
+  HighPrecisionTimer t;
+  t.Start();
+  for (int i = 0; i < n; ++i)
+  {
+    reg.SetProperties(props);
+  }
+  long long eventsOnly = t.ElapsedMicro();
+
+  t.Start();
+  for (int i = 0; i < n; ++i)
+  {
+    if (i % 2 == 0)
+    {
+      std::stringstream ss;
+      ss << "(" << Constants::OBJECTCLASS << "=perf.Churn" << i << ")";
+      tokens.push_back(context.AddServiceListener([](const ServiceEvent&) {}, ss.str()));
+    }
+    else
+    {
+      context.RemoveListener(std::move(tokens[static_cast<std::size_t>(i)]));
+    }
+    reg.SetProperties(props);
+  }
+  long long churn = t.ElapsedMicro();
+
+  for (auto& token : tokens)
+  {
+    context.RemoveListener(std::move(token));
+  }
+
+  Log() << n << " events took " << eventsOnly / 1000 << "ms (" << eventsOnly * 1000 / n << "ns each), "
+        << n << " listener changes and events took " << churn / 1000 << "ms (" << churn * 1000 / n << "ns each)\n";
+  nModified = modified;
+}
+
+#ifdef US_ENABLE_THREADING_SUPPORT
+void ServiceRegistryPerformanceTest::TestConcurrentLookups()
+{
+  Log() << "Look up services concurrently and report the lookup throughput for an increasing number of threads\n";
+
+  const std::size_t nLookups = 200;
+  const std::size_t maxThreads = std::max(8u, std::thread::hardware_concurrency());
+  for (std::size_t nThreads = 1; nThreads <= maxThreads; nThreads *= 2)
+  {
+    std::atomic<std::size_t> nFound(0);
+    std::vector<std::thread> threads;
+
+    HighPrecisionTimer t;
+    t.Start();
+    for (std::size_t i = 0; i < nThreads; ++i)
+    {
+      threads.emplace_back([this, nLookups, &nFound]()
+      {
+        for (std::size_t j = 0; j < nLookups; ++j)
+        {
+          if (context.GetServiceReference<IPerfTestService>()) ++nFound;
+        }
+      });
+    }
+    for (auto& th : threads) th.join();
+    long long us = t.ElapsedMicro();
+
+    Log() << nThreads << " thread(s): " << nThreads * nLookups << " lookups took " << us / 1000 << "ms ("
+          << (us > 0 ? static_cast<long long>(nThreads * nLookups) * 1000000 / us : 0) << " lookups/s)\n";
+    US_TEST_CONDITION_REQUIRED(nFound == nThreads * nLookups, "All concurrent lookups must find a service")
+  }
+}
+#endif
+
 void ServiceRegistryPerformanceTest::TestModifyServices()
 {
   Log() << "Modify all services, and check that we get #of services ("
@@ -267,7 +639,7 @@ void ServiceRegistryPerformanceTest::TestUnregisterServices()
 
 void ServiceRegistryPerformanceTest::UnregisterServices()
 {
-  Log() << "unregistering " << regs.size() << " services, listener count="
+  Log() << "unregistering " << regs.size() + batchRegs.size() << " services, listener count="
         << listeners.size() << "\n";
   for(std::size_t i = 0; i < regs.size(); i++)
   {
@@ -275,8 +647,166 @@ void ServiceRegistryPerformanceTest::UnregisterServices()
     reg.Unregister();
   }
   regs.clear();
+  for (auto& reg : batchRegs)
+  {
+    reg.Unregister();
+  }
+  batchRegs.clear();
 }
 
+namespace {
+
+// Register n services under nClasses interface names, looking up the best
+// service of another class after each registration, then unregister them.
+// Returns the elapsed time in milliseconds.
+long long RegisterLookupUnregister(std::size_t shards, std::size_t n, std::size_t nClasses)
+{
+  FrameworkFactory factory;
+  std::map<std::string, Any> frameworkProps;
+  frameworkProps[Constants::FRAMEWORK_SERVICE_REGISTRY_SHARDS] = shards;
+  auto framework = factory.NewFramework(frameworkProps);
+  framework.Start();
+  auto context = framework.GetBundleContext();
+
+  std::vector<std::string> classes;
+  for (std::size_t i = 0; i < nClasses; ++i)
+  {
+    std::stringstream ss;
+    ss << "perf.Interface" << i;
+    classes.push_back(ss.str());
+  }
+
+  auto service = std::make_shared<int>(0);
+  std::vector<ServiceRegistrationU> regs;
+  regs.reserve(n);
+  std::size_t nFound = 0;
+
+  HighPrecisionTimer t;
+  t.Start();
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    auto im = std::make_shared<InterfaceMap>();
+    im->insert(std::make_pair(classes[i % nClasses], service));
+    regs.push_back(context.RegisterService(im));
+    if (context.GetServiceReference(classes[(i + nClasses / 2) % nClasses])) ++nFound;
+  }
+  for (auto& reg : regs)
+  {
+    reg.Unregister();
+  }
+  long long ms = t.ElapsedMilli();
+
+  framework.Stop();
+  framework.WaitForStop(std::chrono::milliseconds::zero());
+
+  US_TEST_CONDITION_REQUIRED(nFound == (n > nClasses / 2 ? n - nClasses / 2 : 0), "Each lookup of a registered class must find a service")
+  return ms;
+}
+
+#ifdef US_ENABLE_THREADING_SUPPORT
+// Let nWriters threads register n services each under 16 classes of their
+// own and unregister them again, while nReaders threads look up a service.
+// Returns the elapsed time of the writers in microseconds and the number
+// of lookups done meanwhile.
+std::pair<long long, std::size_t> RegisterConcurrently(std::size_t nWriters, std::size_t nReaders, std::size_t n)
+{
+  FrameworkFactory factory;
+  std::map<std::string, Any> frameworkProps;
+  frameworkProps[Constants::FRAMEWORK_SERVICE_REGISTRY_SHARDS] = 16;
+  auto framework = factory.NewFramework(frameworkProps);
+  framework.Start();
+  auto context = framework.GetBundleContext();
+
+  auto service = std::make_shared<int>(0);
+  auto im = std::make_shared<InterfaceMap>();
+  im->insert(std::make_pair(std::string("perf.Reader"), service));
+  auto readerReg = context.RegisterService(im);
+
+  std::atomic<bool> done(false);
+  std::atomic<std::size_t> nLookups(0);
+  std::vector<std::thread> readers;
+  for (std::size_t i = 0; i < nReaders; ++i)
+  {
+    readers.emplace_back([&context, &done, &nLookups]()
+    {
+      std::size_t count = 0;
+      while (!done)
+      {
+        if (context.GetServiceReference("perf.Reader")) ++count;
+      }
+      nLookups += count;
+    });
+  }
+
+  HighPrecisionTimer t;
+  t.Start();
+  std::vector<std::thread> writers;
+  for (std::size_t w = 0; w < nWriters; ++w)
+  {
+    writers.emplace_back([&context, &service, w, n]()
+    {
+      std::vector<ServiceRegistrationU> regs;
+      regs.reserve(n);
+      for (std::size_t i = 0; i < n; ++i)
+      {
+        std::stringstream ss;
+        ss << "perf.Writer" << w << "." << i % 16;
+        auto writerIm = std::make_shared<InterfaceMap>();
+        writerIm->insert(std::make_pair(ss.str(), service));
+        regs.push_back(context.RegisterService(writerIm));
+      }
+      for (auto& reg : regs)
+      {
+        reg.Unregister();
+      }
+    });
+  }
+  for (auto& th : writers) th.join();
+  long long us = t.ElapsedMicro();
+  done = true;
+  for (auto& th : readers) th.join();
+
+  readerReg.Unregister();
+  framework.Stop();
+  framework.WaitForStop(std::chrono::milliseconds::zero());
+  return std::make_pair(us, nLookups.load());
+}
+#endif
+
+}
+
+void ServiceRegistryPerformanceTest::TestShardedRegistryScaling()
+{
+  Log() << "Compare registering, looking up and unregistering services with 1 and 16 registry shards\n";
+
+  const std::size_t nClasses = 1000;
+  for (std::size_t n = 1000; n <= 100000; n *= 10)
+  {
+    long long one = RegisterLookupUnregister(1, n, nClasses);
+    long long sixteen = RegisterLookupUnregister(16, n, nClasses);
+    Log() << n << " services of " << nClasses << " classes: 1 shard took " << one << "ms, 16 shards took "
+          << sixteen << "ms\n";
+  }
+}
+
+#ifdef US_ENABLE_THREADING_SUPPORT
+void ServiceRegistryPerformanceTest::TestConcurrentWriters()
+{
+  Log() << "Register and unregister services concurrently with 16 registry shards and 2 threads looking up "
+           "services, and report the writer throughput for an increasing number of writer threads\n";
+
+  const std::size_t n = 2000;
+  const std::size_t maxThreads = std::max(8u, std::thread::hardware_concurrency());
+  for (std::size_t nWriters = 1; nWriters <= maxThreads; nWriters *= 2)
+  {
+    auto result = RegisterConcurrently(nWriters, 2, n);
+    const long long us = result.first;
+    Log() << nWriters << " writer(s): " << nWriters * n << " registrations and unregistrations took " << us / 1000
+          << "ms (" << (us > 0 ? static_cast<long long>(nWriters * n) * 1000000 / us : 0) << " services/s), "
+          << result.second << " concurrent lookups\n";
+  }
+}
+#endif
 
 int ServiceRegistryPerformanceTest(int /*argc*/, char* /*argv*/[])
 {
@@ -290,9 +820,28 @@ int ServiceRegistryPerformanceTest(int /*argc*/, char* /*argv*/[])
   perfTest.InitTestCase();
   perfTest.TestAddListeners();
   perfTest.TestRegisterServices();
+  perfTest.TestPidLookups();
+  perfTest.TestHookOverhead();
+  perfTest.TestManyListenerEvents();
+  perfTest.TestSharedFilterEvaluation();
+  perfTest.TestModifyUnrelatedProperty();
+  perfTest.TestListenerChurn();
+#ifdef US_ENABLE_THREADING_SUPPORT
+  perfTest.TestConcurrentLookups();
+#endif
   perfTest.TestModifyServices();
   perfTest.TestUnregisterServices();
+
+  perfTest.InitTestCase();
+  perfTest.TestRegisterServicesBatch();
+  perfTest.TestPidLookups();
+  perfTest.TestUnregisterServices();
   perfTest.CleanupTestCase();
 
+  perfTest.TestShardedRegistryScaling();
+#ifdef US_ENABLE_THREADING_SUPPORT
+  perfTest.TestConcurrentWriters();
+#endif
+
   US_TEST_END()
 }
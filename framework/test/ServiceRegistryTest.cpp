@@ -23,9 +23,12 @@
 #include "cppmicroservices/BundleContext.h"
 #include "cppmicroservices/Constants.h"
 #include "cppmicroservices/Framework.h"
+#include "cppmicroservices/FrameworkEvent.h"
 #include "cppmicroservices/FrameworkFactory.h"
 #include "cppmicroservices/GetBundleContext.h"
 #include "cppmicroservices/LDAPFilter.h"
+#include "cppmicroservices/ServiceEvent.h"
+#include "cppmicroservices/ServiceFindHook.h"
 #include "cppmicroservices/ServiceInterface.h"
 
 #include "TestingMacros.h"
@@ -51,6 +54,12 @@ void TestServiceInterfaceId()
   US_TEST_CONDITION(us_service_interface_iid<int>() == "int", "Service interface id int")
   US_TEST_CONDITION(us_service_interface_iid<ITestServiceA>() == "ITestServiceA", "Service interface id ITestServiceA")
   US_TEST_CONDITION(us_service_interface_iid<ITestServiceB>() == "com.mycompany.ITestService/1.0", "Service interface id com.mycompany.ITestService/1.0")
+
+  const std::string& idA = detail::GetServiceInterfaceId<ITestServiceA>();
+  US_TEST_CONDITION(idA == us_service_interface_iid<ITestServiceA>(), "Cached service interface id ITestServiceA")
+  US_TEST_CONDITION(&idA == &detail::GetServiceInterfaceId<ITestServiceA>(), "Service interface id ITestServiceA computed once")
+  US_TEST_CONDITION(detail::GetServiceInterfaceId<ITestServiceB>() == "com.mycompany.ITestService/1.0", "Cached declared service interface id")
+  US_TEST_CONDITION(detail::GetServiceInterfaceId<void>().empty(), "Cached service interface id void")
 }
 
 void TestMultipleServiceRegistrations(BundleContext context)
@@ -134,6 +143,452 @@ void TestServicePropertiesUpdate(BundleContext context)
   US_TEST_CONDITION_REQUIRED(context.GetServiceReferences<ITestServiceA>().empty(), "Testing service count")
 }
 
+void TestRegisterServicesBatch(BundleContext context)
+{
+  struct TestServiceA : public ITestServiceA
+  {
+  };
+
+  std::vector<long> registeredIds;
+  auto token = context.AddServiceListener([&registeredIds](const ServiceEvent& evt)
+  {
+    if (evt.GetType() == ServiceEvent::SERVICE_REGISTERED)
+    {
+      registeredIds.push_back(any_cast<long>(evt.GetServiceReference().GetProperty(Constants::SERVICE_ID)));
+    }
+  }, "(objectclass=ITestServiceA)");
+
+  std::vector<std::pair<InterfaceMapConstPtr, ServiceProperties> > batch;
+  for (int ranking : { 1, 3, 2 })
+  {
+    ServiceProperties props;
+    props[Constants::SERVICE_RANKING] = ranking;
+    batch.push_back(std::make_pair(MakeInterfaceMap<ITestServiceA>(std::make_shared<TestServiceA>()), props));
+  }
+
+  auto regs = context.RegisterServices(batch);
+  US_TEST_CONDITION_REQUIRED(regs.size() == 3, "Testing batch registration count")
+  US_TEST_CONDITION(context.GetServiceReferences<ITestServiceA>().size() == 3, "Testing service count after batch registration")
+  US_TEST_CONDITION(any_cast<int>(context.GetServiceReference<ITestServiceA>().GetProperty(Constants::SERVICE_RANKING)) == 3,
+                    "Testing ranking order after batch registration")
+
+  bool inOrder = registeredIds.size() == regs.size();
+  for (std::size_t i = 0; inOrder && i < regs.size(); ++i)
+  {
+    inOrder = any_cast<long>(regs[i].GetReference().GetProperty(Constants::SERVICE_ID)) == registeredIds[i];
+  }
+  US_TEST_CONDITION(inOrder, "Testing SERVICE_REGISTERED events in batch order")
+
+  batch.push_back(std::make_pair(std::make_shared<InterfaceMap>(), ServiceProperties()));
+  US_TEST_FOR_EXCEPTION(std::invalid_argument, context.RegisterServices(batch))
+  US_TEST_CONDITION(context.GetServiceReferences<ITestServiceA>().size() == 3, "Testing that an invalid batch registers nothing")
+
+  context.RemoveListener(std::move(token));
+  for (auto& reg : regs)
+  {
+    reg.Unregister();
+  }
+  US_TEST_CONDITION(context.GetServiceReferences<ITestServiceA>().empty(), "Testing service count after unregistration")
+}
+
+void TestRegisteredAndUsedServices(BundleContext context)
+{
+  struct TestServiceA : public ITestServiceA
+  {
+  };
+
+  auto bundle = context.GetBundle();
+  const std::size_t nRegistered = bundle.GetRegisteredServices().size();
+  const std::size_t nInUse = bundle.GetServicesInUse().size();
+
+  auto reg1 = context.RegisterService<ITestServiceA>(std::make_shared<TestServiceA>());
+  auto reg2 = context.RegisterService<ITestServiceA>(std::make_shared<TestServiceA>());
+  auto reg3 = context.RegisterService<ITestServiceA>(std::make_shared<TestServiceA>());
+
+  auto registered = bundle.GetRegisteredServices();
+  US_TEST_CONDITION_REQUIRED(registered.size() == nRegistered + 3, "Testing registered service count")
+  US_TEST_CONDITION(registered[nRegistered] == reg1.GetReference() &&
+                    registered[nRegistered + 1] == reg2.GetReference() &&
+                    registered[nRegistered + 2] == reg3.GetReference(),
+                    "Testing registered services in registration order")
+
+  reg1.Unregister();
+  registered = bundle.GetRegisteredServices();
+  US_TEST_CONDITION_REQUIRED(registered.size() == nRegistered + 2, "Testing registered service count after unregistration")
+  US_TEST_CONDITION(registered[nRegistered] == reg2.GetReference() &&
+                    registered[nRegistered + 1] == reg3.GetReference(),
+                    "Testing registered services in registration order after unregistration")
+
+  {
+    auto service2 = context.GetService(reg2.GetReference());
+    auto service3 = context.GetService(reg3.GetReference());
+    US_TEST_CONDITION(bundle.GetServicesInUse().size() == nInUse + 2, "Testing services in use")
+    reg2.Unregister();
+    US_TEST_CONDITION(bundle.GetServicesInUse().size() == nInUse + 1, "Testing services in use after unregistration")
+  }
+  US_TEST_CONDITION(bundle.GetServicesInUse().size() == nInUse, "Testing services in use after releasing them")
+
+  reg3.Unregister();
+  US_TEST_CONDITION(bundle.GetRegisteredServices().size() == nRegistered, "Testing registered service count after unregistration")
+}
+
+void TestIndexedPropertyLookups()
+{
+  struct TestServiceA : public ITestServiceA
+  {
+  };
+
+  struct TestServiceAB : public ITestServiceA, public ITestServiceB
+  {
+  };
+
+  FrameworkFactory factory;
+  std::map<std::string, Any> frameworkProps;
+  frameworkProps[Constants::FRAMEWORK_SERVICE_INDEXED_KEYS] = std::vector<std::string>{ "Component.Name" };
+  auto framework = factory.NewFramework(frameworkProps);
+  framework.Start();
+  auto context = framework.GetBundleContext();
+
+  auto s1 = std::make_shared<TestServiceA>();
+  ServiceProperties props1;
+  props1[Constants::SERVICE_PID] = std::string("pid.1");
+  props1["component.name"] = std::string("comp.a");
+  auto reg1 = context.RegisterService<ITestServiceA>(s1, props1);
+
+  auto s2 = std::make_shared<TestServiceAB>();
+  ServiceProperties props2;
+  props2[Constants::SERVICE_PID] = std::vector<std::string>{ "pid.2", "pid.3" };
+  props2["component.name"] = 42;
+  auto reg2 = context.RegisterService<ITestServiceA, ITestServiceB>(s2, props2);
+
+  US_TEST_CONDITION(context.GetServiceReferences("", "(service.pid=pid.1)").size() == 1, "Testing pid lookup")
+  US_TEST_CONDITION(context.GetServiceReferences("", "(service.pid=pid.3)").size() == 1, "Testing pid lookup with multiple values")
+  US_TEST_CONDITION(context.GetServiceReferences("", "(|(service.pid=pid.1)(service.pid=pid.2))").size() == 2, "Testing pid lookup with OR")
+  US_TEST_CONDITION(context.GetServiceReferences("", "(&(service.pid=pid.1)(service.pid=pid.2))").empty(), "Testing pid lookup with AND")
+  US_TEST_CONDITION(context.GetServiceReferences("", "(service.pid=pid.4)").empty(), "Testing unknown pid lookup")
+  US_TEST_CONDITION(context.GetServiceReferences<ITestServiceB>("(service.pid=pid.1)").empty(), "Testing pid lookup for a different class")
+  US_TEST_CONDITION(context.GetServiceReferences<ITestServiceB>("(service.pid=pid.2)").size() == 1, "Testing pid lookup for a class")
+  US_TEST_CONDITION(context.GetServiceReferences("", "(component.name=comp.a)").size() == 1, "Testing configured index lookup")
+  US_TEST_CONDITION(context.GetServiceReferences("", "(component.name=42)").size() == 1, "Testing configured index lookup with a non-string value")
+
+  props1[Constants::SERVICE_PID] = std::string("pid.4");
+  reg1.SetProperties(props1);
+  US_TEST_CONDITION(context.GetServiceReferences("", "(service.pid=pid.1)").empty(), "Testing pid lookup after property update")
+  US_TEST_CONDITION(context.GetServiceReferences("", "(service.pid=pid.4)").size() == 1, "Testing pid lookup after property update")
+
+  reg1.Unregister();
+  US_TEST_CONDITION(context.GetServiceReferences("", "(service.pid=pid.4)").empty(), "Testing pid lookup after unregistration")
+  reg2.Unregister();
+  US_TEST_CONDITION(context.GetServiceReferences("", "(service.pid=pid.2)").empty(), "Testing pid lookup after unregistration")
+
+  framework.Stop();
+  framework.WaitForStop(std::chrono::milliseconds::zero());
+}
+
+void TestBestServiceLookup(BundleContext context)
+{
+  struct TestServiceA : public ITestServiceA {};
+
+  // Hide the service with the given ranking from all lookups.
+  struct HideRankingFindHook : public ServiceFindHook
+  {
+    int ranking;
+    HideRankingFindHook(int r) : ranking(r) {}
+    void Find(const BundleContext&, const std::string&, const std::string&,
+              ShrinkableVector<ServiceReferenceBase>& refs)
+    {
+      for (auto iter = refs.begin(); iter != refs.end();)
+      {
+        if (iter->GetProperty(Constants::SERVICE_RANKING).ToString() == std::to_string(ranking))
+        {
+          iter = refs.erase(iter);
+        }
+        else
+        {
+          ++iter;
+        }
+      }
+    }
+  };
+
+  US_TEST_CONDITION(!context.GetServiceReference<ITestServiceA>(), "Testing best service lookup without services")
+
+  std::vector<ServiceRegistration<ITestServiceA> > regs;
+  for (int ranking : { 5, 10, 1, 10 })
+  {
+    regs.push_back(context.RegisterService<ITestServiceA>(std::make_shared<TestServiceA>(),
+                                                          ServiceProperties{{Constants::SERVICE_RANKING, Any(ranking)}}));
+  }
+
+  // For equal rankings the service with the lowest id wins.
+  US_TEST_CONDITION(context.GetServiceReference<ITestServiceA>() == regs[1].GetReference(), "Testing best service lookup")
+
+  regs[1].Unregister();
+  US_TEST_CONDITION(context.GetServiceReference<ITestServiceA>() == regs[3].GetReference(), "Testing best service lookup after unregistration")
+
+  regs[2].SetProperties(ServiceProperties{{Constants::SERVICE_RANKING, Any(20)}});
+  US_TEST_CONDITION(context.GetServiceReference<ITestServiceA>() == regs[2].GetReference(), "Testing best service lookup after ranking change")
+
+  auto hookReg = context.RegisterService<ServiceFindHook>(std::make_shared<HideRankingFindHook>(20));
+  US_TEST_CONDITION(context.GetServiceReference<ITestServiceA>() == regs[3].GetReference(), "Testing best service lookup with a find hook")
+  hookReg.Unregister();
+  US_TEST_CONDITION(context.GetServiceReference<ITestServiceA>() == regs[2].GetReference(), "Testing best service lookup after find hook removal")
+
+  regs[0].Unregister();
+  regs[2].Unregister();
+  regs[3].Unregister();
+  US_TEST_CONDITION(!context.GetServiceReference<ITestServiceA>(), "Testing best service lookup after unregistering all services")
+}
+
+void TestCachedLookups()
+{
+  struct TestServiceA : public ITestServiceA
+  {
+  };
+
+  struct TestServiceB : public ITestServiceB
+  {
+  };
+
+  FrameworkFactory factory;
+  std::map<std::string, Any> frameworkProps;
+  frameworkProps[Constants::FRAMEWORK_SERVICE_LOOKUP_CACHE_SIZE] = 64;
+  auto framework = factory.NewFramework(frameworkProps);
+  framework.Start();
+  auto context = framework.GetBundleContext();
+
+  const std::string filter = "(color=red)";
+  ServiceProperties red{{"color", std::string("red")}};
+  ServiceProperties blue{{"color", std::string("blue")}};
+
+  auto reg1 = context.RegisterService<ITestServiceA>(std::make_shared<TestServiceA>(), red);
+  auto reg2 = context.RegisterService<ITestServiceA>(std::make_shared<TestServiceA>(), blue);
+
+  auto refs = context.GetServiceReferences<ITestServiceA>(filter);
+  US_TEST_CONDITION_REQUIRED(refs.size() == 1 && refs.front() == reg1.GetReference(), "Testing uncached lookup")
+  US_TEST_CONDITION(context.GetServiceReferences<ITestServiceA>(filter) == refs, "Testing cached lookup")
+  US_TEST_CONDITION(context.GetServiceReferences("", filter).size() == 1, "Testing cached lookup without class")
+
+  auto reg3 = context.RegisterService<ITestServiceA>(std::make_shared<TestServiceA>(), red);
+  US_TEST_CONDITION(context.GetServiceReferences<ITestServiceA>(filter).size() == 2, "Testing cached lookup after registration")
+  US_TEST_CONDITION(context.GetServiceReferences("", filter).size() == 2, "Testing cached lookup without class after registration")
+
+  reg2.SetProperties(red);
+  US_TEST_CONDITION(context.GetServiceReferences<ITestServiceA>(filter).size() == 3, "Testing cached lookup after property change")
+
+  reg1.Unregister();
+  US_TEST_CONDITION(context.GetServiceReferences<ITestServiceA>(filter).size() == 2, "Testing cached lookup after unregistration")
+
+  // Registering a service of another class does not change the result.
+  auto regB = context.RegisterService<ITestServiceB>(std::make_shared<TestServiceB>(), red);
+  US_TEST_CONDITION(context.GetServiceReferences<ITestServiceA>(filter).size() == 2, "Testing cached lookup after unrelated registration")
+  US_TEST_CONDITION(context.GetServiceReferences("", filter).size() == 3, "Testing cached lookup without class after unrelated registration")
+
+  // Find hooks are invoked for every lookup.
+  struct HideAllFindHook : public ServiceFindHook
+  {
+    void Find(const BundleContext&, const std::string&, const std::string&,
+              ShrinkableVector<ServiceReferenceBase>& refs)
+    {
+      refs.clear();
+    }
+  };
+  auto hookReg = context.RegisterService<ServiceFindHook>(std::make_shared<HideAllFindHook>());
+  US_TEST_CONDITION(context.GetServiceReferences<ITestServiceA>(filter).empty(), "Testing lookup with a find hook")
+  hookReg.Unregister();
+  US_TEST_CONDITION(context.GetServiceReferences<ITestServiceA>(filter).size() == 2, "Testing cached lookup after find hook removal")
+
+  reg2.Unregister();
+  reg3.Unregister();
+  regB.Unregister();
+  US_TEST_CONDITION(context.GetServiceReferences<ITestServiceA>(filter).empty(), "Testing cached lookup after unregistering all services")
+
+  // The change counters of classes are allocated in chunks, so use
+  // more classes than fit into the first one.
+  auto service = std::make_shared<TestServiceA>();
+  std::vector<ServiceRegistrationU> classRegs;
+  for (std::size_t i = 0; i < 1100; ++i)
+  {
+    auto im = std::make_shared<InterfaceMap>();
+    im->insert(std::make_pair("cache.test.Class" + std::to_string(i), service));
+    classRegs.push_back(context.RegisterService(im, red));
+  }
+  const std::string lastClass = "cache.test.Class1099";
+  US_TEST_CONDITION(context.GetServiceReferences(lastClass, filter).size() == 1, "Testing uncached lookup of a late class")
+  US_TEST_CONDITION(context.GetServiceReferences(lastClass, filter).size() == 1, "Testing cached lookup of a late class")
+  classRegs.back().Unregister();
+  US_TEST_CONDITION(context.GetServiceReferences(lastClass, filter).empty(), "Testing cached lookup of a late class after unregistration")
+
+  frameworkProps[Constants::FRAMEWORK_SERVICE_LOOKUP_CACHE_SIZE] = std::string("64");
+  US_TEST_FOR_EXCEPTION(std::invalid_argument, factory.NewFramework(frameworkProps))
+
+  framework.Stop();
+  framework.WaitForStop(std::chrono::milliseconds::zero());
+}
+
+void TestShardedRegistry()
+{
+  struct TestServiceAB : public ITestServiceA, public ITestServiceB
+  {
+  };
+
+  FrameworkFactory factory;
+  std::map<std::string, Any> frameworkProps;
+  frameworkProps[Constants::FRAMEWORK_SERVICE_REGISTRY_SHARDS] = 4;
+  frameworkProps[Constants::FRAMEWORK_SERVICE_INDEXED_KEYS] = std::vector<std::string>{ "color" };
+  auto framework = factory.NewFramework(frameworkProps);
+  framework.Start();
+  auto context = framework.GetBundleContext();
+
+  const std::size_t n = 10;
+  std::vector<ServiceRegistration<ITestServiceA, ITestServiceB> > regs;
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    ServiceProperties props;
+    props[Constants::SERVICE_RANKING] = static_cast<int>(i);
+    props["color"] = std::string(i % 2 ? "red" : "blue");
+    regs.push_back(context.RegisterService<ITestServiceA, ITestServiceB>(std::make_shared<TestServiceAB>(), props));
+  }
+
+  US_TEST_CONDITION(context.GetServiceReferences<ITestServiceA>().size() == n, "Testing sharded class lookup")
+  US_TEST_CONDITION(context.GetServiceReferences<ITestServiceB>().size() == n, "Testing sharded lookup of the second class")
+  US_TEST_CONDITION(context.GetServiceReference<ITestServiceA>() == regs.back().GetReference<ITestServiceA>(),
+                    "Testing sharded best service lookup")
+  US_TEST_CONDITION(context.GetServiceReferences<ITestServiceA>("(color=red)").size() == n / 2,
+                    "Testing sharded indexed lookup")
+  US_TEST_CONDITION(context.GetServiceReferences("", "(color=blue)").size() == n / 2,
+                    "Testing sharded lookup without class")
+  const std::string classFilter = "(" + Constants::OBJECTCLASS + "=" + us_service_interface_iid<ITestServiceB>() + ")";
+  US_TEST_CONDITION(context.GetServiceReferences("", classFilter).size() == n,
+                    "Testing sharded lookup of a class in the filter")
+  US_TEST_CONDITION(context.GetBundle().GetRegisteredServices().size() == n, "Testing sharded registered services")
+
+  regs.back().SetProperties(ServiceProperties{ { Constants::SERVICE_RANKING, -1 } });
+  US_TEST_CONDITION(context.GetServiceReference<ITestServiceA>() == regs[n - 2].GetReference<ITestServiceA>(),
+                    "Testing sharded best service lookup after ranking change")
+
+  for (std::size_t i = 0; i < n; i += 2)
+  {
+    regs[i].Unregister();
+  }
+  US_TEST_CONDITION(context.GetServiceReferences<ITestServiceA>().size() == n / 2, "Testing sharded lookup after unregistration")
+  US_TEST_CONDITION(context.GetServiceReferences("", "(color=blue)").empty(), "Testing sharded indexed lookup after unregistration")
+  US_TEST_CONDITION(context.GetServiceReferences("", "").size() >= n / 2, "Testing sharded lookup of all services")
+
+  framework.Stop();
+  framework.WaitForStop(std::chrono::milliseconds::zero());
+}
+
+// Unfiltered lookups of all services return them in registration order,
+// also after unregistering services from the middle of the registry.
+void TestRegistrationOrder(std::size_t shards)
+{
+  struct TestServiceA : public ITestServiceA
+  {
+  };
+
+  FrameworkFactory factory;
+  std::map<std::string, Any> frameworkProps;
+  frameworkProps[Constants::FRAMEWORK_SERVICE_REGISTRY_SHARDS] = shards;
+  auto framework = factory.NewFramework(frameworkProps);
+  framework.Start();
+  auto context = framework.GetBundleContext();
+
+  auto inRegistrationOrder = [&context]() {
+    auto refs = context.GetServiceReferences("", "");
+    for (std::size_t i = 1; i < refs.size(); ++i)
+    {
+      if (any_cast<long>(refs[i - 1].GetProperty(Constants::SERVICE_ID)) >=
+          any_cast<long>(refs[i].GetProperty(Constants::SERVICE_ID)))
+      {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  const std::size_t n = 20;
+  std::vector<ServiceRegistration<ITestServiceA> > regs;
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    regs.push_back(context.RegisterService<ITestServiceA>(std::make_shared<TestServiceA>()));
+  }
+  const std::size_t count = context.GetServiceReferences("", "").size();
+  US_TEST_CONDITION(inRegistrationOrder(), "Testing registration order with " << shards << " shards")
+
+  for (std::size_t i = 0; i < n; i += 3)
+  {
+    regs[i].Unregister();
+    US_TEST_CONDITION(inRegistrationOrder(), "Testing registration order after unregistering service " << i)
+  }
+  regs.push_back(context.RegisterService<ITestServiceA>(std::make_shared<TestServiceA>()));
+  US_TEST_CONDITION(context.GetServiceReferences("", "").size() == count - (n + 2) / 3 + 1,
+                    "Testing lookup of all services after unregistration")
+  US_TEST_CONDITION(inRegistrationOrder(), "Testing registration order after a new registration")
+
+  framework.Stop();
+  framework.WaitForStop(std::chrono::milliseconds::zero());
+}
+
+void TestServiceChanges()
+{
+  struct TestServiceAB : public ITestServiceA, public ITestServiceB
+  {
+  };
+
+  FrameworkFactory factory;
+  std::map<std::string, Any> frameworkProps;
+  frameworkProps[Constants::FRAMEWORK_SERVICE_CHANGE_LOG_SIZE] = 4;
+  auto framework = factory.NewFramework(frameworkProps);
+  framework.Start();
+  auto context = framework.GetBundleContext();
+
+  const std::uint64_t start = context.GetServiceChanges(0).sequenceNumber;
+  ServiceChanges changes = context.GetServiceChanges(start);
+  US_TEST_CONDITION(!changes.resyncRequired && changes.changes.empty() && changes.sequenceNumber == start,
+                    "Testing service changes without changes")
+
+  auto reg = context.RegisterService<ITestServiceA, ITestServiceB>(std::make_shared<TestServiceAB>());
+  const long id = any_cast<long>(reg.GetReference().GetProperty(Constants::SERVICE_ID));
+  reg.SetProperties(ServiceProperties{{"color", std::string("red")}});
+  reg.Unregister();
+
+  changes = context.GetServiceChanges(start);
+  US_TEST_CONDITION_REQUIRED(!changes.resyncRequired && changes.changes.size() == 3 && changes.sequenceNumber == start + 3,
+                             "Testing service changes count")
+  const ServiceEvent::Type types[] = { ServiceEvent::SERVICE_REGISTERED, ServiceEvent::SERVICE_MODIFIED,
+                                       ServiceEvent::SERVICE_UNREGISTERING };
+  for (std::size_t i = 0; i < 3; ++i)
+  {
+    const ServiceChange& change = changes.changes[i];
+    US_TEST_CONDITION(change.sequenceNumber == start + 1 + i, "Testing service change sequence number")
+    US_TEST_CONDITION(change.type == types[i], "Testing service change type")
+    US_TEST_CONDITION(change.serviceId == id, "Testing service change service id")
+    US_TEST_CONDITION(change.objectClass == std::vector<std::string>({ us_service_interface_iid<ITestServiceA>(),
+                                                                       us_service_interface_iid<ITestServiceB>() }),
+                      "Testing service change object class")
+  }
+
+  changes = context.GetServiceChanges(start + 2);
+  US_TEST_CONDITION(!changes.resyncRequired && changes.changes.size() == 1 &&
+                    changes.changes.front().type == ServiceEvent::SERVICE_UNREGISTERING,
+                    "Testing service changes since an intermediate sequence number")
+
+  // Overflow the change log.
+  for (int i = 0; i < 2; ++i)
+  {
+    context.RegisterService<ITestServiceA>(std::make_shared<TestServiceAB>()).Unregister();
+  }
+  changes = context.GetServiceChanges(start);
+  US_TEST_CONDITION(changes.resyncRequired && changes.changes.empty() && changes.sequenceNumber == start + 7,
+                    "Testing service changes after the change log overflowed")
+  changes = context.GetServiceChanges(start + 3);
+  US_TEST_CONDITION(!changes.resyncRequired && changes.changes.size() == 4, "Testing service changes within the change log")
+  US_TEST_CONDITION(context.GetServiceChanges(start + 8).resyncRequired, "Testing service changes from the future")
+
+  framework.Stop();
+  framework.WaitForStop(std::chrono::milliseconds::zero());
+}
 
 int ServiceRegistryTest(int /*argc*/, char* /*argv*/[])
 {
@@ -148,6 +603,15 @@ int ServiceRegistryTest(int /*argc*/, char* /*argv*/[])
   TestServiceInterfaceId();
   TestMultipleServiceRegistrations(context);
   TestServicePropertiesUpdate(context);
+  TestRegisterServicesBatch(context);
+  TestRegisteredAndUsedServices(context);
+  TestBestServiceLookup(context);
+  TestIndexedPropertyLookups();
+  TestCachedLookups();
+  TestServiceChanges();
+  TestShardedRegistry();
+  TestRegistrationOrder(1);
+  TestRegistrationOrder(4);
 
   US_TEST_END()
 }